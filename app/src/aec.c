@@ -0,0 +1,466 @@
+/**
+  ******************************************************************************
+  * @file   aec.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aec.h"
+#include "cycle_counter.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    #define AEC_DSP         1
+#endif
+
+#define AEC_MU              4096            // NLMS step per block sample, Q15
+#define AEC_DELTA           (1 << 20)       // regularization, a far end rms of 64
+#define AEC_FAR_MIN         (1 << 21)       // window energy counted as far end signal
+#define AEC_DT_FLOOR        (AEC_BLOCK << 10) // residual under -60 dBFS is never near speech
+#define AEC_DT_HOLD         20              // blocks without adaptation after double talk
+#define AEC_DT_MAX          1000            // blocks frozen before the path counts as moved
+#define AEC_PRE             48              // taps kept before the correlation peak
+#define AEC_POST            128             // taps the peak needs after it for the decay
+#define AEC_ENV_ACTIVE      32              // far end envelope mean worth correlating
+#define AEC_DELAY_PAR       4               // correlation peak over mean to trust it
+#define AEC_DELAY_STABLE    30              // hops the peak must hold before a move
+
+static inline int16_t aec_sat16(int32_t v)
+{
+#ifdef AEC_DSP
+    return (int16_t)__SSAT(v, 16);
+#else
+    return (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+#endif
+}
+
+static int aec_bitlen64(uint64_t v)
+{
+    int n = 0;
+
+    if (v >> 32)
+    {
+        n = 32;
+        v >>= 32;
+    }
+#ifdef AEC_DSP
+    return v ? n + 32 - __CLZ((uint32_t)v) : n;
+#else
+    while (v)
+    {
+        n++;
+        v >>= 1;
+    }
+    return n;
+#endif
+}
+
+/* Dot product of n int16 pairs, n even, any alignment. */
+static inline int64_t aec_dot(const int16_t *a, const int16_t *b, int n)
+{
+    int64_t acc = 0;
+    int i;
+
+#ifdef AEC_DSP
+    for (i = 0; i < n; i += 2)
+    {
+        uint32_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        acc = (int64_t)__SMLALD(x, y, (uint64_t)acc);
+    }
+#else
+    for (i = 0; i < n; i++)
+        acc += (int32_t)a[i] * b[i];
+#endif
+    return acc;
+}
+
+static void aec_sync_w16(aec_t *a)
+{
+    int j;
+
+    for (j = 0; j < AEC_TAPS; j++)
+        a->w16[j] = aec_sat16(a->w[j] >> 16);
+}
+
+/* Moves the filter window to a new bulk delay, keeping the taps that
+ * still fall inside it. */
+static void aec_move(aec_t *a, uint32_t delay)
+{
+    int s = (int)delay - (int)a->delay;
+
+    if (s >= AEC_TAPS || -s >= AEC_TAPS)
+    {
+        memset(a->w, 0, sizeof(a->w));
+    }
+    else if (s > 0)
+    {
+        memmove(a->w + s, a->w, (AEC_TAPS - s) * sizeof(a->w[0]));
+        memset(a->w, 0, s * sizeof(a->w[0]));
+    }
+    else if (s < 0)
+    {
+        memmove(a->w, a->w - s, (AEC_TAPS + s) * sizeof(a->w[0]));
+        memset(a->w + AEC_TAPS + s, 0, -s * sizeof(a->w[0]));
+    }
+    aec_sync_w16(a);
+    a->delay = delay;
+    a->delay_moves++;
+    // the single talk levels belong to the old window
+    a->em = 0;
+    a->ee = 0;
+    a->dt_hold = 0;
+    a->dt_run = 0;
+}
+
+static int32_t aec_env(const int16_t *x)
+{
+    int32_t sum = 0;
+    int i;
+
+    for (i = 0; i < AEC_ENV_BLOCK; i++)
+        sum += abs(x[i]);
+    return sum / AEC_ENV_BLOCK;
+}
+
+/* Correlates the far end and mic envelope steps over all lags and moves
+ * the filter once the peak has held for a while. Steps rather than levels:
+ * syllables make the envelope itself so smooth that every lag correlates. */
+static void aec_delay_track(aec_t *a, const int16_t *mic)
+{
+    const int16_t *ref = a->hist + AEC_HIST - AEC_HOP;
+    int32_t best = 0, sum = 0;
+    int i, l, lag = 0, head;
+
+    for (i = 0; i < AEC_HOP; i += AEC_ENV_BLOCK)
+    {
+        int32_t r = aec_env(ref + i), m = aec_env(mic + i), mh = m - a->mlast;
+
+        a->ravg += (r - a->ravg) >> 5;
+        head = a->renv_head = (a->renv_head + 1) % AEC_LAGS;
+        a->renv[head] = r - a->rlast;
+        a->rlast = r;
+        a->mlast = m;
+        if (a->ravg < AEC_ENV_ACTIVE)
+            continue;
+        // lag l pairs this mic block with the far end block l blocks back
+        for (l = 0; l <= head; l++)
+            a->corr[l] += ((mh * a->renv[head - l]) >> 10) - (a->corr[l] >> 9);
+        for (; l < AEC_LAGS; l++)
+            a->corr[l] += ((mh * a->renv[head - l + AEC_LAGS]) >> 10) - (a->corr[l] >> 9);
+    }
+
+    for (l = 0; l < AEC_LAGS; l++)
+    {
+        sum += abs(a->corr[l]);
+        if (a->corr[l] > best)
+        {
+            best = a->corr[l];
+            lag = l;
+        }
+    }
+    if (!best || (int64_t)best * AEC_LAGS < (int64_t)sum * AEC_DELAY_PAR)
+        return;
+    if (abs(lag - (int)a->cand) > 1)
+    {
+        a->cand = lag;
+        a->cand_hops = 0;
+        return;
+    }
+    if (++a->cand_hops < AEC_DELAY_STABLE)
+        return;
+    a->cand_hops = 0;
+    // move only when the peak leaves the part of the window that has
+    // room on both sides, the lag jitters by an envelope block
+    lag *= AEC_ENV_BLOCK;
+    if (lag + AEC_ENV_BLOCK >= a->delay + AEC_PRE / 2 && lag + AEC_POST <= a->delay + AEC_TAPS)
+        return;
+    aec_move(a, lag > AEC_PRE ? lag - AEC_PRE : 0);
+}
+
+/* One block: filter, then adapt unless the near end talks. */
+static void aec_block(aec_t *a, const int16_t *x, int16_t *mic)
+{
+    int64_t em = 0, ey = 0, ee = 0, p, g;
+    int32_t f;
+    int n, j, pe;
+
+    for (n = 0; n < AEC_BLOCK; n++)
+    {
+        int32_t y = (int32_t)(aec_dot(a->w16, x + n, AEC_TAPS) >> 14);
+        int32_t e = mic[n] - y;
+
+        em += (int32_t)mic[n] * mic[n];
+        ey += (int64_t)y * y;
+        ee += (int64_t)e * e;
+        mic[n] = aec_sat16(e);
+    }
+    p = aec_dot(x + AEC_BLOCK - 1, x + AEC_BLOCK - 1, AEC_TAPS);
+    a->far_active = p > AEC_FAR_MIN;
+    if (!a->far_active)
+        return;
+
+    // once converged, a residual 12 dB above the single talk level is the
+    // near end talking; a hold that never ends means the path moved
+    if (a->em > 16 * a->ee && ee > AEC_DT_FLOOR &&
+            (uint64_t)ee * (a->em >> 8) > (uint64_t)em * 16 * (a->ee >> 8))
+    {
+        a->dt_blocks++;
+        a->dt_hold = AEC_DT_HOLD;
+    }
+    if (a->dt_hold)
+    {
+        a->dt_hold--;
+        a->near_talk = 1;
+        if (++a->dt_run < AEC_DT_MAX)
+            return;
+        a->ee = a->em;          // relearn, double talk is off until it converges
+        a->dt_hold = 0;
+    }
+    a->dt_run = 0;
+    a->em += (em - (int64_t)a->em) >> 3;
+    a->ee += (ee - (int64_t)a->ee) >> 3;
+    a->adapt_blocks++;
+
+    // w += mu e x / |x|^2, the division done once for the block
+    p += AEC_DELTA;
+    pe = aec_bitlen64((uint64_t)p) - 16;
+    f = (int32_t)(((uint32_t)AEC_MU << 16) / (uint32_t)(p >> pe));
+    for (j = 0; j < AEC_TAPS; j++)
+    {
+        g = aec_dot(mic, x + j, AEC_BLOCK) >> 4;
+        if (g > INT32_MAX)
+            g = INT32_MAX;
+        if (g < -INT32_MAX)
+            g = -INT32_MAX;
+        int64_t w = a->w[j] + ((g * f) >> (pe - 3));
+        a->w[j] = (int32_t)(w > INT32_MAX ? INT32_MAX : (w < -INT32_MAX ? -INT32_MAX : w));
+        a->w16[j] = aec_sat16(a->w[j] >> 16);
+    }
+}
+
+void aec_init(aec_t *a)
+{
+    memset(a, 0, sizeof(*a));
+}
+
+void aec_process(aec_t *a, const int16_t *ref, int16_t *mic)
+{
+    const int16_t *x;
+    int n;
+
+    memmove(a->hist, a->hist + AEC_HOP, (AEC_HIST - AEC_HOP) * sizeof(int16_t));
+    memcpy(a->hist + AEC_HIST - AEC_HOP, ref, AEC_HOP * sizeof(int16_t));
+    aec_delay_track(a, mic);
+
+    // the window of mic sample n is x + n, its last tap at the bulk delay
+    x = a->hist + AEC_HIST - AEC_HOP - a->delay - AEC_TAPS + 1;
+    a->near_talk = 0;
+    for (n = 0; n < AEC_HOP; n += AEC_BLOCK)
+        aec_block(a, x + n, mic + n);
+    a->hops++;
+}
+
+int aec_erle_db10(const aec_t *a)
+{
+    if (!a->em || !a->ee)
+        return 0;
+    return (int)lrintf(100.0f * log10f((float)a->em / (float)a->ee));
+}
+
+/*
+ * Synthetic echo paths: a bulk delay, then exponentially decaying random
+ * taps. The far end talks in syllables throughout, the near end joins
+ * for half a second of double talk at 4 s.
+ */
+#define AEC_TEST_HOPS       600
+#define AEC_TEST_DT_FROM    400
+#define AEC_TEST_DT_TO      450
+#define AEC_TEST_PATH       (AEC_MAX_DELAY + AEC_TAPS)
+#define AEC_TEST_PI         3.14159265358979f
+
+static float aec_test_noise(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return ((int32_t)(*seed >> 16) - 32768) / 18918.0f;    // unit rms
+}
+
+/* Voiced syllables with some breath noise, the pitch changing from one
+ * syllable to the next the way it does in running speech. */
+static float aec_test_voice(int hop, int i, float f0, float rms, uint32_t *seed)
+{
+    float t = (hop * AEC_HOP + i) / 16000.0f, v = 0;
+    int pos = hop % 50, h;
+
+    if (pos >= 30)
+        return 0;
+    f0 *= 0.8f + 0.1f * ((hop / 50 * 7) % 5);
+    f0 += 20.0f * sinf(2 * AEC_TEST_PI * 0.7f * t);
+    for (h = 1; h * f0 < 3500.0f; h++)
+        v += sinf(2 * AEC_TEST_PI * h * f0 * t) / h;
+    v += 0.3f * aec_test_noise(seed);
+    return v * rms * 1.2f * sinf(AEC_TEST_PI * (pos * AEC_HOP + i) / (30 * AEC_HOP));
+}
+
+/* Heap allocated by the command, kept out of the firmware's BSS. */
+typedef struct
+{
+    aec_t   aec;
+    float   path[AEC_TEST_PATH];
+    float   far[AEC_TEST_PATH + AEC_HOP];
+} aec_test_t;
+
+static void aec_test_run(aec_test_t *t, int delay_ms, int gain_db, int decay_ms)
+{
+    aec_t *aec = &t->aec;
+    float *path = t->path, *far = t->far;
+    int16_t ref[AEC_HOP], mic[AEC_HOP];
+    float near[AEC_HOP], gain = powf(10.0f, gain_db / 20.0f), norm = 0;
+    double e_mic = 0, e_out = 0, e_near = 0, e_dist = 0, e_after_mic = 0, e_after_out = 0;
+    uint32_t seed = 99, cycles, max = 0, start;
+    int converge = -1;
+    uint64_t total = 0;
+    int d = delay_ms * 16, hop, i, k, len = d + decay_ms * 16 * 4;
+
+    if (len > AEC_TEST_PATH)
+        len = AEC_TEST_PATH;
+    memset(t->path, 0, sizeof(t->path));
+    memset(t->far, 0, sizeof(t->far));
+    for (k = d; k < len; k++)
+    {
+        path[k] = aec_test_noise(&seed) * expf(-(k - d) / (decay_ms * 16.0f));
+        norm += path[k] * path[k];
+    }
+    for (k = d; k < len; k++)
+        path[k] *= gain / sqrtf(norm);
+
+    aec_init(aec);
+    for (hop = 0; hop < AEC_TEST_HOPS; hop++)
+    {
+        double em = 0, eo = 0;
+
+        memmove(far, far + AEC_HOP, AEC_TEST_PATH * sizeof(float));
+        for (i = 0; i < AEC_HOP; i++)
+        {
+            float echo = 0;
+
+            far[AEC_TEST_PATH + i] = aec_test_voice(hop, i, 120.0f, 3277.0f, &seed);
+            for (k = d; k < len; k++)
+                echo += path[k] * far[AEC_TEST_PATH + i - k];
+            near[i] = aec_test_noise(&seed) * 33.0f;    // -60 dBFS floor
+            if (hop >= AEC_TEST_DT_FROM && hop < AEC_TEST_DT_TO)
+                near[i] += aec_test_voice(hop + 17, i, 210.0f, 2000.0f, &seed);
+            ref[i] = aec_sat16((int32_t)lrintf(far[AEC_TEST_PATH + i]));
+            mic[i] = aec_sat16((int32_t)lrintf(echo + near[i]));
+            em += (double)mic[i] * mic[i];
+        }
+        rt_enter_critical();
+        start = cycle_counter_get();
+        aec_process(aec, ref, mic);
+        cycles = cycle_counter_get() - start;
+        rt_exit_critical();
+        total += cycles;
+        if (cycles > max)
+            max = cycles;
+        for (i = 0; i < AEC_HOP; i++)
+            eo += (double)mic[i] * mic[i];
+
+        if (converge < 0 && hop % 50 < 30 && em > 100 * eo)
+            converge = hop;
+        if (hop >= 300 && hop < AEC_TEST_DT_FROM)
+        {
+            e_mic += em;
+            e_out += eo;
+        }
+        else if (hop >= AEC_TEST_DT_FROM && hop < AEC_TEST_DT_TO)
+        {
+            // near end speech kept, echo and distortion left on top of it
+            for (i = 0; i < AEC_HOP; i++)
+            {
+                float dist = mic[i] - near[i];
+                e_near += (double)near[i] * near[i];
+                e_dist += (double)dist * dist;
+            }
+        }
+        else if (hop >= AEC_TEST_DT_TO + 50)
+        {
+            e_after_mic += em;
+            e_after_out += eo;
+        }
+    }
+    rt_kprintf("aec: path %3d ms %3d dB decay %2d ms: delay %3d ms, erle %2d dB, after dt %2d dB, "
+               "20 dB at %4d ms, dt near/rest %2d dB, cycles avg %u max %u\n",
+               delay_ms, gain_db, decay_ms, (int)(aec->delay / 16),
+               (int)lrintf(10.0f * log10f((float)(e_mic / (e_out + 1)))),
+               (int)lrintf(10.0f * log10f((float)(e_after_mic / (e_after_out + 1)))),
+               converge < 0 ? -1 : converge * 10, (int)lrintf(10.0f * log10f((float)(e_near / (e_dist + 1)))),
+               (uint32_t)(total / AEC_TEST_HOPS), max);
+}
+
+/* aec_test [delay_ms gain_db decay_ms]: ERLE, convergence, double talk
+ * and cycles per 10 ms hop on synthetic echo paths. */
+static void aec_test(int argc, char **argv)
+{
+    static const int paths[][3] = {{24, -6, 3}, {70, 0, 5}, {150, -12, 8}, {5, 6, 2}};
+    aec_test_t *t = rt_malloc(sizeof(aec_test_t));
+    int i;
+
+    if (!t)
+    {
+        rt_kprintf("aec_test: no memory\n");
+        return;
+    }
+    cycle_counter_init();
+    if (argc > 3)
+        aec_test_run(t, atoi(argv[1]), atoi(argv[2]), atoi(argv[3]));
+    else
+    {
+        for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+            aec_test_run(t, paths[i][0], paths[i][1], paths[i][2]);
+    }
+    rt_free(t);
+}
+MSH_CMD_EXPORT(aec_test, aec_test [delay_ms gain_db decay_ms]: echo canceller on synthetic paths);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file   aec.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __AEC_H__
+#define __AEC_H__
+
+#include <stdint.h>
+
+/*
+ * Acoustic echo canceller for full duplex chat, 16 kHz mono in 10 ms
+ * hops. The far end reference is what was handed to the speaker, read
+ * back at the mic's pace so it lines up with the codec cache; the rest
+ * of the delay is found by envelope correlation and the echo path by a
+ * block NLMS filter behind it. Adaptation stops while the near end
+ * talks over the echo.
+ */
+#define AEC_HOP             160
+#define AEC_TAPS            256             // 16 ms of echo tail after the bulk delay
+#define AEC_BLOCK           16              // samples per filter update
+#define AEC_ENV_BLOCK       32              // 2 ms envelope resolution of the delay search
+#define AEC_MAX_DELAY       3200            // bulk delay searched, 200 ms
+#define AEC_LAGS            (AEC_MAX_DELAY / AEC_ENV_BLOCK)
+#define AEC_HIST            (AEC_MAX_DELAY + AEC_TAPS + AEC_HOP)
+
+typedef struct
+{
+    int16_t     hist[AEC_HIST];             // far end, oldest first, this hop last
+    int32_t     w[AEC_TAPS];                // echo path, Q30, newest tap last
+    int16_t     w16[AEC_TAPS];              // Q14 copy the filter runs on
+    uint32_t    delay;                      // bulk delay in samples
+    // delay search
+    int32_t     renv[AEC_LAGS];             // far end envelope steps, ring
+    uint16_t    renv_head;
+    int32_t     ravg;                       // far end envelope mean
+    int32_t     rlast, mlast;               // previous envelope blocks
+    int32_t     corr[AEC_LAGS];
+    uint16_t    cand;                       // lag the correlation points at
+    uint16_t    cand_hops;                  // hops it has held
+    // double talk and convergence
+    uint16_t    dt_hold;                    // blocks left without adaptation
+    uint16_t    dt_run;                     // blocks frozen since the last update
+    uint8_t     far_active;                 // last block had far end signal
+    uint8_t     near_talk;                  // last hop had near end speech over the echo
+    uint64_t    em, ee;                     // smoothed mic and residual energy, single talk
+    // statistics
+    uint32_t    hops;
+    uint32_t    adapt_blocks;
+    uint32_t    dt_blocks;
+    uint32_t    delay_moves;
+} aec_t;
+
+void aec_init(aec_t *a);
+/* ref: the far end samples played during this hop; mic is replaced by the
+ * echo free residual. Both AEC_HOP samples. */
+void aec_process(aec_t *a, const int16_t *ref, int16_t *mic);
+/* Echo return loss enhancement in tenths of a dB, 0 before any far end. */
+int  aec_erle_db10(const aec_t *a);
+
+#endif /* __AEC_H__ */
@@ -0,0 +1,357 @@
+/**
+  ******************************************************************************
+  * @file   audio_io.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dfs_posix.h"
+#include "audio_io.h"
+#include "mixer.h"
+
+#define AUDIO_IO_FRAME          320         // 10 ms of 16 kHz mono, what the codec delivers
+#define AUDIO_IO_WAV_HDR        44
+
+typedef enum
+{
+    AUDIO_IO_SERVER,
+    AUDIO_IO_WAV,
+    AUDIO_IO_NULL,
+    AUDIO_IO_MIX,
+} audio_io_kind_t;
+
+struct audio_io
+{
+    audio_io_kind_t             kind;
+    uint8_t                     is_source;
+    volatile uint8_t            is_exit;
+    audio_client_t              client;     // AUDIO_IO_SERVER
+    mixer_ch_t                  *ch;        // AUDIO_IO_MIX
+    int                         fd;         // AUDIO_IO_WAV
+    uint32_t                    samplerate;
+    uint32_t                    channels;
+    uint32_t                    bytes;
+    uint32_t                    errors;     // file writes that failed, audio dropped
+    rt_tick_t                   start;
+    audio_server_callback_func  cb;
+    void                        *ctx;
+    audio_io_tap_t              tap;
+    void                        *tap_ctx;
+    rt_thread_t                 thread;     // WAV source feeder
+    rt_sem_t                    done;
+    uint8_t                     frame[AUDIO_IO_FRAME];
+};
+
+static void wav_put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t wav_get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wav_header(uint8_t *h, uint32_t samplerate, uint32_t channels, uint32_t data_len)
+{
+    memcpy(h, "RIFF", 4);
+    wav_put32(h + 4, 36 + data_len);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    wav_put32(h + 16, 16);
+    wav_put32(h + 20, 1 | (channels << 16));                // PCM, channels
+    wav_put32(h + 24, samplerate);
+    wav_put32(h + 28, samplerate * channels * 2);
+    wav_put32(h + 32, (channels * 2) | (16 << 16));         // block align, bits
+    memcpy(h + 36, "data", 4);
+    wav_put32(h + 40, data_len);
+}
+
+/* Leaves fd at the first sample, returns -1 unless it is pcm16. */
+static int wav_parse(audio_io_t *io)
+{
+    uint8_t h[12];
+    uint32_t len;
+
+    if (read(io->fd, h, 12) != 12 || memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVE", 4))
+        return -1;
+    while (read(io->fd, h, 8) == 8)
+    {
+        len = wav_get32(h + 4);
+        if (memcmp(h, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+
+            if (len < 16 || read(io->fd, fmt, 16) != 16)
+                return -1;
+            io->channels = fmt[2] | (fmt[3] << 8);
+            io->samplerate = wav_get32(fmt + 4);
+            if ((fmt[0] | (fmt[1] << 8)) != 1 || fmt[14] != 16)
+                return -1;
+            len -= 16;
+        }
+        else if (memcmp(h, "data", 4) == 0)
+        {
+            return 0;
+        }
+        if (lseek(io->fd, (len + 1) & ~1, SEEK_CUR) < 0)
+            return -1;
+    }
+    return -1;
+}
+
+static void audio_io_feeder(void *p)
+{
+    audio_io_t *io = (audio_io_t *)p;
+    audio_server_coming_data_t data;
+    int n;
+
+    data.data = io->frame;
+    while (!io->is_exit && (n = read(io->fd, io->frame, AUDIO_IO_FRAME)) > 0)
+    {
+        data.data_len = n;
+        // the consumer sets the pace, a full ring only means wait
+        while (!io->is_exit && io->cb(as_callback_cmd_data_coming, io->ctx, (uint32_t)&data) == -RT_EFULL)
+            rt_thread_delay(1);
+        io->bytes += n;
+    }
+    if (!io->is_exit)
+        io->cb(as_callback_cmd_play_to_end, io->ctx, 0);
+    rt_sem_release(io->done);
+}
+
+static audio_io_t *audio_io_open(const char *uri, int is_source, audio_parameter_t *pa,
+                                 audio_server_callback_func cb, void *ctx)
+{
+    audio_io_t *io = rt_calloc(1, sizeof(audio_io_t));
+
+    if (!io)
+        return NULL;
+    io->is_source = is_source;
+    io->cb = cb;
+    io->ctx = ctx;
+    io->fd = -1;
+    io->start = rt_tick_get();
+    io->samplerate = is_source ? pa->read_samplerate : pa->write_samplerate;
+    io->channels = is_source ? pa->read_channnel_num : pa->write_channnel_num;
+    if (!uri)
+    {
+        io->kind = AUDIO_IO_SERVER;
+        io->client = audio_open(AUDIO_TYPE_LOCAL_MUSIC, is_source ? AUDIO_RX : AUDIO_TX, pa, cb, ctx);
+        if (!io->client)
+            goto Fail;
+        return io;
+    }
+    if (strncmp(uri, "mix:", 4) == 0)
+    {
+        const char *name = strchr(uri + 4, ':');
+
+        if (is_source || io->samplerate != 16000 || io->channels != 1)
+            goto Fail;
+        io->kind = AUDIO_IO_MIX;
+        io->ch = mixer_open(name ? name + 1 : uri + 4, atoi(uri + 4), pa->write_cache_size, cb, ctx);
+        if (!io->ch)
+            goto Fail;
+        return io;
+    }
+    if (strcmp(uri, "null") == 0)
+    {
+        if (is_source)
+            goto Fail;
+        io->kind = AUDIO_IO_NULL;
+        return io;
+    }
+
+    io->kind = AUDIO_IO_WAV;
+    if (!is_source)
+    {
+        uint8_t h[AUDIO_IO_WAV_HDR];
+
+        io->fd = open(uri, O_WRONLY | O_CREAT | O_TRUNC);
+        wav_header(h, io->samplerate, io->channels, 0);     // sizes patched on close
+        if (io->fd < 0 || write(io->fd, h, sizeof(h)) != sizeof(h))
+            goto Fail;
+        return io;
+    }
+    io->fd = open(uri, O_RDONLY);
+    if (io->fd < 0 || wav_parse(io) != 0)
+    {
+        rt_kprintf("audio_io: %s is not a pcm16 wav\n", uri);
+        goto Fail;
+    }
+    if (io->samplerate != pa->read_samplerate || io->channels != pa->read_channnel_num)
+        rt_kprintf("audio_io: %s is %d Hz %d ch, used as %d Hz %d ch\n", uri,
+                   io->samplerate, io->channels, pa->read_samplerate, pa->read_channnel_num);
+    io->done = rt_sem_create("aio", 0, RT_IPC_FLAG_FIFO);
+    io->thread = rt_thread_create("aio", audio_io_feeder, io, 1024,
+                                  RT_THREAD_PRIORITY_MIDDLE + RT_THREAD_PRIORITY_HIGHER + 1,
+                                  RT_THREAD_TICK_DEFAULT);
+    if (!io->done || !io->thread)
+        goto Fail;
+    rt_thread_startup(io->thread);
+    return io;
+
+Fail:
+    if (io->done)
+        rt_sem_delete(io->done);
+    if (io->fd >= 0)
+        close(io->fd);
+    rt_free(io);
+    return NULL;
+}
+
+audio_io_t *audio_io_open_sink(const char *uri, audio_parameter_t *pa,
+                               audio_server_callback_func cb, void *ctx)
+{
+    return audio_io_open(uri, 0, pa, cb, ctx);
+}
+
+audio_io_t *audio_io_open_source(const char *uri, audio_parameter_t *pa,
+                                 audio_server_callback_func cb, void *ctx)
+{
+    return audio_io_open(uri, 1, pa, cb, ctx);
+}
+
+void audio_io_close(audio_io_t *io)
+{
+    uint32_t ms, audio_ms;
+
+    if (!io)
+        return;
+    if (io->tap)
+        io->tap(io->tap_ctx, NULL, 0);
+    if (io->kind == AUDIO_IO_SERVER)
+    {
+        audio_close(io->client);
+        rt_free(io);
+        return;
+    }
+    if (io->kind == AUDIO_IO_MIX)
+    {
+        mixer_close(io->ch);
+        rt_free(io);
+        return;
+    }
+    if (io->thread)
+    {
+        io->is_exit = 1;
+        rt_sem_take(io->done, RT_WAITING_FOREVER);
+        rt_sem_delete(io->done);
+    }
+    if (io->fd >= 0)
+    {
+        if (!io->is_source)
+        {
+            uint8_t h[AUDIO_IO_WAV_HDR];
+
+            // without the sizes the file reads as an empty wav
+            wav_header(h, io->samplerate, io->channels, io->bytes);
+            if (lseek(io->fd, 0, SEEK_SET) != 0 || write(io->fd, h, sizeof(h)) != sizeof(h))
+            {
+                rt_kprintf("audio_io: wav header not updated\n");
+                io->errors++;
+            }
+        }
+        if (close(io->fd) != 0)
+        {
+            rt_kprintf("audio_io: close failed, the tail may be lost\n");
+            io->errors++;
+        }
+    }
+    ms = (rt_tick_get() - io->start) * 1000 / RT_TICK_PER_SECOND;
+    audio_ms = (uint32_t)((uint64_t)io->bytes * 1000 / (io->samplerate * io->channels * 2));
+    rt_kprintf("audio_io: %s %d bytes, %d ms of audio in %d ms, %d errors\n",
+               io->is_source ? "read" : "wrote", io->bytes, audio_ms, ms, io->errors);
+    rt_free(io);
+}
+
+int audio_io_write(audio_io_t *io, uint8_t *data, uint32_t len)
+{
+    int n;
+
+    switch (io->kind)
+    {
+    case AUDIO_IO_SERVER:
+        n = audio_write(io->client, data, len);
+        if (n > 0 && io->tap)
+            io->tap(io->tap_ctx, data, n);
+        return n;
+    case AUDIO_IO_MIX:
+        return mixer_write(io->ch, data, len);
+    case AUDIO_IO_WAV:
+        // a full disk drops audio, it must not stall the pipeline
+        if (write(io->fd, data, len) != len)
+        {
+            io->errors++;
+            return len;
+        }
+        break;
+    default:
+        break;
+    }
+    if (io->tap)
+        io->tap(io->tap_ctx, data, len);
+    io->bytes += len;
+    return len;
+}
+
+void audio_io_set_tap(audio_io_t *io, audio_io_tap_t tap, void *ctx)
+{
+    io->tap_ctx = ctx;
+    io->tap = tap;
+}
+
+void audio_io_set_catchup(audio_io_t *io, uint32_t target_ms)
+{
+    if (io->kind == AUDIO_IO_MIX)
+        mixer_set_catchup(io->ch, target_ms);
+}
+
+int audio_io_realtime(const audio_io_t *io)
+{
+    return io->kind == AUDIO_IO_SERVER || io->kind == AUDIO_IO_MIX;
+}
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file   audio_io.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __AUDIO_IO_H__
+#define __AUDIO_IO_H__
+
+#include <rtthread.h>
+#include "audio_server.h"
+
+/*
+ * Mic sources and speaker sinks behind one small interface, so the pipeline
+ * runs the same against the codec, a file or nothing at all:
+ *   NULL       audio_server on the local music device, real time
+ *   "null"     sink only, accepts everything at once
+ *   "x.wav"    pcm16 WAV file, read or written as fast as the CPU allows
+ *   "mix:P:n"  sink only, channel n of the speaker mixer at priority P
+ * Sources deliver data with as_callback_cmd_data_coming exactly like
+ * audio_server, and as_callback_cmd_play_to_end once a file is exhausted.
+ * A file source retries a frame the callback refuses with -RT_EFULL, the
+ * codec can not wait and drops it.
+ */
+typedef struct audio_io audio_io_t;
+
+audio_io_t  *audio_io_open_sink(const char *uri, audio_parameter_t *pa,
+                                audio_server_callback_func cb, void *ctx);
+audio_io_t  *audio_io_open_source(const char *uri, audio_parameter_t *pa,
+                                  audio_server_callback_func cb, void *ctx);
+void        audio_io_close(audio_io_t *io);
+
+/* Same contract as audio_write: 0 when the cache is full. */
+int         audio_io_write(audio_io_t *io, uint8_t *data, uint32_t len);
+
+/* Sees every sink write the moment it is accepted, exactly the bytes that
+ * will play; the echo canceller takes its far end reference here. Runs on
+ * the writer's thread, NULL removes it. Closing the sink calls it once
+ * with NULL data: what the cache held will not play. */
+typedef void (*audio_io_tap_t)(void *ctx, const uint8_t *data, uint32_t len);
+void        audio_io_set_tap(audio_io_t *io, audio_io_tap_t tap, void *ctx);
+
+/* Mixer channels play faster while more than target_ms is queued, see
+ * mixer_set_catchup; other sinks ignore it. */
+void        audio_io_set_catchup(audio_io_t *io, uint32_t target_ms);
+
+/* 1 for the codec and the mixer, 0 for files and the null sink. */
+int         audio_io_realtime(const audio_io_t *io);
+
+#endif /* __AUDIO_IO_H__ */
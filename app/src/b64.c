@@ -0,0 +1,400 @@
+/**
+  ******************************************************************************
+  * @file   b64.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "bf0_hal.h"
+#include "b64.h"
+#include "mbedtls/base64.h"
+#include "cycle_counter.h"
+
+/*
+ * Base64 for the audio paths. mbedtls decodes in constant time for key
+ * material, one table scan per character, which is wasted on audio. These
+ * kernels do one table lookup per character and move whole words: four
+ * output characters are stored with one 32 bit write (the core is little
+ * endian) and, on ARM, three input bytes come from one unaligned load.
+ */
+
+#define B64_INV     0x80
+#define B64_PAD     0x40
+
+static const uint8_t enc_tab[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const uint8_t dec_tab[256] =
+{
+#define X B64_INV
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, 62, X, X, X, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, X, X, X, B64_PAD, X, X,
+    X, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, X, X, X, X, X,
+    X, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+#undef X
+};
+
+static inline uint32_t b64_enc_quantum(uint32_t w)
+{
+    return (uint32_t)enc_tab[w >> 18]
+           | (uint32_t)enc_tab[(w >> 12) & 0x3F] << 8
+           | (uint32_t)enc_tab[(w >> 6) & 0x3F] << 16
+           | (uint32_t)enc_tab[w & 0x3F] << 24;
+}
+
+#if defined(__ARM_ARCH) && (__ARM_ARCH >= 7)
+/* Unaligned word load, top three bytes are the next input group. */
+static inline uint32_t b64_load24(const uint8_t *p)
+{
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return __REV(x) >> 8;
+}
+#define B64_LOAD_OVERREAD   1
+#else
+static inline uint32_t b64_load24(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+}
+#define B64_LOAD_OVERREAD   0
+#endif
+
+int b64_encode(uint8_t *dst, size_t dlen, size_t *olen, const uint8_t *src, size_t slen)
+{
+    size_t need = B64_ENCODED_LEN(slen);
+    uint8_t *d = dst;
+    uint32_t q;
+
+    *olen = need;
+    if (dlen < need)
+        return B64_ERR_BUFFER_TOO_SMALL;
+
+    // 12 bytes in, 16 characters out per iteration
+    while (slen >= 12 + B64_LOAD_OVERREAD)
+    {
+        q = b64_enc_quantum(b64_load24(src));
+        memcpy(d, &q, 4);
+        q = b64_enc_quantum(b64_load24(src + 3));
+        memcpy(d + 4, &q, 4);
+        q = b64_enc_quantum(b64_load24(src + 6));
+        memcpy(d + 8, &q, 4);
+        q = b64_enc_quantum(b64_load24(src + 9));
+        memcpy(d + 12, &q, 4);
+        src += 12;
+        slen -= 12;
+        d += 16;
+    }
+    while (slen >= 3)
+    {
+        q = b64_enc_quantum((uint32_t)src[0] << 16 | (uint32_t)src[1] << 8 | src[2]);
+        memcpy(d, &q, 4);
+        src += 3;
+        slen -= 3;
+        d += 4;
+    }
+    if (slen)
+    {
+        uint32_t w = (uint32_t)src[0] << 16 | (slen > 1 ? (uint32_t)src[1] << 8 : 0);
+        d[0] = enc_tab[w >> 18];
+        d[1] = enc_tab[(w >> 12) & 0x3F];
+        d[2] = slen > 1 ? enc_tab[(w >> 6) & 0x3F] : '=';
+        d[3] = '=';
+    }
+    return 0;
+}
+
+void b64_decode_init(b64_decoder_t *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+/* One character at a time, for quanta that straddle chunks or carry padding. */
+static int b64_decode_char(b64_decoder_t *dec, uint8_t c, uint8_t **d, uint8_t *end)
+{
+    uint8_t v = dec_tab[c];
+
+    if (v == B64_PAD)
+    {
+        if (dec->n < 2)
+            return B64_ERR_INVALID_CHARACTER;
+        dec->pad++;
+        if (dec->n + dec->pad < 4)
+            return 0;
+        // quantum complete: xx== gives one byte, xxx= gives two
+        if (*d + dec->n - 1 > end)
+            return B64_ERR_BUFFER_TOO_SMALL;
+        if (dec->n == 2)
+        {
+            *(*d)++ = (uint8_t)(dec->acc >> 4);
+        }
+        else
+        {
+            *(*d)++ = (uint8_t)(dec->acc >> 10);
+            *(*d)++ = (uint8_t)(dec->acc >> 2);
+        }
+        dec->n = 0;
+        dec->acc = 0;
+        dec->done = 1;
+        return 0;
+    }
+    if ((v & B64_INV) || dec->pad || dec->done)
+        return B64_ERR_INVALID_CHARACTER;
+
+    dec->acc = dec->acc << 6 | v;
+    if (++dec->n == 4)
+    {
+        if (*d + 3 > end)
+            return B64_ERR_BUFFER_TOO_SMALL;
+        (*d)[0] = (uint8_t)(dec->acc >> 16);
+        (*d)[1] = (uint8_t)(dec->acc >> 8);
+        (*d)[2] = (uint8_t)dec->acc;
+        *d += 3;
+        dec->n = 0;
+        dec->acc = 0;
+    }
+    return 0;
+}
+
+int b64_decode_update(b64_decoder_t *dec, uint8_t *dst, size_t dlen, size_t *olen,
+                      const uint8_t *src, size_t slen)
+{
+    uint8_t *d = dst, *end = dst + dlen;
+    const uint8_t *s = src, *send = src + slen;
+    int ret = 0;
+
+    while (s < send)
+    {
+        // whole quanta, two per iteration when possible
+        if (!dec->n && !dec->done)
+        {
+            while (send - s >= 8 && end - d >= 6)
+            {
+                uint32_t a = dec_tab[s[0]], b = dec_tab[s[1]], c = dec_tab[s[2]], e = dec_tab[s[3]];
+                uint32_t f = dec_tab[s[4]], g = dec_tab[s[5]], h = dec_tab[s[6]], k = dec_tab[s[7]];
+                if ((a | b | c | e | f | g | h | k) & (B64_INV | B64_PAD))
+                    break;
+                uint32_t w0 = a << 18 | b << 12 | c << 6 | e;
+                uint32_t w1 = f << 18 | g << 12 | h << 6 | k;
+                d[0] = (uint8_t)(w0 >> 16);
+                d[1] = (uint8_t)(w0 >> 8);
+                d[2] = (uint8_t)w0;
+                d[3] = (uint8_t)(w1 >> 16);
+                d[4] = (uint8_t)(w1 >> 8);
+                d[5] = (uint8_t)w1;
+                s += 8;
+                d += 6;
+            }
+            if (s == send)
+                break;
+        }
+        ret = b64_decode_char(dec, *s++, &d, end);
+        if (ret)
+            break;
+    }
+    *olen = d - dst;
+    return ret;
+}
+
+int b64_decode_finish(b64_decoder_t *dec, uint8_t *dst, size_t dlen, size_t *olen)
+{
+    uint8_t *d = dst;
+    int ret = 0;
+
+    *olen = 0;
+    if (dec->n == 1 || (dec->pad && !dec->done))
+        return B64_ERR_INVALID_CHARACTER;
+    // unpadded tail, finish it as if the '=' had been there
+    while (dec->n && !ret)
+        ret = b64_decode_char(dec, '=', &d, dst + dlen);
+    *olen = d - dst;
+    return ret;
+}
+
+int b64_decode(uint8_t *dst, size_t dlen, size_t *olen, const uint8_t *src, size_t slen)
+{
+    b64_decoder_t dec;
+    size_t n1, n2;
+    int ret;
+
+    b64_decode_init(&dec);
+    ret = b64_decode_update(&dec, dst, dlen, &n1, src, slen);
+    if (!ret)
+        ret = b64_decode_finish(&dec, dst + n1, dlen - n1, &n2);
+    *olen = ret ? 0 : n1 + n2;
+    return ret;
+}
+
+/* Round trip against mbedtls ----------------------------------------------*/
+#define B64_TEST_MAX_LEN    1024
+
+static uint32_t b64_test_rand(uint32_t *seed)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed >> 24;
+}
+
+static int b64_test_len(uint8_t *src, uint8_t *enc, uint8_t *ref, uint8_t *dec, size_t len)
+{
+    size_t olen, rlen, n1, n2, n3;
+    b64_decoder_t d;
+
+    if (b64_encode(enc, B64_ENCODED_LEN(len), &olen, src, len)
+            || mbedtls_base64_encode(ref, B64_ENCODED_LEN(len) + 1, &rlen, src, len)
+            || olen != rlen || memcmp(enc, ref, olen))
+        return -1;
+    if (b64_decode(dec, len, &n1, enc, olen) || n1 != len || memcmp(dec, src, len))
+        return -2;
+    // every chunk boundary must give the same bytes
+    for (size_t cut = 0; cut <= olen; cut += 1 + (olen > 64) * 7)
+    {
+        b64_decode_init(&d);
+        if (b64_decode_update(&d, dec, len, &n1, enc, cut)
+                || b64_decode_update(&d, dec + n1, len - n1, &n2, enc + cut, olen - cut)
+                || b64_decode_finish(&d, dec + n1 + n2, len - n1 - n2, &n3)
+                || n1 + n2 + n3 != len || memcmp(dec, src, len))
+            return -3;
+    }
+    return 0;
+}
+
+static void b64_test(int argc, char **argv)
+{
+    // src, enc, ref with room for mbedtls' terminator, dec
+    const size_t enc_off = B64_TEST_MAX_LEN;
+    const size_t ref_off = enc_off + B64_ENCODED_LEN(B64_TEST_MAX_LEN);
+    const size_t dec_off = ref_off + B64_ENCODED_LEN(B64_TEST_MAX_LEN) + 4;
+    uint8_t *src = rt_malloc(dec_off + B64_TEST_MAX_LEN);
+    uint8_t *enc = src + enc_off;
+    uint8_t *ref = src + ref_off;
+    uint8_t *dec = src + dec_off;
+    uint32_t seed = 1;
+    int ret;
+
+    if (!src)
+        return;
+    for (size_t len = 0; len <= B64_TEST_MAX_LEN; len++)
+    {
+        for (size_t i = 0; i < len; i++)
+            src[i] = (uint8_t)b64_test_rand(&seed);
+        ret = b64_test_len(src, enc, ref, dec, len);
+        if (ret)
+        {
+            rt_kprintf("b64: FAIL len %d (%d)\n", len, ret);
+            goto Exit;
+        }
+    }
+    if (argc > 1 && strcmp(argv[1], "all") == 0)
+    {
+        // every 3 byte input, i.e. every character in every position
+        for (uint32_t v = 0; v < (1 << 24); v++)
+        {
+            src[0] = (uint8_t)(v >> 16);
+            src[1] = (uint8_t)(v >> 8);
+            src[2] = (uint8_t)v;
+            ret = b64_test_len(src, enc, ref, dec, 3);
+            if (ret)
+            {
+                rt_kprintf("b64: FAIL value 0x%06x (%d)\n", v, ret);
+                goto Exit;
+            }
+        }
+    }
+    rt_kprintf("b64: PASS\n");
+Exit:
+    rt_free(src);
+}
+MSH_CMD_EXPORT(b64_test, b64_test [all]: base64 round trip against mbedtls);
+
+#define B64_BENCH_LEN       3200    // 100 ms of 16 kHz pcm16
+#define B64_BENCH_LOOPS     50
+
+static void b64_bench(int argc, char **argv)
+{
+    uint8_t *src = rt_malloc(B64_BENCH_LEN + B64_ENCODED_LEN(B64_BENCH_LEN) + 1 + B64_BENCH_LEN);
+    uint8_t *enc = src + B64_BENCH_LEN;
+    uint8_t *dec = enc + B64_ENCODED_LEN(B64_BENCH_LEN) + 1;
+    uint32_t seed = 1, c[4] = {0}, start;
+    size_t olen, elen = B64_ENCODED_LEN(B64_BENCH_LEN);
+
+    if (!src)
+        return;
+    for (int i = 0; i < B64_BENCH_LEN; i++)
+        src[i] = (uint8_t)b64_test_rand(&seed);
+
+    cycle_counter_init();
+    for (int i = 0; i < B64_BENCH_LOOPS; i++)
+    {
+        start = cycle_counter_get();
+        mbedtls_base64_encode(enc, elen + 1, &olen, src, B64_BENCH_LEN);
+        c[0] += cycle_counter_get() - start;
+        start = cycle_counter_get();
+        b64_encode(enc, elen, &olen, src, B64_BENCH_LEN);
+        c[1] += cycle_counter_get() - start;
+        start = cycle_counter_get();
+        mbedtls_base64_decode(dec, B64_BENCH_LEN, &olen, enc, elen);
+        c[2] += cycle_counter_get() - start;
+        start = cycle_counter_get();
+        b64_decode(dec, B64_BENCH_LEN, &olen, enc, elen);
+        c[3] += cycle_counter_get() - start;
+    }
+    rt_kprintf("b64 cycles per input byte x100, %d byte buffers:\n", B64_BENCH_LEN);
+    rt_kprintf("  encode: mbedtls %d, b64 %d\n", c[0] / B64_BENCH_LOOPS * 100 / B64_BENCH_LEN,
+               c[1] / B64_BENCH_LOOPS * 100 / B64_BENCH_LEN);
+    rt_kprintf("  decode: mbedtls %d, b64 %d\n", c[2] / B64_BENCH_LOOPS * 100 / B64_BENCH_LEN,
+               c[3] / B64_BENCH_LOOPS * 100 / B64_BENCH_LEN);
+    rt_free(src);
+}
+MSH_CMD_EXPORT(b64_bench, Compare base64 kernels with mbedtls);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file   b64.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __B64_H__
+#define __B64_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define B64_ENCODED_LEN(n)      (((n) + 2) / 3 * 4)
+#define B64_DECODED_MAX(n)      (((n) + 3) / 4 * 3)
+
+#define B64_ERR_BUFFER_TOO_SMALL    (-0x002A)   // same values as mbedtls
+#define B64_ERR_INVALID_CHARACTER   (-0x002C)
+
+/* Streaming decoder state, carries a partial quantum across chunks. */
+typedef struct
+{
+    uint32_t    acc;
+    uint8_t     n;          // 6 bit groups in acc
+    uint8_t     pad;        // '=' seen in the current quantum
+    uint8_t     done;       // padding ended the stream
+} b64_decoder_t;
+
+/* Same contract as mbedtls_base64_encode/decode, no trailing NUL written. */
+int  b64_encode(uint8_t *dst, size_t dlen, size_t *olen, const uint8_t *src, size_t slen);
+int  b64_decode(uint8_t *dst, size_t dlen, size_t *olen, const uint8_t *src, size_t slen);
+
+void b64_decode_init(b64_decoder_t *dec);
+/* Decode a chunk, may end anywhere. *olen is the number of bytes written. */
+int  b64_decode_update(b64_decoder_t *dec, uint8_t *dst, size_t dlen, size_t *olen,
+                       const uint8_t *src, size_t slen);
+/* Flush an unpadded tail. */
+int  b64_decode_finish(b64_decoder_t *dec, uint8_t *dst, size_t dlen, size_t *olen);
+
+#endif /* __B64_H__ */
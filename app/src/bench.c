@@ -0,0 +1,387 @@
+/**
+  ******************************************************************************
+  * @file   bench.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dfs_posix.h"
+#include <cJSON.h>
+#include "b64.h"
+#include "spsc_ring.h"
+#include "capture.h"
+#include "cycle_counter.h"
+#include "mic_pre.h"
+
+#if PKG_USING_LIBHELIX
+    #include "mp3dec.h"
+#else
+#error "should config PKG_USING_LIBHELIX"
+#endif
+
+/*
+ * Kernel benchmarks on a recorded session (see capture.h). Every kernel is
+ * timed with the DWT counter with the scheduler locked, per unit of work,
+ * and compared against a baseline file of "name value" lines.
+ */
+#define BENCH_BASELINE          "/bench_base.txt"
+#define BENCH_THRESHOLD         10          // percent slower that counts as a regression
+#define BENCH_MAX_PAYLOAD       (256 * 1024) // stop after this much recorded payload
+#define BENCH_MP3_BUF           (MAINBUF_SIZE * 4)
+#define BENCH_MIC_FRAME         320
+
+typedef enum
+{
+    BENCH_JSON_EVENT,       // cJSON parse and free of server events
+    BENCH_JSON_DELTA,       // same for audio deltas rebuilt around recorded audio
+    BENCH_B64_ENCODE,
+    BENCH_B64_DECODE,
+    BENCH_MP3_FRAME,        // Helix MP3Decode on tts audio
+    BENCH_RING_FRAME,       // spsc put and get of one mic frame
+    BENCH_MIC_PRE,          // mic preprocessing of one 10 ms hop
+    BENCH_NUM
+} bench_kernel_t;
+
+static const struct
+{
+    const char *name;
+    const char *unit;
+    uint32_t    unit_bytes;     // 0 when counted per call
+} bench_info[BENCH_NUM] =
+{
+    {"json_event", "KB", 1024},
+    {"json_delta", "KB", 1024},
+    {"b64_encode", "KB", 1024},
+    {"b64_decode", "KB", 1024},
+    {"mp3_frame", "frame", 0},
+    {"ring_frame", "frame", 0},
+    {"mic_pre", "hop", 0},
+};
+
+typedef struct
+{
+    uint64_t    cycles[BENCH_NUM];
+    uint32_t    units[BENCH_NUM];       // bytes or calls
+    uint8_t     *mp3_buf;
+    int         mp3_left;
+    HMP3Decoder mp3;
+    int16_t     *pcm;
+    spsc_ring_t *ring;
+    mic_pre_t   *pre;
+} bench_t;
+
+static inline uint32_t bench_begin(void)
+{
+    rt_enter_critical();
+    return cycle_counter_get();
+}
+
+static inline void bench_end(bench_t *b, bench_kernel_t k, uint32_t start, uint32_t units)
+{
+    b->cycles[k] += cycle_counter_get() - start;
+    rt_exit_critical();
+    b->units[k] += units;
+}
+
+static void bench_json(bench_t *b, bench_kernel_t k, const char *text, uint32_t len)
+{
+    uint32_t start = bench_begin();
+    cJSON *root = cJSON_Parse(text);
+
+    cJSON_Delete(root);
+    bench_end(b, k, start, len);
+}
+
+static void bench_audio(bench_t *b, const uint8_t *audio, uint32_t len)
+{
+    static const char head[] = "{\"type\":\"response.audio.delta\",\"response_id\":\"resp_bench\",\"delta\":\"";
+    size_t elen = B64_ENCODED_LEN(len), olen;
+    char *json = rt_malloc(sizeof(head) + elen + 3);
+    uint8_t *dec = rt_malloc(len);
+    uint32_t start;
+
+    if (!json || !dec)
+        goto Exit;
+    memcpy(json, head, sizeof(head) - 1);
+    start = bench_begin();
+    b64_encode((uint8_t *)json + sizeof(head) - 1, elen + 1, &olen, audio, len);
+    bench_end(b, BENCH_B64_ENCODE, start, len);
+    strcpy(json + sizeof(head) - 1 + olen, "\"}");
+
+    start = bench_begin();
+    b64_decode(dec, len, &olen, (uint8_t *)json + sizeof(head) - 1, elen);
+    bench_end(b, BENCH_B64_DECODE, start, len);
+    if (olen != len || memcmp(dec, audio, len))
+        rt_kprintf("bench: base64 round trip mismatch\n");
+
+    bench_json(b, BENCH_JSON_DELTA, json, strlen(json));
+Exit:
+    rt_free(json);
+    rt_free(dec);
+}
+
+static void bench_mp3(bench_t *b, const uint8_t *data, uint32_t len)
+{
+    while (len)
+    {
+        uint32_t n = BENCH_MP3_BUF - b->mp3_left;
+        uint8_t *ptr;
+        int offset;
+
+        if (n > len)
+            n = len;
+        memcpy(b->mp3_buf + b->mp3_left, data, n);
+        b->mp3_left += n;
+        data += n;
+        len -= n;
+        // decode while a whole frame is surely buffered, like the tts thread
+        ptr = b->mp3_buf;
+        while (b->mp3_left >= MAINBUF_SIZE && (offset = MP3FindSyncWord(ptr, b->mp3_left)) >= 0)
+        {
+            uint32_t start;
+            int err;
+
+            ptr += offset;
+            b->mp3_left -= offset;
+            if (b->mp3_left < MAINBUF_SIZE)
+                break;
+            start = bench_begin();
+            err = MP3Decode(b->mp3, &ptr, &b->mp3_left, b->pcm, 0);
+            bench_end(b, BENCH_MP3_FRAME, start, err ? 0 : 1);
+            if (err)
+            {
+                ptr++;
+                b->mp3_left--;
+            }
+        }
+        memmove(b->mp3_buf, ptr, b->mp3_left);
+    }
+}
+
+static void bench_ring(bench_t *b, const uint8_t *data, uint32_t len)
+{
+    uint8_t frame[BENCH_MIC_FRAME];
+
+    for (; len >= BENCH_MIC_FRAME; len -= BENCH_MIC_FRAME, data += BENCH_MIC_FRAME)
+    {
+        uint32_t start = bench_begin();
+        spsc_ring_put(b->ring, data, BENCH_MIC_FRAME);
+        spsc_ring_get_frame(b->ring, frame, BENCH_MIC_FRAME);
+        bench_end(b, BENCH_RING_FRAME, start, 1);
+    }
+}
+
+static void bench_mic_pre(bench_t *b, const uint8_t *data, uint32_t len)
+{
+    int16_t hop[MIC_PRE_HOP];
+
+    for (; len >= sizeof(hop); len -= sizeof(hop), data += sizeof(hop))
+    {
+        uint32_t start;
+
+        memcpy(hop, data, sizeof(hop));
+        start = bench_begin();
+        mic_pre_process(b->pre, hop);
+        bench_end(b, BENCH_MIC_PRE, start, 1);
+    }
+}
+
+static int bench_run(bench_t *b, const char *path)
+{
+    struct
+    {
+        uint32_t    time;
+        uint8_t     type;
+        uint8_t     flags;
+        uint16_t    len;
+    } rec;
+    uint8_t hdr[12];
+    uint32_t total = 0;
+    uint8_t *payload;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || read(fd, hdr, sizeof(hdr)) != sizeof(hdr) || memcmp(hdr, CAPTURE_MAGIC, 4))
+    {
+        rt_kprintf("bench: %s is not a session capture\n", path);
+        if (fd >= 0)
+            close(fd);
+        return -RT_ERROR;
+    }
+    payload = rt_malloc(65536 + 1);
+    RT_ASSERT(payload);
+    while (total < BENCH_MAX_PAYLOAD && read(fd, &rec, sizeof(rec)) == sizeof(rec)
+            && read(fd, payload, rec.len) == rec.len)
+    {
+        payload[rec.len] = '\0';
+        total += rec.len;
+        switch (rec.type)
+        {
+        case CAP_WS_RX:
+            bench_json(b, BENCH_JSON_EVENT, (const char *)payload, rec.len);
+            break;
+        case CAP_RX_AUDIO:
+            bench_audio(b, payload, rec.len);
+            if (rec.flags & CAP_FLAG_TTS)
+                bench_mp3(b, payload, rec.len);
+            break;
+        case CAP_MIC:
+            bench_mic_pre(b, payload, rec.len);
+            bench_ring(b, payload, rec.len);
+            break;
+        case CAP_TX_AUDIO:
+            bench_ring(b, payload, rec.len);
+            break;
+        default:
+            break;
+        }
+    }
+    rt_free(payload);
+    close(fd);
+    rt_kprintf("bench: %d bytes of recorded payload\n", total);
+    return RT_EOK;
+}
+
+static uint32_t bench_per_unit(bench_t *b, int k)
+{
+    if (!b->units[k])
+        return 0;
+    if (bench_info[k].unit_bytes)
+        return (uint32_t)(b->cycles[k] * bench_info[k].unit_bytes / b->units[k]);
+    return (uint32_t)(b->cycles[k] / b->units[k]);
+}
+
+static void volc_bench(int argc, char **argv)
+{
+    uint32_t base[BENCH_NUM] = {0};
+    int threshold = argc > 3 ? atoi(argv[3]) : BENCH_THRESHOLD;
+    int save = argc > 2 && strcmp(argv[2], "save") == 0;
+    int regressions = 0, k;
+    char name[16];
+    unsigned value;
+    bench_t *b;
+    FILE *fp;
+
+    if (argc < 2)
+    {
+        rt_kprintf("usage: volc_bench <capture> [save|check] [threshold%%]\n");
+        return;
+    }
+    b = rt_calloc(1, sizeof(bench_t));
+    RT_ASSERT(b);
+    b->mp3_buf = rt_malloc(BENCH_MP3_BUF);
+    b->pcm = rt_malloc(sizeof(short) * MAX_NCHAN * MAX_NGRAN * MAX_NSAMP);
+    b->mp3 = MP3InitDecoder();
+    b->ring = spsc_ring_create(4096);
+    b->pre = rt_malloc(sizeof(mic_pre_t));
+    RT_ASSERT(b->mp3_buf && b->pcm && b->mp3 && b->ring && b->pre);
+    mic_pre_init(b->pre, MIC_PRE_ALL);
+
+    cycle_counter_init();
+    if (bench_run(b, argv[1]) != RT_EOK)
+        goto Exit;
+
+    fp = fopen(BENCH_BASELINE, "r");
+    if (fp)
+    {
+        while (fscanf(fp, "%15s %u", name, &value) == 2)
+        {
+            for (k = 0; k < BENCH_NUM; k++)
+            {
+                if (strcmp(name, bench_info[k].name) == 0)
+                    base[k] = value;
+            }
+        }
+        fclose(fp);
+    }
+
+    rt_kprintf("%-11s %10s %12s %10s\n", "kernel", "cycles", "per", "baseline");
+    for (k = 0; k < BENCH_NUM; k++)
+    {
+        uint32_t per = bench_per_unit(b, k);
+        int slow;
+
+        if (!per)
+        {
+            rt_kprintf("%-11s %10s   no data in capture\n", bench_info[k].name, "-");
+            continue;
+        }
+        slow = base[k] && (uint64_t)per * 100 > (uint64_t)base[k] * (100 + threshold);
+        regressions += slow;
+        rt_kprintf("%-11s %10u %12s %10u %s", bench_info[k].name, per, bench_info[k].unit, base[k],
+                   slow ? "REGRESSED" : base[k] ? "ok" : "");
+        if (bench_info[k].unit_bytes)
+            rt_kprintf(" (%d KB/s)", (uint32_t)((uint64_t)SystemCoreClock / per));
+        else
+            rt_kprintf(" (%d per s)", SystemCoreClock / per);
+        rt_kprintf("\n");
+    }
+    rt_kprintf("bench: %d regressions over %d%%\n", regressions, threshold);
+
+    if (save)
+    {
+        fp = fopen(BENCH_BASELINE, "w");
+        if (!fp)
+        {
+            rt_kprintf("bench: cannot write %s\n", BENCH_BASELINE);
+            goto Exit;
+        }
+        for (k = 0; k < BENCH_NUM; k++)
+        {
+            if (bench_per_unit(b, k))
+                fprintf(fp, "%s %u\n", bench_info[k].name, (unsigned)bench_per_unit(b, k));
+        }
+        fclose(fp);
+        rt_kprintf("bench: baseline saved to %s\n", BENCH_BASELINE);
+    }
+Exit:
+    MP3FreeDecoder(b->mp3);
+    spsc_ring_destroy(b->ring);
+    rt_free(b->pre);
+    rt_free(b->mp3_buf);
+    rt_free(b->pcm);
+    rt_free(b);
+}
+MSH_CMD_EXPORT(volc_bench, volc_bench <capture> [save|check] [threshold%]: kernel benchmarks);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,223 @@
+/**
+  ******************************************************************************
+  * @file   boot.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "boot.h"
+
+#define BOOT_MAX_STEPS          16
+#define BOOT_MAX_MARKS          16
+#define BOOT_WORKERS            3
+#define BOOT_EVENT_DONE         (1 << 0)
+
+typedef struct
+{
+    const boot_step_t   *steps;
+    int                 count;
+    uint32_t            started;
+    uint32_t            done;
+    rt_tick_t           start[BOOT_MAX_STEPS];
+    rt_tick_t           end[BOOT_MAX_STEPS];
+    uint8_t             worker[BOOT_MAX_STEPS];
+    const char          *mark_name[BOOT_MAX_MARKS];
+    rt_tick_t           mark_tick[BOOT_MAX_MARKS];
+    int                 marks;
+    int                 workers_left;
+    rt_sem_t            progress;
+    rt_event_t          event;
+} boot_t;
+
+static boot_t g_boot;
+
+static uint32_t boot_ms(rt_tick_t tick)
+{
+    return tick * 1000 / RT_TICK_PER_SECOND;
+}
+
+/* Claims a step whose dependencies are done, -1 if none is ready yet. */
+static int boot_claim(boot_t *thiz, int *all_started)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    int i, found = -1;
+
+    for (i = 0; i < thiz->count; i++)
+    {
+        if ((thiz->started & BOOT_DEP(i)) || (thiz->steps[i].deps & ~thiz->done))
+            continue;
+        thiz->started |= BOOT_DEP(i);
+        found = i;
+        break;
+    }
+    *all_started = thiz->started == BOOT_DEP(thiz->count) - 1;
+    rt_hw_interrupt_enable(level);
+    return found;
+}
+
+static void boot_worker_entry(void *p)
+{
+    boot_t *thiz = &g_boot;
+    uint8_t id = (uint8_t)(rt_ubase_t)p;
+    int all_started, i, last;
+
+    while (1)
+    {
+        int step = boot_claim(thiz, &all_started);
+
+        if (step < 0)
+        {
+            if (all_started)
+                break;
+            rt_sem_take(thiz->progress, RT_WAITING_FOREVER);
+            continue;
+        }
+        thiz->worker[step] = id;
+        thiz->start[step] = rt_tick_get();
+        thiz->steps[step].run();
+        thiz->end[step] = rt_tick_get();
+
+        rt_base_t level = rt_hw_interrupt_disable();
+        thiz->done |= BOOT_DEP(step);
+        rt_hw_interrupt_enable(level);
+        // a finished step may unblock work for every idle worker
+        for (i = 0; i < BOOT_WORKERS; i++)
+            rt_sem_release(thiz->progress);
+    }
+
+    rt_base_t level = rt_hw_interrupt_disable();
+    last = --thiz->workers_left == 0;
+    rt_hw_interrupt_enable(level);
+    if (last)
+    {
+        boot_mark("boot_done");
+        rt_event_send(thiz->event, BOOT_EVENT_DONE);
+    }
+}
+
+void boot_start(const boot_step_t *steps, int count)
+{
+    boot_t *thiz = &g_boot;
+    char name[RT_NAME_MAX];
+    int i;
+
+    RT_ASSERT(count > 0 && count <= BOOT_MAX_STEPS);
+    thiz->steps = steps;
+    thiz->count = count;
+    thiz->workers_left = BOOT_WORKERS;
+    thiz->progress = rt_sem_create("boot", 0, RT_IPC_FLAG_FIFO);
+    thiz->event = rt_event_create("boot", RT_IPC_FLAG_FIFO);
+    RT_ASSERT(thiz->progress && thiz->event);
+    for (i = 0; i < BOOT_WORKERS; i++)
+    {
+        rt_thread_t tid;
+
+        rt_snprintf(name, sizeof(name), "boot%d", i);
+        tid = rt_thread_create(name, boot_worker_entry, (void *)(rt_ubase_t)i, 3072,
+                               RT_THREAD_PRIORITY_MIDDLE, RT_THREAD_TICK_DEFAULT);
+        RT_ASSERT(tid);
+        rt_thread_startup(tid);
+    }
+}
+
+rt_err_t boot_wait(int32_t timeout)
+{
+    boot_t *thiz = &g_boot;
+    rt_uint32_t evt;
+
+    if (!thiz->event)
+        return RT_EOK;      // no boot graph, nothing to wait for
+    return rt_event_recv(thiz->event, BOOT_EVENT_DONE, RT_EVENT_FLAG_OR, timeout, &evt);
+}
+
+void boot_mark(const char *name)
+{
+    boot_t *thiz = &g_boot;
+    rt_tick_t now = rt_tick_get();
+    rt_base_t level = rt_hw_interrupt_disable();
+    int i;
+
+    for (i = 0; i < thiz->marks; i++)
+    {
+        if (thiz->mark_name[i] == name || strcmp(thiz->mark_name[i], name) == 0)
+            break;
+    }
+    if (i == thiz->marks && thiz->marks < BOOT_MAX_MARKS)
+    {
+        thiz->mark_name[i] = name;
+        thiz->mark_tick[i] = now;
+        thiz->marks++;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static void boot_stat(int argc, char **argv)
+{
+    boot_t *thiz = &g_boot;
+    int i, j;
+
+    rt_kprintf("%-10s %8s %8s %8s  worker  after\n", "step", "start", "end", "ms");
+    for (i = 0; i < thiz->count; i++)
+    {
+        const boot_step_t *s = &thiz->steps[i];
+
+        if (!(thiz->done & BOOT_DEP(i)))
+        {
+            rt_kprintf("%-10s %8s\n", s->name, (thiz->started & BOOT_DEP(i)) ? "running" : "waiting");
+            continue;
+        }
+        rt_kprintf("%-10s %8d %8d %8d  boot%d  ", s->name, boot_ms(thiz->start[i]), boot_ms(thiz->end[i]),
+                   boot_ms(thiz->end[i] - thiz->start[i]), thiz->worker[i]);
+        for (j = 0; j < thiz->count; j++)
+        {
+            if (s->deps & BOOT_DEP(j))
+                rt_kprintf("%s ", thiz->steps[j].name);
+        }
+        rt_kprintf("\n");
+    }
+    // milestones in the order they were reached, ms since power on
+    for (i = 0; i < thiz->marks; i++)
+        rt_kprintf("%-10s %8d\n", thiz->mark_name[i], boot_ms(thiz->mark_tick[i]));
+}
+MSH_CMD_EXPORT(boot_stat, boot step and milestone timeline);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file   boot.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __BOOT_H__
+#define __BOOT_H__
+
+#include <rtthread.h>
+#include <stdint.h>
+
+/*
+ * Startup as a dependency graph. Each step runs on one of a small pool of
+ * boot workers as soon as the steps in its deps mask have finished, so
+ * independent steps (file system, Bluetooth, audio pipeline) overlap.
+ * Step start and end times, plus milestones marked later by the pipeline,
+ * make up the boot timeline shown by `boot_stat`.
+ */
+#define BOOT_DEP(step)          (1u << (step))
+
+typedef struct
+{
+    const char  *name;
+    void        (*run)(void);
+    uint32_t    deps;           // BOOT_DEP() of steps that must finish first
+} boot_step_t;
+
+void     boot_start(const boot_step_t *steps, int count);
+/* Waits for every boot step, returns -RT_ETIMEOUT if they are still running. */
+rt_err_t boot_wait(int32_t timeout);
+/* Records the first time a milestone is reached; name must be a literal. */
+void     boot_mark(const char *name);
+
+#endif /* __BOOT_H__ */
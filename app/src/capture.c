@@ -0,0 +1,240 @@
+/**
+  ******************************************************************************
+  * @file   capture.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "dfs_posix.h"
+#include "capture.h"
+
+#define CAPTURE_DEFAULT_PATH    "/session.vcap"
+#define CAPTURE_RING_SIZE       (16 * 1024)
+#define CAPTURE_CHUNK           2048
+#define CAPTURE_FLUSH_LEVEL     (CAPTURE_RING_SIZE / 4)
+
+#define CAPTURE_EVENT_DATA      (1 << 0)
+#define CAPTURE_EVENT_STOP      (1 << 1)
+
+typedef struct
+{
+    uint32_t    time;
+    uint8_t     type;
+    uint8_t     flags;
+    uint16_t    len;
+} capture_rec_t;
+
+typedef struct
+{
+    rt_thread_t     thread;
+    rt_event_t      event;
+    rt_mutex_t      lock;
+    struct rt_ringbuffer *rb;
+    int             fd;
+    rt_tick_t       start;
+    uint32_t        records;
+    uint32_t        bytes;
+    uint32_t        dropped;
+    uint32_t        peak;
+    uint8_t         chunk[CAPTURE_CHUNK];
+} capture_t;
+
+static capture_t g_capture;
+volatile uint8_t g_capture_on;
+
+/* Drains the RAM ring to the file at low priority, so producers only
+ * ever pay for a memcpy. */
+static void capture_thread_entry(void *p)
+{
+    capture_t *thiz = &g_capture;
+    int stop = 0;
+
+    while (!stop)
+    {
+        rt_uint32_t evt = 0;
+        rt_event_recv(thiz->event, CAPTURE_EVENT_DATA | CAPTURE_EVENT_STOP, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                      rt_tick_from_millisecond(500), &evt);
+        stop = (evt & CAPTURE_EVENT_STOP) != 0;
+        while (1)
+        {
+            rt_mutex_take(thiz->lock, RT_WAITING_FOREVER);
+            size_t n = rt_ringbuffer_get(thiz->rb, thiz->chunk, CAPTURE_CHUNK);
+            rt_mutex_release(thiz->lock);
+            if (!n)
+                break;
+            if (write(thiz->fd, thiz->chunk, n) != n)
+            {
+                rt_kprintf("vcap: write fail, capture stopped\n");
+                g_capture_on = 0;
+                break;
+            }
+            thiz->bytes += n;
+        }
+    }
+    close(thiz->fd);
+    thiz->fd = -1;
+}
+
+int capture_start(const char *path)
+{
+    capture_t *thiz = &g_capture;
+    uint8_t hdr[12] = CAPTURE_MAGIC;
+    uint32_t start_ms;
+
+    if (thiz->thread)
+        return -RT_EBUSY;
+    if (!thiz->lock)
+    {
+        thiz->lock = rt_mutex_create("vcap", RT_IPC_FLAG_FIFO);
+        thiz->event = rt_event_create("vcap", RT_IPC_FLAG_FIFO);
+        RT_ASSERT(thiz->lock && thiz->event);
+    }
+    thiz->rb = rt_ringbuffer_create(CAPTURE_RING_SIZE);
+    if (!thiz->rb)
+        return -RT_ENOMEM;
+    thiz->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (thiz->fd < 0)
+    {
+        rt_ringbuffer_destroy(thiz->rb);
+        thiz->rb = NULL;
+        return -RT_ERROR;
+    }
+
+    thiz->start = rt_tick_get();
+    start_ms = thiz->start * 1000 / RT_TICK_PER_SECOND;
+    hdr[4] = CAPTURE_VERSION;
+    memcpy(&hdr[8], &start_ms, sizeof(start_ms));
+    write(thiz->fd, hdr, sizeof(hdr));
+    thiz->records = 0;
+    thiz->bytes = sizeof(hdr);
+    thiz->dropped = 0;
+    thiz->peak = 0;
+
+    thiz->thread = rt_thread_create("vcap",
+                                    capture_thread_entry,
+                                    NULL,
+                                    2048,
+                                    RT_THREAD_PRIORITY_LOW,
+                                    RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->thread);
+    rt_thread_startup(thiz->thread);
+    g_capture_on = 1;
+    return RT_EOK;
+}
+
+void capture_stop(void)
+{
+    capture_t *thiz = &g_capture;
+
+    if (!thiz->thread)
+        return;
+    g_capture_on = 0;
+    rt_event_send(thiz->event, CAPTURE_EVENT_STOP);
+    while (rt_thread_find("vcap"))
+        rt_thread_mdelay(10);
+    thiz->thread = NULL;
+    rt_mutex_take(thiz->lock, RT_WAITING_FOREVER);
+    rt_ringbuffer_destroy(thiz->rb);
+    thiz->rb = NULL;
+    rt_mutex_release(thiz->lock);
+}
+
+void capture_record(uint8_t type, uint8_t flags, const void *data, uint32_t len)
+{
+    capture_t *thiz = &g_capture;
+    capture_rec_t rec;
+    size_t level;
+
+    if (!g_capture_on)
+        return;
+    if (len > 0xFFFF)
+        len = 0xFFFF;
+    rec.time = (rt_tick_get() - thiz->start) * 1000 / RT_TICK_PER_SECOND;
+    rec.type = type;
+    rec.flags = flags;
+    rec.len = (uint16_t)len;
+
+    rt_mutex_take(thiz->lock, RT_WAITING_FOREVER);
+    if (!g_capture_on || rt_ringbuffer_space_len(thiz->rb) < sizeof(rec) + len)
+    {
+        // never block the pipeline on the filesystem
+        thiz->dropped++;
+        rt_mutex_release(thiz->lock);
+        return;
+    }
+    rt_ringbuffer_put(thiz->rb, (const uint8_t *)&rec, sizeof(rec));
+    rt_ringbuffer_put(thiz->rb, data, len);
+    level = rt_ringbuffer_data_len(thiz->rb);
+    thiz->records++;
+    rt_mutex_release(thiz->lock);
+
+    if (level > thiz->peak)
+        thiz->peak = level;
+    if (level >= CAPTURE_FLUSH_LEVEL)
+        rt_event_send(thiz->event, CAPTURE_EVENT_DATA);
+}
+
+static void vcap(int argc, char **argv)
+{
+    capture_t *thiz = &g_capture;
+
+    if (argc > 1 && strcmp(argv[1], "start") == 0)
+    {
+        const char *path = argc > 2 ? argv[2] : CAPTURE_DEFAULT_PATH;
+        int ret = capture_start(path);
+        rt_kprintf("vcap: start %s %s\n", path, ret == RT_EOK ? "ok" : "fail");
+    }
+    else if (argc > 1 && strcmp(argv[1], "stop") == 0)
+    {
+        capture_stop();
+        rt_kprintf("vcap: stopped\n");
+    }
+    else
+    {
+        rt_kprintf("vcap: %s, %d records, %d bytes written, %d dropped, ring peak %d/%d\n",
+                   g_capture_on ? "capturing" : "idle", thiz->records, thiz->bytes,
+                   thiz->dropped, thiz->peak, CAPTURE_RING_SIZE);
+    }
+}
+MSH_CMD_EXPORT(vcap, vcap start [path] / stop / stat: capture a session to flash);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file   capture.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+
+/*
+ * Session capture file, little endian:
+ *   header  : "VCAP", uint16_t version, uint16_t reserved, uint32_t start tick (ms)
+ *   records : uint32_t time (ms since start), uint8_t type, uint8_t flags,
+ *             uint16_t length, payload
+ * Audio is stored as raw bytes, never as base64.
+ */
+#define CAPTURE_MAGIC           "VCAP"
+#define CAPTURE_VERSION         1
+
+typedef enum
+{
+    CAP_MIC = 1,        // raw mic pcm16 as delivered by audio_server
+    CAP_WS_TX,          // outbound WebSocket text, audio appends excluded
+    CAP_WS_RX,          // inbound WebSocket text, audio deltas excluded
+    CAP_TX_AUDIO,       // audio carried by input_audio_buffer.append
+    CAP_RX_AUDIO,       // audio carried by response.audio.delta
+    CAP_LEVELS,         // uint32_t mic ring, mp3 ring, bytes queued to the speaker
+    CAP_AUDIO_EVENT,    // uint8_t audio_server callback command
+} capture_type_t;
+
+/* flags */
+#define CAP_FLAG_CHAT           0x00
+#define CAP_FLAG_TTS            0x01
+
+int  capture_start(const char *path);
+void capture_stop(void);
+void capture_record(uint8_t type, uint8_t flags, const void *data, uint32_t len);
+
+extern volatile uint8_t g_capture_on;
+#define capture_active()        (g_capture_on)
+
+#endif /* __CAPTURE_H__ */
@@ -43,12 +43,14 @@
  *
  */
 #include <rtthread.h>
+#include <stdlib.h>
 #include "lwip/api.h"
 #include "lwip/apps/websocket_client.h"
 #include "lwip/apps/mqtt_priv.h"
 #include "lwip/apps/mqtt.h"
 #include "lwip/tcpip.h"
-#include "mbedtls/base64.h"
+#include "lwip/altcp.h"
+#include "b64.h"
 #include "bf0_hal.h"
 #include "bts2_global.h"
 #include "bts2_app_pan.h"
@@ -56,12 +58,41 @@
 #include "button.h"
 #include "audio_server.h"
 #include "mem_section.h"
+#include "reconnect.h"
+#include "link_policy.h"
+#include "kws.h"
+#include "ui.h"
+#include "capture.h"
+#include "spsc_ring.h"
+#include "trace.h"
+#include "prompt.h"
+#include "uplink.h"
+#include "boot.h"
+#include "chat.h"
+#include "stats.h"
+#include "audio_io.h"
+#include "linkq.h"
+#include "g711.h"
+#include "mic_pre.h"
+#include "aec.h"
+#include "rts.h"
+#include "mixer.h"
+#include "pipeline.h"
+#include "cycle_counter.h"
 
-#define MAX_WSOCK_HDR_LEN 512
-#define MAX_AUDIO_DATA_LEN 4096
+#define MAX_AUDIO_DATA_LEN          PIPE_DELTA_BYTES
 
-#define CHAT_MIC_FRAME_LEN          (320)  //100ms
-#define CHAT_FRAME_ENCODE_LEN       (CHAT_MIC_FRAME_LEN * 4 / 3 + 128)   //buffer.append
+#define CHAT_MIC_FRAME_LEN          PIPE_FRAME_BYTES
+#define CHAT_MIC_RING_SIZE          PIPE_MIC_RING
+#define CHAT_MIC_RAW_RING_SIZE      PIPE_MIC_RAW_RING   //codec audio for the dsp thread
+#define CHAT_FRAME_ENCODE_LEN       PIPE_UPLINK_B64     //buffer.append
+#define CHAT_JITTER_RING_SIZE       PIPE_JITTER_RING    //above the longest jitter target and a delta
+#define CHAT_ULAW_CHUNK             128    //mu-law bytes expanded at a time
+#define CHAT_PROBE_MSGS             3      //silence appends of UPLINK_MAX_AGG frames, ~11 KB
+#define CHAT_PROBE_TIMEOUT          2000   //ms for the probe to be acked
+#define CHAT_PROBE_IDLE_MS          20     //no ack this long, the send buffer is drained
+#define CHAT_REF_RING_SIZE          PIPE_REF_RING       //above the codec cache
+#define CHAT_SPEAKER_CACHE          PIPE_SPK_RING
 
 #define CHAT_HOST            "ai-gateway.vei.volces.com"
 #define CHAT_WSPATH          "/v1/realtime?model=AG-voice-chat-agent"
@@ -73,38 +104,120 @@
 #define CHAT_EVENT_SPK_TX         (1 << 1)
 #define CHAT_EVENT_DOWNLINK       (1 << 2)
 #define CHAT_EVENT_MIC_CLOSE      (1 << 3)
+#define CHAT_EVENT_TIMEOUT        (1 << 4)
+#define CHAT_EVENT_PROBE          (1 << 5)
+#define CHAT_EVENT_SESSION        (1 << 6)
 
-#define CHAT_EVENT_ALL            (CHAT_EVENT_MIC_RX | CHAT_EVENT_SPK_TX | CHAT_EVENT_DOWNLINK|CHAT_EVENT_MIC_CLOSE)
+#define CHAT_DSP_RAW              (1 << 0)    // codec audio queued, rb_mic has room again, or raw_end
+
+#define CHAT_RESPONSE_TIMEOUT     10000   // ms from commit to the first response event
+#define CHAT_RESPONSE_GAP         8000    // ms between events of a running response
+#define CHAT_FLUSH_TIMEOUT        500     // ms for the tail audio to get into the socket
+
+#define CHAT_WAKE_MODEL           "/kws.bin"
+#define CHAT_VAD_LEVEL            500     // mean abs sample level counted as speech
+#define CHAT_VAD_HANGOVER         80      // 10 ms frames of silence ending a wake turn
+#define CHAT_VAD_NO_SPEECH        300     // give up if nothing is said after the wake word
+#define CHAT_VAD_MAX_TURN         1500
+#define CHAT_DUPLEX_ONSET         3       // 10 ms frames of speech over the echo opening a turn
+#define CHAT_CATCHUP_MS           PIPE_CATCHUP_MS // answer backlog above the jitter target played faster
+
+#define CHAT_URI_LEN              64      // `chat -f` / `-o` file names
+#define CHAT_SPEAKER              "mix:0:chat"    // ducked under notifications
+
+#define CHAT_EVENT_ALL            (CHAT_EVENT_MIC_RX | CHAT_EVENT_SPK_TX | CHAT_EVENT_DOWNLINK|CHAT_EVENT_MIC_CLOSE|CHAT_EVENT_TIMEOUT|CHAT_EVENT_PROBE|CHAT_EVENT_SESSION)
 
 typedef enum
 {
     CT_CONNECTING,
     CT_SESSION_CREATED,
     CT_SESSION_UPDATED,
-    CT_BUFFER_APPEND,
-    CT_RESPONSE_CREATE,
+    CT_BUFFER_APPEND,       // turn open, mic audio being appended
+    CT_RESPONSE_CREATE,     // committed, waiting for the answer
+    CT_RESPONDING,          // answer audio arriving
     CT_RESPONSE_DONE,
 } chat_state;
 
+/* Link probe, run by the chat thread on CHAT_EVENT_PROBE from the acks
+ * and probe_timer. */
+typedef enum
+{
+    CHAT_PROBE_OFF,
+    CHAT_PROBE_DRAIN,       // waiting for earlier data to be acked
+    CHAT_PROBE_ACK,         // silent appends written, timing their acks
+} chat_probe_state;
+
+#define CT_BIT(s)           (1u << (s))
+#define CT_IDLE             (CT_BIT(CT_SESSION_UPDATED) | CT_BIT(CT_RESPONSE_DONE))
+#define CT_IN_RESPONSE      (CT_BIT(CT_RESPONSE_CREATE) | CT_BIT(CT_RESPONDING))
+
 typedef struct
 {
     rt_event_t              event;
-    struct rt_ringbuffer    *rb_mic;
+    spsc_ring_t             *rb_mic;
     uint32_t                mic_rx_count;
 
     rt_thread_t     thread;
-    audio_client_t  speaker;
-    audio_client_t  mic;
+    audio_io_t      *speaker;
+    audio_io_t      *spk_file;      // `chat -o` sink, one file for all answers of the invocation
+    audio_io_t      *mic;
+    char            mic_uri[CHAT_URI_LEN];  // empty: the codec
+    char            spk_uri[CHAT_URI_LEN];
     uint32_t        sample_rate;
     uint32_t        frame_duration;
     uint32_t        event_id;
-    wsock_state_t   clnt;
-    rt_sem_t        sem;
+    rts_t           rts;
     chat_state      state;
-    uint8_t         is_connected;
+    uint8_t         is_active;
+    uint8_t         is_resumed;
+    uint8_t         session_armed;  // session attempt waits for session.created
+    uint8_t         in_turn;
+    uint8_t         wake_word;      // mic stays open for the keyword spotter
+    uint8_t         turn_by_wake;
+    uint8_t         heard_speech;
+    uint16_t        silence_frames;
+    uint16_t        turn_frames;
+    uint32_t        spk_written;    // bytes queued since the speaker opened
+    rt_tick_t       spk_start;
+    uplink_ctrl_t   uplink;
+    uint32_t        turn_start_frames;  // uplink frames sent before this turn
+    rt_timer_t      turn_timer;
+    rt_mutex_t      spk_lock;       // speaker open/close against the downlink worker
+    uint16_t        up_pending;     // frames in encode_out refused by the socket
+    uint16_t        up_len;
+    linkq_t         linkq;
+    rt_timer_t      linkq_timer;
+    uint8_t         probe_state;    // chat_probe_state
+    uint8_t         probe_session;  // session.update waits for this probe
+    uint32_t        probe_ms;       // start of the probe phase
+    uint32_t        probe_next_ms;  // DRAIN: drained if no ack came before
+    uint32_t        probe_size;     // DRAIN: most send room seen
+    linkq_probe_t   probe;
+    rt_timer_t      probe_timer;
+    uint8_t         ulaw_in;        // link profile formats
+    uint8_t         ulaw_out;
+    g711_upsampler_t g711_up;
+    spsc_ring_t     *rb_jitter;     // answer audio held until jitter_bytes arrived
+    uint32_t        jitter_bytes;
+    uint8_t         spk_started;    // answer audio reached the speaker
+    uint32_t        catchup_ms;     // 0: answers always play at 1x
+    mic_pre_t       mic_pre;
+    rt_thread_t     dsp_thread;     // cleans mic audio, never the audio_server callback
+    rt_event_t      dsp_event;
+    spsc_ring_t     *rb_raw;        // codec audio waiting for the dsp thread
+    uint8_t         raw_end;        // file ended or Key1 released, close the turn after rb_raw
+    uint32_t        dsp_hops;
+    uint32_t        dsp_cycles_max; // measured in the running pipeline, all stages of a hop
+    uint64_t        dsp_cycles;
+    int16_t         mic_frame[MIC_PRE_HOP];     // the hop the dsp thread works on
+    aec_t           aec;
+    spsc_ring_t     *rb_ref;        // speaker audio not yet heard by the mic
+    int16_t         ref_frame[AEC_HOP];
+    uint8_t         duplex;         // mic open through answers, speech barges in
+    uint8_t         ref_flush;      // speaker closed, the consumer empties rb_ref
+    uint8_t         onset_frames;
     uint8_t         is_exit;
-    uint8_t         text[WSMSG_MAXSIZE];
-    uint8_t         encode_in[CHAT_MIC_FRAME_LEN];
+    uint8_t         encode_in[CHAT_MIC_FRAME_LEN * UPLINK_MAX_AGG];
     uint8_t         encode_out[CHAT_FRAME_ENCODE_LEN]; //base64
 } chat_ws_t;
 
@@ -116,27 +229,201 @@ typedef struct
     static  chat_ws_t g_thiz L2_RET_BSS_SECT(g_thiz);
 #endif
 
-static void parse_response(const u8_t *data, u16_t len);
+static void parse_response(void *ctx, const char *data, size_t len);
+static void chat_link_recheck(chat_ws_t *thiz);
+static void chat_link_probe_step(chat_ws_t *thiz);
+static void chat_link_probe_finish(chat_ws_t *thiz);
+static void chat_session_configure(chat_ws_t *thiz);
+static void chat_wake_detected(void);
 
 static const char buffer_append[] = "{\"type\": \"input_audio_buffer.append\",\"audio\" : \"";
 
 
+static uint32_t chat_level(const int16_t *pcm, uint32_t samples)
+{
+    uint32_t level = 0;
+
+    for (uint32_t i = 0; i < samples; i++)
+        level += pcm[i] < 0 ? -pcm[i] : pcm[i];
+    return samples ? level / samples : 0;
+}
+
+/* End a wake word turn on trailing silence, like releasing Key1. */
+static int chat_wake_turn_done(chat_ws_t *thiz, const int16_t *pcm, uint32_t samples)
+{
+    uint32_t level = chat_level(pcm, samples);
+
+    thiz->turn_frames++;
+    if (level >= CHAT_VAD_LEVEL)
+    {
+        thiz->heard_speech = 1;
+        thiz->silence_frames = 0;
+    }
+    else
+    {
+        thiz->silence_frames++;
+    }
+    if (thiz->heard_speech)
+        return thiz->silence_frames >= CHAT_VAD_HANGOVER || thiz->turn_frames >= CHAT_VAD_MAX_TURN;
+    return thiz->turn_frames >= CHAT_VAD_NO_SPEECH;
+}
+
+/* Runs on the mixer thread with everything the speaker plays, the
+ * notifications mixed over an answer included. */
+static void chat_ref_tap(void *ctx, const uint8_t *data, uint32_t len)
+{
+    chat_ws_t *thiz = (chat_ws_t *)ctx;
+
+    if (!data)
+        thiz->ref_flush = 1;    // the codec closed, its cache with it
+    else if (thiz->duplex)
+        spsc_ring_put(thiz->rb_ref, data, len);
+}
+
+/* The mic hop minus the speaker's echo, in place. The reference
+ * leaves rb_ref at the rate the codec plays it, so what is left in the
+ * ring is what sits in the speaker cache, and the frame taken is the one
+ * playing now; the canceller finds the rest of the delay itself. */
+static void chat_echo_cancel(chat_ws_t *thiz, int16_t *mic)
+{
+    uint32_t n;
+
+    if (thiz->ref_flush)
+    {
+        thiz->ref_flush = 0;
+        spsc_ring_reset(thiz->rb_ref);
+    }
+    n = spsc_ring_get(thiz->rb_ref, thiz->ref_frame, sizeof(thiz->ref_frame));
+    memset((uint8_t *)thiz->ref_frame + n, 0, sizeof(thiz->ref_frame) - n);
+    aec_process(&thiz->aec, thiz->ref_frame, mic);
+}
+
+/* Duplex without a wake word: speech left after the echo opens a turn,
+ * over an answer that is a barge in. */
+static int chat_duplex_onset(chat_ws_t *thiz, const int16_t *pcm, uint32_t samples)
+{
+    if (chat_level(pcm, samples) < CHAT_VAD_LEVEL)
+    {
+        thiz->onset_frames = 0;
+        return 0;
+    }
+    return ++thiz->onset_frames >= CHAT_DUPLEX_ONSET;
+}
+
+/* Ends the turn on the dsp thread, behind the last hop it processed: the
+ * hop noise suppression holds back and the partial last frame go out
+ * with the turn instead of being reset away by the commit. */
+static void chat_mic_close(chat_ws_t *thiz)
+{
+    uint32_t part, n;
+
+    if (thiz->in_turn)
+    {
+        if (thiz->mic_pre.flags && mic_pre_flush(&thiz->mic_pre, thiz->mic_frame))
+            spsc_ring_put(thiz->rb_mic, thiz->mic_frame, sizeof(thiz->mic_frame));
+        mic_pre_reset(&thiz->mic_pre);
+        // the uplink sends whole frames, pad the last one with silence
+        part = spsc_ring_data_len(thiz->rb_mic) % CHAT_MIC_FRAME_LEN;
+        memset(thiz->mic_frame, 0, sizeof(thiz->mic_frame));
+        for (part = part ? CHAT_MIC_FRAME_LEN - part : 0; part; part -= n)
+        {
+            n = part < sizeof(thiz->mic_frame) ? part : sizeof(thiz->mic_frame);
+            spsc_ring_put(thiz->rb_mic, thiz->mic_frame, n);
+        }
+        thiz->mic_rx_count = 0;
+        thiz->in_turn = 0;
+    }
+    rt_event_send(thiz->event, CHAT_EVENT_MIC_CLOSE);
+}
+
+/* One hop of mic audio on the dsp thread: echo, wake word and turn end
+ * detection, then preprocessing into the uplink ring. */
+static void chat_mic_process(chat_ws_t *thiz, int16_t *pcm)
+{
+    // every hop, the filter has to follow the room between turns too
+    if (thiz->duplex)
+        chat_echo_cancel(thiz, pcm);
+    if (!thiz->in_turn)
+    {
+        if (thiz->wake_word)
+            kws_feed(pcm, MIC_PRE_HOP);
+        else if (thiz->duplex && chat_duplex_onset(thiz, pcm, MIC_PRE_HOP))
+            chat_wake_detected();
+        return;
+    }
+    if (thiz->turn_by_wake && chat_wake_turn_done(thiz, pcm, MIC_PRE_HOP))
+    {
+        chat_mic_close(thiz);
+        return;
+    }
+    if (thiz->mic_pre.flags)
+        mic_pre_process(&thiz->mic_pre, pcm);
+    spsc_ring_put(thiz->rb_mic, pcm, MIC_PRE_HOP * sizeof(int16_t));
+    thiz->mic_rx_count += MIC_PRE_HOP * sizeof(int16_t);
+
+    if (thiz->mic_rx_count >= CHAT_MIC_FRAME_LEN)
+    {
+        thiz->mic_rx_count = 0;
+        rt_event_send(thiz->event, CHAT_EVENT_MIC_RX);
+    }
+}
+
+static void chat_dsp_entry(void *p)
+{
+    chat_ws_t *thiz = &g_thiz;
+    const uint32_t hop = sizeof(thiz->mic_frame);
+    uint32_t start, cycles;
+
+    cycle_counter_init();
+    while (!thiz->is_exit)
+    {
+        rt_uint32_t evt = 0;
+        rt_event_recv(thiz->dsp_event, CHAT_DSP_RAW, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, RT_WAITING_FOREVER, &evt);
+        while (spsc_ring_data_len(thiz->rb_raw) >= hop)
+        {
+            // a file turn outruns the uplink, the chat thread wakes us once it sent
+            if (thiz->in_turn && thiz->mic_uri[0] && spsc_ring_space_len(thiz->rb_mic) < hop)
+                break;
+            spsc_ring_get(thiz->rb_raw, thiz->mic_frame, hop);
+            start = cycle_counter_get();
+            chat_mic_process(thiz, thiz->mic_frame);
+            cycles = cycle_counter_get() - start;   // preemption included, an upper bound
+            thiz->dsp_cycles += cycles;
+            thiz->dsp_hops++;
+            if (cycles > thiz->dsp_cycles_max)
+                thiz->dsp_cycles_max = cycles;
+        }
+        if (thiz->raw_end && spsc_ring_data_len(thiz->rb_raw) < hop
+                && (!thiz->mic_uri[0] || spsc_ring_space_len(thiz->rb_mic) >= CHAT_MIC_FRAME_LEN + hop))
+        {
+            // file exhausted or Key1 released, and every hop captured is in
+            thiz->raw_end = 0;
+            spsc_ring_reset(thiz->rb_raw);
+            chat_mic_close(thiz);
+        }
+    }
+}
+
 static int mic_callback(audio_server_callback_cmt_t cmd, void *callback_userdata, uint32_t reserved)
 {
     //this was called every 10ms
     chat_ws_t *thiz = &g_thiz;
 
-    if (cmd == as_callback_cmd_data_coming)
+    if (cmd == as_callback_cmd_play_to_end)
+    {
+        thiz->raw_end = 1;
+        rt_event_send(thiz->dsp_event, CHAT_DSP_RAW);
+    }
+    else if (cmd == as_callback_cmd_data_coming)
     {
         audio_server_coming_data_t *p = (audio_server_coming_data_t *)reserved;
-        rt_ringbuffer_put(thiz->rb_mic, p->data, p->data_len);
-        thiz->mic_rx_count += 320;
 
-        if (thiz->mic_rx_count >= CHAT_MIC_FRAME_LEN)
-        {
-            thiz->mic_rx_count = 0;
-            rt_event_send(thiz->event, CHAT_EVENT_MIC_RX);
-        }
+        capture_record(CAP_MIC, CAP_FLAG_CHAT, p->data, p->data_len);
+        if (thiz->mic_uri[0] && spsc_ring_space_len(thiz->rb_raw) < p->data_len)
+            return -RT_EFULL;   // a file waits for the dsp thread and the uplink, the codec can not
+        // only queued here: an overrun of the processing must not stall capture
+        spsc_ring_put(thiz->rb_raw, p->data, p->data_len);
+        rt_event_send(thiz->dsp_event, CHAT_DSP_RAW);
     }
     return 0;
 }
@@ -150,23 +437,39 @@ static void mic_on(chat_ws_t *thiz)
         pa.write_channnel_num = 1;
         pa.read_bits_per_sample = 16;
         pa.read_channnel_num = 1;
-        pa.write_samplerate = 16000;
-        pa.read_samplerate = 16000;
-        pa.write_cache_size = 30000;
-        thiz->mic = audio_open(AUDIO_TYPE_LOCAL_MUSIC, AUDIO_RX, &pa, mic_callback, NULL);
+        pa.write_samplerate = PIPE_RATE;
+        pa.read_samplerate = PIPE_RATE;
+        pa.write_cache_size = CHAT_MIC_RING_SIZE;
+        mic_pre_reset(&thiz->mic_pre);
+        thiz->mic = audio_io_open_source(thiz->mic_uri[0] ? thiz->mic_uri : NULL, &pa, mic_callback, NULL);
     }
 }
 static void mic_off(chat_ws_t *thiz)
 {
     if (thiz->mic)
     {
-        audio_close(thiz->mic);
+        audio_io_close(thiz->mic);
         thiz->mic = NULL;
     }
 }
 
+static int speaker_callback(audio_server_callback_cmt_t cmd, void *callback_userdata, uint32_t reserved)
+{
+    chat_ws_t *thiz = (chat_ws_t *)callback_userdata;
+
+    if (capture_active())
+    {
+        uint8_t c = (uint8_t)cmd;
+        capture_record(CAP_AUDIO_EVENT, CAP_FLAG_CHAT, &c, 1);
+    }
+    if (cmd == as_callback_cmd_cache_empty && thiz->state == CT_RESPONDING)
+        ui_note_audio_underrun();
+    return 0;
+}
+
 static void speaker_on(chat_ws_t *thiz)
 {
+    rt_mutex_take(thiz->spk_lock, RT_WAITING_FOREVER);
     if (!thiz->speaker)
     {
         audio_parameter_t pa = {0};
@@ -174,24 +477,278 @@ static void speaker_on(chat_ws_t *thiz)
         pa.write_channnel_num = 1;
         pa.read_bits_per_sample = 16;
         pa.read_channnel_num = 1;
-        pa.write_samplerate = 16000;
-        pa.read_samplerate = 16000;
-        pa.write_cache_size = 30000;
-        thiz->speaker = audio_open(AUDIO_TYPE_LOCAL_MUSIC, AUDIO_TX, &pa, NULL, NULL);
+        pa.write_samplerate = PIPE_RATE;
+        pa.read_samplerate = PIPE_RATE;
+        pa.write_cache_size = CHAT_SPEAKER_CACHE;
+        if (!thiz->spk_uri[0])
+            thiz->speaker = audio_io_open_sink(CHAT_SPEAKER, &pa, speaker_callback, thiz);
+        else
+        {
+            if (!thiz->spk_file)
+                thiz->spk_file = audio_io_open_sink(thiz->spk_uri, &pa, speaker_callback, thiz);
+            thiz->speaker = thiz->spk_file;
+        }
+        // a stall leaves the answer behind for good unless it catches up
+        if (thiz->speaker && thiz->catchup_ms)
+            audio_io_set_catchup(thiz->speaker, thiz->linkq.jitter_ms + thiz->catchup_ms);
+        thiz->spk_written = 0;
+        thiz->spk_start = rt_tick_get();
+        thiz->spk_started = 0;
+        memset(&thiz->g711_up, 0, sizeof(thiz->g711_up));
+        if (thiz->rb_jitter)
+            spsc_ring_reset(thiz->rb_jitter);
     }
+    rt_mutex_release(thiz->spk_lock);
 }
 static void speaker_off(chat_ws_t *thiz)
 {
+    rt_mutex_take(thiz->spk_lock, RT_WAITING_FOREVER);
     if (thiz->speaker)
     {
-        audio_close(thiz->speaker);
+        prompt_fade_out();
+        if (thiz->speaker != thiz->spk_file)
+            audio_io_close(thiz->speaker);
         thiz->speaker = NULL;
     }
+    rt_mutex_release(thiz->spk_lock);
 }
 static const char buffer_commit[] = "{\"type\": \"input_audio_buffer.commit\"}";
 static const char response_create[] = "{\"type\": \"response.create\", \"response\": {\"modalities\": [\"text\", \"audio\"]}}";
 static const char response_cancel[] = "{\"type\": \"response.cancel\",}";
 
+/* Moves the turn to next if it is in one of the from states. The chat thread
+ * and the downlink worker both drive the turn, so the check is atomic. */
+static int chat_state_move(chat_ws_t *thiz, uint32_t from, chat_state next)
+{
+    rt_base_t mask = rt_hw_interrupt_disable();
+    chat_state prev = thiz->state;
+    int ok = (from & CT_BIT(prev)) != 0;
+
+    if (ok)
+        thiz->state = next;
+    rt_hw_interrupt_enable(mask);
+    if (ok && prev != next)
+        TRACE(TRACE_CHAT, TRACE_INFO, "turn state %d -> %d", prev, next);
+    return ok;
+}
+
+static void chat_turn_timeout(void *p)
+{
+    chat_ws_t *thiz = (chat_ws_t *)p;
+
+    rt_event_send(thiz->event, CHAT_EVENT_TIMEOUT);
+}
+
+static void chat_turn_arm(chat_ws_t *thiz, uint32_t ms)
+{
+    rt_tick_t ticks = rt_tick_from_millisecond(ms);
+
+    rt_timer_stop(thiz->turn_timer);
+    rt_timer_control(thiz->turn_timer, RT_TIMER_CTRL_SET_TIME, &ticks);
+    rt_timer_start(thiz->turn_timer);
+}
+
+/* Estimated audio_server cache fill, from bytes written and time played. */
+static uint32_t chat_speaker_queued(chat_ws_t *thiz)
+{
+    uint32_t played;
+
+    if (!thiz->speaker || !audio_io_realtime(thiz->speaker))
+        return 0;
+    played = PIPE_MS_BYTES((rt_tick_get() - thiz->spk_start) * 1000 / RT_TICK_PER_SECOND);
+    return thiz->spk_written > played ? thiz->spk_written - played : 0;
+}
+
+static void chat_capture_levels(chat_ws_t *thiz)
+{
+    uint32_t levels[3];
+
+    if (!capture_active())
+        return;
+    levels[0] = spsc_ring_data_len(thiz->rb_mic);
+    levels[1] = 0;
+    levels[2] = chat_speaker_queued(thiz);
+    capture_record(CAP_LEVELS, CAP_FLAG_CHAT, levels, sizeof(levels));
+}
+
+static uint32_t chat_now_ms(void)
+{
+    return rt_tick_get() * 1000 / RT_TICK_PER_SECOND;
+}
+
+/* First answer audio: the prompt ends and what the jitter ring held plays. */
+static void chat_speaker_start(chat_ws_t *thiz)
+{
+    const uint8_t *pcm;
+    uint32_t len;
+
+    thiz->spk_started = 1;
+    thiz->spk_written = prompt_fade_out();
+    boot_mark("first_audio");
+    while (thiz->rb_jitter && (pcm = spsc_ring_read_acquire(thiz->rb_jitter, thiz->rb_jitter->size, &len)) != NULL)
+    {
+        audio_io_write(thiz->speaker, (uint8_t *)pcm, len);
+        thiz->spk_written += len;
+        spsc_ring_read_release(thiz->rb_jitter, len);
+    }
+}
+
+/* Answer pcm to the speaker, held back until the link profile's jitter
+ * target is buffered. Called with spk_lock held. */
+static void chat_speaker_write(chat_ws_t *thiz, uint8_t *pcm, uint32_t len)
+{
+    if (!thiz->spk_started)
+    {
+        if (thiz->jitter_bytes && spsc_ring_put(thiz->rb_jitter, pcm, len))
+        {
+            if (spsc_ring_data_len(thiz->rb_jitter) < thiz->jitter_bytes)
+                return;
+            chat_speaker_start(thiz);
+            return;
+        }
+        chat_speaker_start(thiz);
+    }
+    audio_io_write(thiz->speaker, pcm, len);
+    thiz->spk_written += len;
+}
+
+/* Answer audio as it arrives in the session's output format. */
+static void chat_speaker_feed(chat_ws_t *thiz, uint8_t *data, uint32_t len)
+{
+    int16_t pcm[CHAT_ULAW_CHUNK * 2];
+    uint32_t n;
+
+    if (!thiz->ulaw_out)
+    {
+        chat_speaker_write(thiz, data, len);
+        return;
+    }
+    while (len)
+    {
+        n = len < CHAT_ULAW_CHUNK ? len : CHAT_ULAW_CHUNK;
+        g711_decode_16k(&thiz->g711_up, data, n, pcm);
+        chat_speaker_write(thiz, (uint8_t *)pcm, n * 2 * sizeof(int16_t));
+        data += n;
+        len -= n;
+    }
+}
+
+/* Sends queued mic audio as far as the uplink controller allows. */
+static void chat_uplink_pump(chat_ws_t *thiz, int flush)
+{
+    err_t err;
+
+    linkq_uplink(&thiz->linkq, spsc_ring_data_len(thiz->rb_mic) / CHAT_MIC_FRAME_LEN,
+                 thiz->rb_mic->p.dropped, chat_now_ms());
+    while (1)
+    {
+        if (!thiz->up_pending)
+        {
+            size_t olen = 0;
+            size_t len, bytes;
+            uint32_t n = uplink_ctrl_next(&thiz->uplink, spsc_ring_data_len(thiz->rb_mic) / CHAT_MIC_FRAME_LEN,
+                                          rts_sndbuf(&thiz->rts), flush);
+            if (!n)
+                return;     // frames wait in the mic ring
+            spsc_ring_get(thiz->rb_mic, thiz->encode_in, n * CHAT_MIC_FRAME_LEN);
+            if (thiz->mic_uri[0])
+                rt_event_send(thiz->dsp_event, CHAT_DSP_RAW);   // a file turn waits for this room
+            capture_record(CAP_TX_AUDIO, CAP_FLAG_CHAT, thiz->encode_in, n * CHAT_MIC_FRAME_LEN);
+            chat_capture_levels(thiz);
+            bytes = n * CHAT_MIC_FRAME_LEN;
+            if (thiz->ulaw_in)
+                bytes = g711_encode_16k((int16_t *)thiz->encode_in, bytes / sizeof(int16_t), thiz->encode_in);
+            len = strlen(buffer_append);
+            memcpy(thiz->encode_out, buffer_append, len);
+            int ret = b64_encode(thiz->encode_out + len, CHAT_FRAME_ENCODE_LEN - len, &olen,
+                                 thiz->encode_in, bytes);
+            RT_ASSERT(!ret);
+            len += olen;
+            strcpy(thiz->encode_out + len, "\"}");
+            len += 2;
+            RT_ASSERT(WSMSG_MAXSIZE >= len);
+            thiz->up_pending = n;
+            thiz->up_len = len;
+        }
+        else if (rts_sndbuf(&thiz->rts) < thiz->up_len)
+        {
+            return;
+        }
+        LOCK_TCPIP_CORE();
+        err = wsock_write(&thiz->rts.clnt, thiz->encode_out, thiz->up_len, OPCODE_TEXT);
+        UNLOCK_TCPIP_CORE();
+        uplink_ctrl_result(&thiz->uplink, thiz->up_pending, err);
+        TRACE(TRACE_UPLINK, err == ERR_OK ? TRACE_DEBUG : TRACE_WARN, "send audio ret=%d frames=%d",
+              err, thiz->up_pending);
+        if (err == ERR_MEM)
+            return;         // keep the message, retried on the next mic frame
+        thiz->up_pending = 0;
+        if (err != ERR_OK)
+            return;         // socket going down, the supervisor takes over
+        thiz->rts.tx_msgs++;
+        thiz->rts.tx_bytes += thiz->up_len;
+        link_policy_notify(LP_SRC_UPLINK);
+    }
+}
+
+/* End of a turn: get the tail audio out, then commit and ask for the answer. */
+static void chat_turn_commit(chat_ws_t *thiz)
+{
+    static const char *const commit[] = {buffer_commit, response_create};
+    rt_tick_t deadline = rt_tick_get() + rt_tick_from_millisecond(CHAT_FLUSH_TIMEOUT);
+    err_t err;
+
+    if (chat_state_move(thiz, CT_IDLE, CT_BUFFER_APPEND))
+        thiz->turn_start_frames = thiz->uplink.sent_frames;    // turn shorter than a frame event
+    if (!reconnect_is_up(RECONN_LAYER_SESSION) || thiz->state != CT_BUFFER_APPEND)
+    {
+        spsc_ring_reset(thiz->rb_mic);
+        thiz->up_pending = 0;
+        return;
+    }
+    // waits only on the send buffer, the audio was already captured
+    while (thiz->up_pending || spsc_ring_data_len(thiz->rb_mic) >= CHAT_MIC_FRAME_LEN)
+    {
+        chat_uplink_pump(thiz, 1);
+        if (!thiz->up_pending && spsc_ring_data_len(thiz->rb_mic) < CHAT_MIC_FRAME_LEN)
+            break;
+        if ((rt_int32_t)(rt_tick_get() - deadline) >= 0 || !thiz->rts.is_connected)
+        {
+            TRACE(TRACE_UPLINK, TRACE_WARN, "tail flush timed out, %d bytes dropped",
+                  spsc_ring_data_len(thiz->rb_mic), 0);
+            break;
+        }
+        // woken by the tcp sent callback as soon as the peer acks
+        rts_wait_sndbuf(&thiz->rts, (rt_int32_t)(deadline - rt_tick_get()));
+    }
+    spsc_ring_reset(thiz->rb_mic);
+    thiz->up_pending = 0;
+
+    if (thiz->uplink.sent_frames == thiz->turn_start_frames)
+    {
+        // nothing was appended, a commit would only earn an error
+        chat_state_move(thiz, CT_BIT(CT_BUFFER_APPEND), CT_RESPONSE_DONE);
+        ui_set_state(UI_STATE_IDLE);
+        return;
+    }
+    if (!chat_state_move(thiz, CT_BIT(CT_BUFFER_APPEND), CT_RESPONSE_CREATE))
+        return;
+    err = rts_send_texts(&thiz->rts, commit, 2);
+    // cover the wait for the first answer with a local prompt
+    speaker_on(thiz);
+    prompt_play(err == ERR_OK ? PROMPT_THINKING : PROMPT_ERROR, thiz->speaker, thiz->sample_rate);
+    if (err != ERR_OK)
+    {
+        chat_state_move(thiz, CT_IN_RESPONSE, CT_RESPONSE_DONE);
+        ui_set_state(UI_STATE_IDLE);
+        return;
+    }
+    chat_turn_arm(thiz, CHAT_RESPONSE_TIMEOUT);
+    boot_mark("first_turn");
+    link_policy_notify(LP_SRC_RESPONSE);
+    ui_set_state(UI_STATE_THINKING);
+}
+
 static void thread_entry(void *p)
 {
     int err;
@@ -200,86 +757,108 @@ static void thread_entry(void *p)
     {
         rt_uint32_t evt = 0;
         rt_event_recv(thiz->event, CHAT_EVENT_ALL, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, RT_WAITING_FOREVER, &evt);
+        if (evt & CHAT_EVENT_TIMEOUT)
+        {
+            if (chat_state_move(thiz, CT_IN_RESPONSE, CT_RESPONSE_DONE))
+            {
+                TRACE(TRACE_CHAT, TRACE_ERR, "response timed out", 0, 0);
+                rts_send_text(&thiz->rts, response_cancel);
+                speaker_off(thiz);
+                ui_set_state(UI_STATE_IDLE);
+            }
+        }
+        if (evt & CHAT_EVENT_SESSION)
+            chat_session_configure(thiz);
+        if (evt & CHAT_EVENT_PROBE)
+        {
+            if (thiz->probe_state != CHAT_PROBE_OFF)
+                chat_link_probe_step(thiz);
+            else
+                chat_link_recheck(thiz);
+        }
         if (evt & CHAT_EVENT_MIC_CLOSE)
         {
             evt &= ~CHAT_EVENT_MIC_RX;
-            while (rt_ringbuffer_get(thiz->rb_mic, thiz->encode_in, CHAT_MIC_FRAME_LEN) > 0)
+            chat_turn_commit(thiz);
+            if (thiz->mic_uri[0] && !thiz->in_turn)
             {
-                ;
+                // `chat -f` file used up: back to the codec mic, and a
+                // reconnect must not replay the file. Closed here, the
+                // feeder thread waits on its own callback.
+                mic_off(thiz);
+                thiz->mic_uri[0] = '\0';
+                if (thiz->wake_word || thiz->duplex)
+                    mic_on(thiz);
+            }
+            else if (!thiz->in_turn && !thiz->wake_word && !thiz->duplex)
+            {
+                mic_off(thiz);      // Key1 turn over, nothing listens between turns
             }
-            LOCK_TCPIP_CORE();
-            err_t err = wsock_write(&thiz->clnt, buffer_commit, strlen(buffer_commit), OPCODE_TEXT);
-            UNLOCK_TCPIP_CORE();
-            rt_thread_mdelay(10);
-            LOCK_TCPIP_CORE();
-            err = wsock_write(&thiz->clnt, response_create, strlen(response_create), OPCODE_TEXT);
-            UNLOCK_TCPIP_CORE();
-            thiz->state = CT_RESPONSE_CREATE;
         }
         if ((evt & CHAT_EVENT_MIC_RX))
         {
-            if (thiz->state == CT_RESPONSE_CREATE)
+            if (chat_state_move(thiz, CT_IN_RESPONSE, CT_BUFFER_APPEND))
             {
-                LOCK_TCPIP_CORE();
-                err_t err = wsock_write(&thiz->clnt, response_cancel, strlen(response_cancel), OPCODE_TEXT);
-                UNLOCK_TCPIP_CORE();
-                thiz->state = CT_BUFFER_APPEND;
+                // barge in, late audio of the old answer is dropped by state
+                rt_timer_stop(thiz->turn_timer);
+                rts_send_text(&thiz->rts, response_cancel);
+                prompt_fade_out();
+                thiz->turn_start_frames = thiz->uplink.sent_frames;
             }
-
-            if (rt_ringbuffer_data_len(thiz->rb_mic) >= CHAT_MIC_FRAME_LEN)
+            else if (chat_state_move(thiz, CT_IDLE, CT_BUFFER_APPEND))
             {
-                size_t olen = 0;
-                size_t len;
-                len = rt_ringbuffer_get(thiz->rb_mic, thiz->encode_in, CHAT_MIC_FRAME_LEN);
-                RT_ASSERT(len == CHAT_MIC_FRAME_LEN);
-                len = strlen(buffer_append);
-                memcpy(thiz->encode_out, buffer_append, len);
-                int ret = mbedtls_base64_encode(thiz->encode_out + len, CHAT_FRAME_ENCODE_LEN - len, &olen, thiz->encode_in, CHAT_MIC_FRAME_LEN);
-                RT_ASSERT(!ret);
-                len += olen;
-                strcpy(thiz->encode_out + len, "\"}");
-                len += 2;
-                RT_ASSERT(WSMSG_MAXSIZE >= len);
-                LOCK_TCPIP_CORE();
-                err_t err = wsock_write(&thiz->clnt, thiz->encode_out , len, OPCODE_TEXT);
-                UNLOCK_TCPIP_CORE();
-                rt_kprintf("send audio ret = %d len=%d\n", err, len);
+                thiz->turn_start_frames = thiz->uplink.sent_frames;
+            }
 
+            if (!reconnect_is_up(RECONN_LAYER_SESSION))
+            {
+                // link is recovering, nothing to append the audio to
+                spsc_ring_reset(thiz->rb_mic);
+                thiz->up_pending = 0;
+            }
+            else
+            {
+                // a turn cuts a probe short before its audio is cleared
+                if (thiz->probe_state != CHAT_PROBE_OFF)
+                    chat_link_probe_finish(thiz);
+                chat_uplink_pump(thiz, 0);
             }
         }
     }
 }
-static err_t my_wsapp_fn(int code, char *buf, size_t len)
+/* Socket state into the reconnect supervisor's websocket layer. */
+static void chat_link(void *ctx, rts_link_t link)
 {
-    chat_ws_t *thiz = &g_thiz;
-
-    if (code == WS_CONNECT)
-    {
-        int status = (uint16_t)(uint32_t)buf;
-        if (status == 101)  // wss setup success
-        {
-            thiz->is_connected = 1;
-        }
-    }
-    else if (code == WS_DISCONNECT)
-    {
-        rt_kprintf("WebSocket closed\n");
-        thiz->is_connected = 0;
-        rt_sem_release(thiz->sem);
-    }
-    else if (code == WS_TEXT)
-    {
-        rt_kprintf("Got Text:%d\n", len);
-        RT_ASSERT(len<(WSMSG_MAXSIZE-1));
-        memcpy(thiz->text, buf, len);
-        thiz->text[len]='\0';
-        parse_response(buf, len);
-    }
+    if (link == RTS_LINK_UP)
+        reconnect_notify_up(RECONN_LAYER_WS);
+    else if (link == RTS_LINK_DOWN)
+        reconnect_notify_down(RECONN_LAYER_WS);
     else
-    {
-        rt_kprintf("Got Code=%d\n", code);
-    }
-    return 0;
+        reconnect_notify_failed(RECONN_LAYER_WS);
+}
+
+static void chat_turn_begin(chat_ws_t *thiz, uint8_t by_wake)
+{
+    if (thiz->in_turn)
+        return;
+    thiz->turn_by_wake = by_wake;
+    thiz->heard_speech = 0;
+    thiz->onset_frames = 0;
+    thiz->silence_frames = 0;
+    thiz->turn_frames = 0;
+    thiz->in_turn = 1;
+    mic_on(thiz);
+    ui_set_state(UI_STATE_LISTENING);
+}
+
+/* Key1 released: the dsp thread closes the turn once it has worked
+ * through the audio already captured, up to 64 ms of it. */
+static void chat_turn_end(chat_ws_t *thiz)
+{
+    if (!thiz->in_turn)
+        return;
+    thiz->raw_end = 1;
+    rt_event_send(thiz->dsp_event, CHAT_DSP_RAW);
 }
 
 static void xz_button_event_handler(int32_t pin, button_action_t action)
@@ -288,15 +867,22 @@ static void xz_button_event_handler(int32_t pin, button_action_t action)
     chat_ws_t *thiz = &g_thiz;
     if (action == BUTTON_PRESSED)
     {
-        mic_on(thiz);
+        chat_turn_begin(thiz, 0);
     }
     else if (action == BUTTON_RELEASED)
     {
-        mic_off(thiz);
-        rt_event_send(thiz->event, CHAT_EVENT_MIC_CLOSE);
+        chat_turn_end(thiz);
     }
 }
 
+static void chat_wake_detected(void)
+{
+    chat_ws_t *thiz = &g_thiz;
+
+    if (thiz->thread && reconnect_is_up(RECONN_LAYER_SESSION))
+        chat_turn_begin(thiz, 1);
+}
+
 
 static void xz_button_init(void)
 {
@@ -320,13 +906,19 @@ static void xz_button_init(void)
 static void xz_ws_audio_init()
 {
     chat_ws_t *thiz = &g_thiz;
+    if (thiz->thread)
+        return;     // session resumed, keep the running pipeline
     rt_kprintf("chat_audio_init\n");
-    thiz->sample_rate = 16000;
-    thiz->frame_duration = 100;
+    thiz->sample_rate = PIPE_RATE;
+    thiz->frame_duration = PIPE_FRAME_MS;
     thiz->event = rt_event_create("doubchat", RT_IPC_FLAG_FIFO);
     RT_ASSERT(thiz->event);
-    thiz->rb_mic = rt_ringbuffer_create(CHAT_MIC_FRAME_LEN * 2);
+    thiz->rb_mic = spsc_ring_create(CHAT_MIC_RING_SIZE);
+    uplink_ctrl_init(&thiz->uplink, CHAT_MIC_FRAME_LEN, TCP_SND_BUF);
     RT_ASSERT(thiz->rb_mic);
+    thiz->dsp_event = rt_event_create("chat_dsp", RT_IPC_FLAG_FIFO);
+    thiz->rb_raw = spsc_ring_create(CHAT_MIC_RAW_RING_SIZE);
+    RT_ASSERT(thiz->dsp_event && thiz->rb_raw);
     thiz->is_exit = 0;
     thiz->thread = rt_thread_create("doubchat",
                              thread_entry,
@@ -336,24 +928,25 @@ static void xz_ws_audio_init()
                              RT_THREAD_TICK_DEFAULT);
     RT_ASSERT(thiz->thread);
     rt_thread_startup(thiz->thread);
-
-    audio_server_set_private_volume(AUDIO_TYPE_LOCAL_MUSIC, 15);
+    // above the chat thread, whose socket writes must not delay the mic
+    thiz->dsp_thread = rt_thread_create("chat_dsp",
+                             chat_dsp_entry,
+                             NULL,
+                             2048,
+                             RT_THREAD_PRIORITY_MIDDLE + RT_THREAD_PRIORITY_HIGHER - 1,
+                             RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->dsp_thread);
+    rt_thread_startup(thiz->dsp_thread);
 
     xz_button_init();
 }
 
-static char *my_json_string(cJSON *json, char *key)
-{
-    return cJSON_GetObjectItem(json, key)->valuestring;
-}
-
-static void parse_response(const u8_t *data, u16_t len)
+static void parse_response(void *ctx, const char *data, size_t len)
 {
     cJSON *item = NULL;
     cJSON *root = NULL;
-    chat_ws_t *thiz = &g_thiz;
-    rt_kputs(data);
-    rt_kputs("--parse_response--\r\n");
+    chat_ws_t *thiz = (chat_ws_t *)ctx;
+    TRACE(TRACE_DOWNLINK, TRACE_DEBUG, "rx %d bytes", len, 0);
     root = cJSON_Parse(data);
     if (!root)
     {
@@ -361,125 +954,605 @@ static void parse_response(const u8_t *data, u16_t len)
         return;
     }
 
-    char *type = my_json_string(root, "type");
+    const char *type = rts_json_string(root, "type");
 
+    if (strcmp(type, "response.audio.delta") != 0)
+        capture_record(CAP_WS_RX, CAP_FLAG_CHAT, data, len);
     if (strcmp(type, "session.created") == 0)
     {
         rt_kprintf("session.created\n");
-        thiz->state = CT_SESSION_CREATED;
-        rt_sem_release(thiz->sem);
+        if (chat_state_move(thiz, CT_BIT(CT_CONNECTING), CT_SESSION_CREATED))
+            rt_event_send(thiz->event, CHAT_EVENT_SESSION);
+        else
+            TRACE(TRACE_CHAT, TRACE_WARN, "session.created in state %d ignored", thiz->state, 0);
     }
     else if (strcmp(type, "session.updated") == 0)
     {
         rt_kprintf("session.updated\n");
-        thiz->state = CT_SESSION_UPDATED;
-        rt_sem_release(thiz->sem);
+        if (!chat_state_move(thiz, CT_BIT(CT_SESSION_CREATED), CT_SESSION_UPDATED))
+        {
+            TRACE(TRACE_CHAT, TRACE_WARN, "session.updated in state %d ignored", thiz->state, 0);
+            goto Exit;
+        }
+        ui_set_state(UI_STATE_IDLE);
+        rt_sem_release(thiz->rts.sem);
         xz_ws_audio_init();
+        reconnect_notify_up(RECONN_LAYER_SESSION);
+        if (thiz->is_resumed)
+            rt_kprintf("\n\nchat session resumed\n\n");
+        else
+            rt_kprintf("\n\nPress Key1 and Talk, release Key1 and Listen\n\n");
+        thiz->is_resumed = 1;
+        if (thiz->mic_uri[0])
+            chat_turn_begin(thiz, 0);   // `chat -f`, the file is the turn
     }
     else if (strcmp(type, "response.created") == 0)
     {
+        if (thiz->state == CT_RESPONSE_CREATE)
+            chat_turn_arm(thiz, CHAT_RESPONSE_GAP);
     }
     else if (strcmp(type, "response.audio.delta") == 0)
     {
-        rt_kprintf("response.audio.delta\n");
-        char *delta = my_json_string(root, "delta");
+        const char *delta = rts_json_string(root, "delta");
         static uint8_t audio_data[MAX_AUDIO_DATA_LEN];
-        int size=0;
-        if (ERR_OK==mbedtls_base64_decode(audio_data,MAX_AUDIO_DATA_LEN,&size,delta,strlen(delta)))
+        size_t size=0;
+
+        // audio of a cancelled or timed out answer must not play
+        if (!chat_state_move(thiz, CT_IN_RESPONSE, CT_RESPONDING))
         {
-            rt_kprintf("Audio data:%d\r\n",size);
-            audio_write(thiz->speaker, audio_data, size);
+            TRACE(TRACE_CHAT, TRACE_DEBUG, "stale audio dropped in state %d", thiz->state, 0);
+            goto Exit;
+        }
+        chat_turn_arm(thiz, CHAT_RESPONSE_GAP);
+        link_policy_notify(LP_SRC_RESPONSE);
+        ui_set_state(UI_STATE_SPEAKING);
+        if (0==b64_decode(audio_data,MAX_AUDIO_DATA_LEN,&size,delta,strlen(delta)))
+        {
+            TRACE(TRACE_AUDIO, TRACE_DEBUG, "audio delta %d bytes, %d written", size, thiz->spk_written);
+            capture_record(CAP_RX_AUDIO, CAP_FLAG_CHAT, audio_data, size);
+            rt_mutex_take(thiz->spk_lock, RT_WAITING_FOREVER);
+            if (thiz->state == CT_RESPONDING)
+            {
+                speaker_on(thiz);
+                chat_speaker_feed(thiz, audio_data, size);
+            }
+            rt_mutex_release(thiz->spk_lock);
+            chat_capture_levels(thiz);
         }
     }
     else if (strcmp(type, "response.audio_transcript.delta") == 0)
     {
-        char *delta = my_json_string(root, "delta");
-        rt_kputs("\r\n");
-        rt_kputs(delta);
-        rt_kputs("\r\n");
+        const char *delta = rts_json_string(root, "delta");
+        if (!(CT_IN_RESPONSE & CT_BIT(thiz->state)))
+            goto Exit;
+        TRACE(TRACE_DOWNLINK, TRACE_INFO, "transcript delta %d bytes", strlen(delta), 0);
+        ui_transcript_delta(delta);
     }
     else if (strcmp(type, "response.done") == 0)
     {
-        thiz->state =CT_RESPONSE_DONE;
-        speaker_off(thiz);
+        if (chat_state_move(thiz, CT_IN_RESPONSE, CT_RESPONSE_DONE))
+        {
+            rt_timer_stop(thiz->turn_timer);
+            rt_mutex_take(thiz->spk_lock, RT_WAITING_FOREVER);
+            if (thiz->speaker && !thiz->spk_started)
+                chat_speaker_start(thiz);   // short answer, below the jitter target
+            rt_mutex_release(thiz->spk_lock);
+            speaker_off(thiz);
+            ui_set_state(UI_STATE_IDLE);
+        }
+        else
+        {
+            // the answer we cancelled, the turn has moved on
+            TRACE(TRACE_CHAT, TRACE_DEBUG, "response.done in state %d", thiz->state, 0);
+        }
+    }
+    else if (strcmp(type, "error") == 0)
+    {
+        rt_kprintf("server error: %s\n", rts_json_string(cJSON_GetObjectItem(root, "error"), "message"));
+        if (chat_state_move(thiz, CT_IN_RESPONSE, CT_RESPONSE_DONE))
+        {
+            rt_timer_stop(thiz->turn_timer);
+            speaker_off(thiz);
+            ui_set_state(UI_STATE_IDLE);
+        }
     }
     else
     {
         rt_kprintf("skip type:%s\n", type);
     }
+Exit:
     cJSON_Delete(root);
 }
 
-static const char *session_update =
+static const char *session_update_fmt =
 "{"
     "\"type\": \"session.update\","
     "\"session\": {"
         "\"modalities\": [\"text\", \"audio\"],"
         "\"voice\":\"zh_female_tianmeixiaoyuan_moon_bigtts\","
-        "\"input_audio_format\": \"pcm16\","
-        "\"output_audio_format\": \"pcm16\""
+        "\"input_audio_format\": \"%s\","
+        "\"output_audio_format\": \"%s\""
     "}"
 "}" ;
+static char session_update[320];
 
-static void chat(int argc, char **argv)
+/* Takes the link profile the last probe chose: wire formats, uplink
+ * aggregation floor and answer jitter buffer. */
+static void chat_link_apply(chat_ws_t *thiz)
+{
+    const linkq_profile_t *p = linkq_profile(thiz->linkq.cls);
+
+    rt_snprintf(session_update, sizeof(session_update), session_update_fmt, p->in_format, p->out_format);
+    thiz->ulaw_in = strcmp(p->in_format, "g711_ulaw") == 0;
+    thiz->ulaw_out = strcmp(p->out_format, "g711_ulaw") == 0;
+    uplink_ctrl_config(&thiz->uplink, p->frame_bytes, p->agg_min);
+    thiz->jitter_bytes = PIPE_MS_BYTES(thiz->linkq.jitter_ms);
+    if (thiz->jitter_bytes > CHAT_JITTER_RING_SIZE - MAX_AUDIO_DATA_LEN)
+        thiz->jitter_bytes = CHAT_JITTER_RING_SIZE - MAX_AUDIO_DATA_LEN;    // the delta crossing it fits
+    if (thiz->jitter_bytes && !thiz->rb_jitter)
+    {
+        thiz->rb_jitter = spsc_ring_create(CHAT_JITTER_RING_SIZE);
+        if (!thiz->rb_jitter)
+            thiz->jitter_bytes = 0;
+    }
+}
+
+static void chat_probe_timer_arm(chat_ws_t *thiz, uint32_t ms)
+{
+    rt_tick_t tick = rt_tick_from_millisecond(ms);
+
+    rt_timer_control(thiz->probe_timer, RT_TIMER_CTRL_SET_TIME, &tick);
+    rt_timer_start(thiz->probe_timer);
+}
+
+static void chat_link_probe_stop(chat_ws_t *thiz)
+{
+    thiz->probe_state = CHAT_PROBE_OFF;
+    rts_notify_sent(&thiz->rts, RT_NULL, 0);
+    rt_timer_stop(thiz->probe_timer);
+}
+
+/* Times the acks of a few silent appends on the session socket, then drops
+ * them from the server's input buffer. The chat thread goes on between
+ * the steps; session: a new session, session.update follows the probe. */
+static void chat_link_probe_start(chat_ws_t *thiz, int session)
+{
+    // start from an idle send buffer so the acks time only the probe
+    thiz->probe_state = CHAT_PROBE_DRAIN;
+    thiz->probe_session = session;
+    thiz->probe_ms = chat_now_ms();
+    thiz->probe_next_ms = thiz->probe_ms + CHAT_PROBE_IDLE_MS;
+    thiz->probe_size = rts_sndbuf(&thiz->rts);
+    rts_notify_sent(&thiz->rts, thiz->event, CHAT_EVENT_PROBE);
+    chat_probe_timer_arm(thiz, CHAT_PROBE_IDLE_MS);
+}
+
+static void chat_link_probe_send(chat_ws_t *thiz)
+{
+    uint32_t room, total = 0;
+    size_t olen = 0, len;
+    err_t err = ERR_OK;
+    int i;
+
+    // silence in the format the server takes now: its default until the
+    // session.update this probe leads to
+    memset(thiz->encode_in, thiz->ulaw_in && !thiz->probe_session ? 0xff : 0, sizeof(thiz->encode_in));
+    len = strlen(buffer_append);
+    memcpy(thiz->encode_out, buffer_append, len);
+    b64_encode(thiz->encode_out + len, CHAT_FRAME_ENCODE_LEN - len, &olen,
+               thiz->encode_in, sizeof(thiz->encode_in));
+    len += olen;
+    strcpy(thiz->encode_out + len, "\"}");
+    len += 2;
+
+    LOCK_TCPIP_CORE();
+    for (i = 0; i < CHAT_PROBE_MSGS && err == ERR_OK && thiz->rts.clnt.pcb; i++)
+    {
+        err = wsock_write(&thiz->rts.clnt, thiz->encode_out, len, OPCODE_TEXT);
+        if (err == ERR_OK)
+            total += len;
+    }
+    room = thiz->rts.clnt.pcb ? altcp_sndbuf(thiz->rts.clnt.pcb) : 0;
+    UNLOCK_TCPIP_CORE();
+    thiz->rts.tx_msgs += i;
+    thiz->rts.tx_bytes += total;
+
+    thiz->probe_state = CHAT_PROBE_ACK;
+    thiz->probe_ms = chat_now_ms();
+    linkq_probe_start(&thiz->probe, total, thiz->probe_size, room, thiz->probe_ms);
+    if (total)
+        chat_probe_timer_arm(thiz, CHAT_PROBE_TIMEOUT);
+    else
+        chat_link_probe_finish(thiz);
+}
+
+/* On every ack and probe_timer expiry. */
+static void chat_link_probe_step(chat_ws_t *thiz)
+{
+    uint32_t now = chat_now_ms(), room;
+
+    if (!thiz->rts.is_connected || thiz->state == CT_CONNECTING)
+    {
+        chat_link_probe_stop(thiz);     // the session went, its successor probes anew
+        return;
+    }
+    room = rts_sndbuf(&thiz->rts);
+    if (thiz->probe_state == CHAT_PROBE_DRAIN)
+    {
+        if (now - thiz->probe_ms >= CHAT_PROBE_TIMEOUT)
+        {
+            chat_link_probe_send(thiz);
+        }
+        else if (room > thiz->probe_size)
+        {
+            thiz->probe_size = room;
+            thiz->probe_next_ms = now + CHAT_PROBE_IDLE_MS;
+            chat_probe_timer_arm(thiz, CHAT_PROBE_IDLE_MS);
+        }
+        else if ((int32_t)(thiz->probe_next_ms - now) <= 0)
+        {
+            chat_link_probe_send(thiz);
+        }
+        else
+        {
+            chat_probe_timer_arm(thiz, thiz->probe_next_ms - now);
+        }
+    }
+    else if (linkq_probe_poll(&thiz->probe, room, now) || now - thiz->probe_ms >= CHAT_PROBE_TIMEOUT)
+    {
+        chat_link_probe_finish(thiz);
+    }
+}
+
+/* All acked, timed out, or cut short by a turn: the result is what the
+ * probe saw so far. A new session gets its update, a recheck only sends
+ * one when the profile changed. */
+static void chat_link_probe_finish(chat_ws_t *thiz)
+{
+    static const char clear[] = "{\"type\": \"input_audio_buffer.clear\"}";
+    linkq_class_t cls = thiz->linkq.cls;
+    int measured = thiz->probe_state == CHAT_PROBE_ACK;
+
+    chat_link_probe_stop(thiz);
+    if (measured)
+    {
+        rts_send_text(&thiz->rts, clear);
+        linkq_probe_result(&thiz->linkq, &thiz->probe, chat_now_ms());
+        rt_kprintf("linkq: %d kbps rtt %d ms -> %s\n", thiz->linkq.kbps, thiz->linkq.rtt_ms,
+                   linkq_profile(thiz->linkq.cls)->name);
+    }
+    if (thiz->probe_session)
+    {
+        chat_link_apply(thiz);
+        rt_kprintf("send update:\r\n");
+        rt_kputs(session_update);
+        rt_kprintf("\r\n\r\n");
+        if (rts_send_text(&thiz->rts, session_update) != ERR_OK)
+            reconnect_notify_failed(RECONN_LAYER_SESSION);
+    }
+    else if (thiz->linkq.cls != cls)
+    {
+        chat_link_apply(thiz);
+        rts_send_text(&thiz->rts, session_update);
+    }
+}
+
+/* Probes again between turns after the uplink fell behind, and now and
+ * then on a degraded link to find its way back up. */
+static void chat_link_recheck(chat_ws_t *thiz)
+{
+    if (!linkq_reprobe_due(&thiz->linkq, chat_now_ms()) || thiz->in_turn || thiz->speaker
+            || !(CT_IDLE & CT_BIT(thiz->state)) || !reconnect_is_up(RECONN_LAYER_SESSION))
+        return;
+    chat_link_probe_start(thiz, 0);
+}
+
+static void chat_linkq_tick(void *param)
 {
+    chat_ws_t *thiz = (chat_ws_t *)param;
 
+    rt_event_send(thiz->event, CHAT_EVENT_PROBE);
+}
+
+/* WebSocket layer of the reconnect supervisor, also used for the first connect. */
+static rt_err_t chat_ws_connect(reconn_layer_t layer)
+{
     err_t err;
     chat_ws_t *thiz = &g_thiz;
-    memset(thiz, 0, sizeof(chat_ws_t));
 
-    if (thiz->sem == NULL)
-        thiz->sem = rt_sem_create("xz_ws", 0, RT_IPC_FLAG_FIFO);
+    if (CT_IN_RESPONSE & CT_BIT(thiz->state))
+    {
+        // the pending response was lost with the old session
+        rt_timer_stop(thiz->turn_timer);
+        speaker_off(thiz);
+    }
+
+    thiz->state = CT_CONNECTING;
+    thiz->session_armed = 0;
+    ui_set_state(UI_STATE_CONNECTING);
+    err = rts_connect(&thiz->rts, CHAT_HOST, CHAT_WSPATH, CHAT_TOKEN);
+    if (err)
+        return -RT_ERROR;
+    return RT_EOK;
+}
+
+/* Realtime session layer. Only arms the attempt, so the reconn thread is
+ * never held: the chat thread probes the link and sends session.update
+ * once session.created is in, and the attempt timeout covers a server
+ * that never sends it. */
+static rt_err_t chat_session_update(reconn_layer_t layer)
+{
+    chat_ws_t *thiz = &g_thiz;
+
+    if (thiz->session_armed)
+    {
+        // the last attempt saw no session.created, start over on a new socket
+        rt_kprintf("wait session create fail\n");
+        thiz->session_armed = 0;
+        reconnect_notify_down(RECONN_LAYER_WS);
+        return -RT_ETIMEOUT;
+    }
+    thiz->session_armed = 1;
+    rt_event_send(thiz->event, CHAT_EVENT_SESSION);
+    return RT_EOK;
+}
+
+/* Runs on the chat thread when the attempt is armed or session.created
+ * arrives, whichever is last: probes the link for the profile, the probe
+ * sends session.update when done. */
+static void chat_session_configure(chat_ws_t *thiz)
+{
+    if (!thiz->session_armed || thiz->state != CT_SESSION_CREATED || !thiz->rts.is_connected)
+        return;
+    thiz->session_armed = 0;
+    if (thiz->probe_state != CHAT_PROBE_OFF)
+        chat_link_probe_stop(thiz);     // left from the old socket
+    chat_link_probe_start(thiz, 1);
+}
 
-    wsock_init(&thiz->clnt, 1, 1, my_wsapp_fn);
+void chat_prepare(void)
+{
+    chat_ws_t *thiz = &g_thiz;
 
+    if (thiz->rts.downlink)
+        return;
+    memset(thiz, 0, sizeof(chat_ws_t));
+    thiz->spk_lock = rt_mutex_create("chat_spk", RT_IPC_FLAG_FIFO);
+    thiz->turn_timer = rt_timer_create("chat_turn", chat_turn_timeout, thiz, RT_TICK_PER_SECOND,
+                                       RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+    RT_ASSERT(thiz->spk_lock && thiz->turn_timer);
     thiz->state = CT_CONNECTING;
+    thiz->catchup_ms = CHAT_CATCHUP_MS;
+    rts_init(&thiz->rts, "chat_dl", CAP_FLAG_CHAT, parse_response, chat_link, thiz);
+    linkq_init(&thiz->linkq);
+    mic_pre_init(&thiz->mic_pre, MIC_PRE_ALL);
+    xz_ws_audio_init();
+    thiz->linkq_timer = rt_timer_create("chat_lq", chat_linkq_tick, thiz, RT_TICK_PER_SECOND,
+                                        RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_SOFT_TIMER);
+    thiz->probe_timer = rt_timer_create("chat_pb", chat_linkq_tick, thiz, RT_TICK_PER_SECOND,
+                                        RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+    RT_ASSERT(thiz->linkq_timer && thiz->probe_timer);
+    rt_timer_start(thiz->linkq_timer);
+}
 
-    err = wsock_connect(&thiz->clnt, MAX_WSOCK_HDR_LEN, CHAT_HOST, CHAT_WSPATH,
-                        LWIP_IANA_PORT_HTTPS, CHAT_TOKEN, NULL,
-                        "Content-Type: application/json\r\n");
-    rt_kprintf("Web socket connection %d\r\n", err);
-    if (err)
+/* chat [-f in.wav] [-o out.wav|null]: a file mic turn runs as fast as the
+ * link allows, the answers go to the file, or nowhere with -f alone. The
+ * file is completed by the next chat command. */
+static void chat(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+    const char *mic = NULL, *spk = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2)
     {
-        goto Exit;;
+        if (strcmp(argv[i], "-f") == 0)
+            mic = argv[i + 1];
+        else if (strcmp(argv[i], "-o") == 0)
+            spk = argv[i + 1];
     }
-    // 1. wait create
-    if (RT_EOK != rt_sem_take(thiz->sem, 30000)
-        || thiz->state != CT_SESSION_CREATED)
+    if (mic && !spk)
+        spk = "null";
+    // normally prepared during boot, this only waits if boot is still running
+    boot_wait(RT_WAITING_FOREVER);
+    chat_prepare();
+    rt_mutex_take(thiz->spk_lock, RT_WAITING_FOREVER);
+    if (!thiz->in_turn && !thiz->speaker)
     {
-        rt_kprintf("wait session create fail\n");
-        if (thiz->is_connected)
+        // the last invocation's -o file holds all its answers, finish it
+        audio_io_close(thiz->spk_file);
+        thiz->spk_file = NULL;
+        rt_strncpy(thiz->mic_uri, mic ? mic : "", CHAT_URI_LEN - 1);
+        rt_strncpy(thiz->spk_uri, spk ? spk : "", CHAT_URI_LEN - 1);
+    }
+    rt_mutex_release(thiz->spk_lock);
+    if (thiz->is_active)
+    {
+        if (mic && reconnect_is_up(RECONN_LAYER_SESSION) && (CT_IDLE & CT_BIT(thiz->state)))
+            chat_turn_begin(thiz, 0);
+        else
+            rt_kprintf("chat already running\n");
+        return;
+    }
+    prompt_init();
+    ui_init();
+    thiz->is_active = 1;
+    boot_mark("chat_start");
+
+    // The supervisor connects once BT, PAN and IP are up and keeps
+    // reconnecting the socket and the session whenever they drop.
+    reconnect_init();
+    reconnect_register(RECONN_LAYER_WS, chat_ws_connect, 0);
+    reconnect_register(RECONN_LAYER_SESSION, chat_session_update, 0);
+    rt_kprintf("chat connecting, see reconn_stat for progress\n");
+}
+MSH_CMD_EXPORT(chat, doubao voice chat)
+
+static void chat_wake(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+
+    if (!thiz->thread)
+    {
+        rt_kprintf("start chat first\n");
+        return;
+    }
+    if (argc > 1 && strcmp(argv[1], "off") == 0)
+    {
+        thiz->wake_word = 0;    // first, so the mic path stops feeding what kws_stop tears down
+        kws_stop();
+        if (!thiz->in_turn && !thiz->duplex)
+            mic_off(thiz);
+        rt_kprintf("wake word off\n");
+        return;
+    }
+    if (kws_start(argc > 2 ? argv[2] : CHAT_WAKE_MODEL, chat_wake_detected) != RT_EOK)
+    {
+        rt_kprintf("wake word model load fail\n");
+        return;
+    }
+    thiz->wake_word = 1;
+    mic_on(thiz);
+    rt_kprintf("wake word on\n");
+}
+MSH_CMD_EXPORT(chat_wake, chat_wake on [model] / off: start a chat turn by wake word)
+
+static void uplink_stat(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+    uplink_ctrl_t *u = &thiz->uplink;
+
+    if (!thiz->rb_mic)
+    {
+        rt_kprintf("start chat first\n");
+        return;
+    }
+    rt_kprintf("uplink: %d frames in %d msgs, aggregate %d (max %d), %d deferred, %d write errors\n",
+               u->sent_frames, u->sent_msgs, u->agg, u->agg_max_seen, u->deferred, u->write_errs);
+    rt_kprintf("uplink: mic ring %d/%d bytes, peak %d, %d frames dropped, send buffer free %d\n",
+               spsc_ring_data_len(thiz->rb_mic), thiz->rb_mic->size, thiz->rb_mic->p.peak,
+               thiz->rb_mic->p.dropped, rts_sndbuf(&thiz->rts));
+    rt_kprintf("linkq: profile %s, rtt %d ms, %d kbps, jitter %d ms, %d probes, %d degraded\n",
+               linkq_profile(thiz->linkq.cls)->name, thiz->linkq.rtt_ms, thiz->linkq.kbps,
+               thiz->linkq.jitter_ms, thiz->linkq.probes, thiz->linkq.degraded);
+}
+MSH_CMD_EXPORT(uplink_stat, chat uplink congestion statistics);
+
+/* mic_pre [off|all|hpf|ns|agc ...]: mic preprocessing stages of the chat uplink. */
+static void mic_pre(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+    mic_pre_t *m = &thiz->mic_pre;
+    uint32_t flags = 0;
+
+    if (!thiz->rts.downlink)
+    {
+        rt_kprintf("start chat first\n");
+        return;
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "all") == 0)
+            flags |= MIC_PRE_ALL;
+        else if (strcmp(argv[i], "hpf") == 0)
+            flags |= MIC_PRE_HPF;
+        else if (strcmp(argv[i], "ns") == 0)
+            flags |= MIC_PRE_NS;
+        else if (strcmp(argv[i], "agc") == 0)
+            flags |= MIC_PRE_AGC;
+        else if (strcmp(argv[i], "off") != 0)
         {
-            rt_kprintf("Web socket disconnected\r\n");
-            wsock_close(&thiz->clnt, WSOCK_RESULT_OK,ERR_OK);
+            rt_kprintf("usage: mic_pre [off|all|hpf|ns|agc ...]\n");
+            return;
         }
-        goto Exit;;
     }
-    // 2. send upate
-    rt_kprintf("send update:\r\n");
-    rt_kputs(session_update);
-    rt_kprintf("\r\n\r\n");
+    if (argc > 1)
+        m->flags = (uint8_t)flags;
+    rt_kprintf("mic_pre:%s%s%s%s, %d hops, %d speech, agc %d dB, noise %d dBFS\n",
+               m->flags ? "" : " off", (m->flags & MIC_PRE_HPF) ? " hpf" : "",
+               (m->flags & MIC_PRE_NS) ? " ns" : "", (m->flags & MIC_PRE_AGC) ? " agc" : "",
+               m->hops, m->speech_hops, mic_pre_agc_db10(m) / 10, mic_pre_noise_dbfs(m));
+    if (thiz->dsp_hops)
+        rt_kprintf("mic_pre: dsp thread %d hops, cycles avg %u max %u, target %u\n", thiz->dsp_hops,
+                   (uint32_t)(thiz->dsp_cycles / thiz->dsp_hops), thiz->dsp_cycles_max, MIC_PRE_BUDGET_CYCLES);
+}
+MSH_CMD_EXPORT(mic_pre, mic_pre [off|all|hpf|ns|agc ...]: chat mic preprocessing);
 
-    LOCK_TCPIP_CORE();
-    err = wsock_write(&thiz->clnt, session_update, strlen(session_update), OPCODE_TEXT);
-    UNLOCK_TCPIP_CORE();
+/* chat_duplex [on|off]: keep listening while the answer plays, the echo
+ * cancelled, so speech starts a turn and barges in on the answer. */
+static void chat_duplex(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+    aec_t *a = &thiz->aec;
 
-    if (RT_EOK != rt_sem_take(thiz->sem, 20000)
-        || thiz->state != CT_SESSION_UPDATED)
+    if (!thiz->thread)
     {
-        rt_kprintf("wait session upate fail\n");
-        wsock_close(&thiz->clnt, WSOCK_RESULT_OK,ERR_OK);
-        goto Exit;
+        rt_kprintf("start chat first\n");
+        return;
     }
-    else
+    if (argc > 1 && strcmp(argv[1], "on") == 0 && !thiz->duplex)
     {
-        rt_kprintf("\n\nPress Key1 and Talk, release Key1 and Listen\n\n");
-        return;
+        if (!thiz->rb_ref)
+            thiz->rb_ref = spsc_ring_create(CHAT_REF_RING_SIZE);
+        if (!thiz->rb_ref)
+        {
+            rt_kprintf("chat_duplex: no memory for the reference\n");
+            return;
+        }
+        aec_init(a);
+        thiz->ref_flush = 1;
+        mixer_set_tap(chat_ref_tap, thiz);
+        thiz->duplex = 1;
+        mic_on(thiz);
     }
-Exit:
-    rt_kprintf("\nexit chat\n");
+    else if (argc > 1 && strcmp(argv[1], "off") == 0 && thiz->duplex)
+    {
+        thiz->duplex = 0;
+        if (!thiz->in_turn && !thiz->wake_word)
+            mic_off(thiz);
+    }
+    rt_kprintf("chat_duplex: %s, delay %d ms, erle %d dB, %d hops, %d adapted, %d double talk, %d delay moves\n",
+               thiz->duplex ? "on" : "off", a->delay / 16, aec_erle_db10(a) / 10, a->hops,
+               a->adapt_blocks, a->dt_blocks, a->delay_moves);
+    if (thiz->rb_ref)
+        rt_kprintf("chat_duplex: reference %d bytes queued, peak %d, %d dropped\n",
+                   spsc_ring_data_len(thiz->rb_ref), thiz->rb_ref->p.peak, thiz->rb_ref->p.dropped);
+}
+MSH_CMD_EXPORT(chat_duplex, chat_duplex [on|off]: full duplex chat with echo cancellation);
+
+/* chat_catchup [ms]: answer backlog over the jitter target that plays
+ * faster until it is worked off, 0 for never. Applies from the next answer. */
+static void chat_catchup(int argc, char **argv)
+{
+    chat_ws_t *thiz = &g_thiz;
+
+    if (argc > 1)
+        thiz->catchup_ms = atoi(argv[1]);
+    rt_kprintf("chat_catchup: %d ms over the %d ms jitter target%s\n", thiz->catchup_ms,
+               thiz->linkq.jitter_ms, thiz->catchup_ms ? "" : ", off");
+}
+MSH_CMD_EXPORT(chat_catchup, chat_catchup [ms]: play delayed answers faster down to the target);
+
+void chat_stats(volc_stats_t *s)
+{
+    chat_ws_t *thiz = &g_thiz;
+
+    if (thiz->rb_mic)
+        stats_ring(&s->mic, thiz->rb_mic);
+    if (thiz->rb_raw)
+        stats_ring(&s->raw, thiz->rb_raw);
+    if (thiz->rb_ref)
+        stats_ring(&s->ref, thiz->rb_ref);
+    s->chat_cache = chat_speaker_queued(thiz);
+    LOCK_TCPIP_CORE();
+    if (thiz->rts.clnt.pcb)
+        s->sndq = TCP_SND_BUF - altcp_sndbuf(thiz->rts.clnt.pcb);
+    UNLOCK_TCPIP_CORE();
+    s->tx_msgs += thiz->rts.tx_msgs;
+    s->tx_bytes += thiz->rts.tx_bytes;
+    s->rx_dropped += thiz->rts.rx_dropped;
+    if (thiz->rts.downlink)
+        downlink_counters(thiz->rts.downlink, &s->rx_msgs, &s->rx_bytes);
 }
-MSH_CMD_EXPORT(chat, doubao voice chat)
 
 
 
@@ -0,0 +1,279 @@
+/**
+  ******************************************************************************
+  * @file   downlink.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf0_hal.h"
+#include "downlink.h"
+#include "cycle_counter.h"
+
+#define DOWNLINK_MAX            4       // one per realtime session
+#define DOWNLINK_QUEUE_DEPTH    32
+// above either the socket stops taking data until the worker catches up
+#define DOWNLINK_MAX_QUEUED     (48 * 1024)
+#define DOWNLINK_MAX_MSGS       (DOWNLINK_QUEUE_DEPTH / 2)  // a refused segment may hold several
+
+typedef struct
+{
+    size_t  len;
+    char    data[];
+} downlink_msg_t;
+
+struct downlink
+{
+    const char          *name;
+    downlink_handler_t  handler;
+    void                *ctx;
+    rt_mailbox_t        mb;
+    rt_thread_t         thread;
+    uint8_t             is_inline;      // old behaviour, handle on the tcpip thread
+
+    // producer side, tcpip thread; posted/handled only grow, the backlog
+    // is their difference and `downlink reset` moves the *_base snapshot
+    uint32_t            posted;
+    uint32_t            posted_bytes;
+    uint32_t            posted_base;
+    uint32_t            handled_base;
+    uint32_t            dropped;
+    uint32_t            deferred;       // receives refused by downlink_backlogged
+    uint32_t            cb_cycles;      // time spent in the websocket callback
+    uint32_t            cb_max;
+    uint32_t            since_ms;
+    // consumer side, worker thread
+    uint32_t            handled;
+    uint32_t            handled_bytes;
+    uint32_t            queued_peak;
+};
+
+static downlink_t *g_downlinks[DOWNLINK_MAX];
+
+/* Bytes in flight. Signed: the worker may count a message handled before
+ * the post that queued it has counted it posted. */
+static int32_t downlink_queued(const downlink_t *dl)
+{
+    return (int32_t)(dl->posted_bytes - dl->handled_bytes);
+}
+
+static uint32_t downlink_now_ms(void)
+{
+    return rt_tick_get() * 1000 / RT_TICK_PER_SECOND;
+}
+
+static void downlink_entry(void *p)
+{
+    downlink_t *dl = (downlink_t *)p;
+
+    for (;;)
+    {
+        rt_ubase_t value;
+        downlink_msg_t *msg;
+
+        if (rt_mb_recv(dl->mb, &value, RT_WAITING_FOREVER) != RT_EOK)
+            continue;
+        msg = (downlink_msg_t *)value;
+        dl->handler(dl->ctx, msg->data, msg->len);
+        dl->handled++;
+        dl->handled_bytes += msg->len;
+        rt_free(msg);
+    }
+}
+
+downlink_t *downlink_create(const char *name, downlink_handler_t handler, void *ctx)
+{
+    downlink_t *dl = rt_calloc(1, sizeof(downlink_t));
+    int i;
+
+    if (!dl)
+        return NULL;
+    dl->name = name;
+    dl->handler = handler;
+    dl->ctx = ctx;
+    dl->since_ms = downlink_now_ms();
+    cycle_counter_init();
+    dl->mb = rt_mb_create(name, DOWNLINK_QUEUE_DEPTH, RT_IPC_FLAG_FIFO);
+    // same priority as the pipeline threads that used to be starved by it
+    dl->thread = rt_thread_create(name, downlink_entry, dl, 3072,
+                                  RT_THREAD_PRIORITY_MIDDLE + RT_THREAD_PRIORITY_HIGHER,
+                                  RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(dl->mb && dl->thread);
+    for (i = 0; i < DOWNLINK_MAX; i++)
+    {
+        if (!g_downlinks[i])
+        {
+            g_downlinks[i] = dl;
+            break;
+        }
+    }
+    rt_thread_startup(dl->thread);
+    return dl;
+}
+
+void downlink_counters(const downlink_t *dl, uint32_t *msgs, uint32_t *bytes)
+{
+    *msgs += dl->posted;
+    *bytes += dl->posted_bytes;
+}
+
+rt_err_t downlink_post(downlink_t *dl, const char *buf, size_t len)
+{
+    uint32_t start = cycle_counter_get();
+    downlink_msg_t *msg;
+    rt_err_t err = RT_EOK;
+
+    if (dl->is_inline)
+    {
+        // keep the old path measurable: the handler expects a C string
+        msg = rt_malloc(sizeof(downlink_msg_t) + len + 1);
+        if (msg)
+        {
+            memcpy(msg->data, buf, len);
+            msg->data[len] = '\0';
+            dl->handler(dl->ctx, msg->data, len);
+            rt_free(msg);
+            dl->posted++;
+            dl->handled++;
+            dl->posted_bytes += len;
+            dl->handled_bytes += len;
+        }
+        else
+        {
+            dl->dropped++;
+            err = -RT_ENOMEM;
+        }
+        goto Exit;
+    }
+
+    msg = rt_malloc(sizeof(downlink_msg_t) + len + 1);
+    if (!msg)
+    {
+        dl->dropped++;
+        err = -RT_ENOMEM;
+        goto Exit;
+    }
+    msg->len = len;
+    memcpy(msg->data, buf, len);
+    msg->data[len] = '\0';
+    // never waits on the tcpip thread, backlogged receives keep the queue from filling
+    if (rt_mb_send(dl->mb, (rt_ubase_t)msg) != RT_EOK)
+    {
+        dl->dropped++;
+        rt_free(msg);
+        err = -RT_EFULL;
+        goto Exit;
+    }
+    // counted once queued, so only messages the worker will handle are in flight
+    dl->posted++;
+    dl->posted_bytes += len;
+    if (downlink_queued(dl) > (int32_t)dl->queued_peak)
+        dl->queued_peak = downlink_queued(dl);
+Exit:
+    start = cycle_counter_get() - start;
+    dl->cb_cycles += start;
+    if (start > dl->cb_max)
+        dl->cb_max = start;
+    return err;
+}
+
+int downlink_backlogged(downlink_t *dl)
+{
+    if (dl->is_inline || (downlink_queued(dl) <= DOWNLINK_MAX_QUEUED &&
+                          (int32_t)(dl->posted - dl->handled) < DOWNLINK_MAX_MSGS))
+        return 0;
+    dl->deferred++;
+    return 1;
+}
+
+static void downlink(int argc, char **argv)
+{
+    uint32_t now = downlink_now_ms();
+    uint32_t cycles_per_ms = SystemCoreClock / 1000;
+    int i;
+
+    if (argc < 2)
+    {
+        rt_kprintf("usage: downlink stat|reset|inline|queued\n");
+        return;
+    }
+    for (i = 0; i < DOWNLINK_MAX; i++)
+    {
+        downlink_t *dl = g_downlinks[i];
+        uint32_t elapsed, posted;
+
+        if (!dl)
+            continue;
+        if (strcmp(argv[1], "inline") == 0 || strcmp(argv[1], "queued") == 0)
+        {
+            dl->is_inline = argv[1][0] == 'i';
+            argv[1] = "reset";
+        }
+        if (strcmp(argv[1], "reset") == 0)
+        {
+            // messages may still be queued, keep the flow control counters
+            dl->posted_base = dl->posted;
+            dl->handled_base = dl->handled;
+            dl->dropped = dl->deferred = 0;
+            dl->cb_cycles = dl->cb_max = dl->queued_peak = 0;
+            dl->since_ms = now;
+            continue;
+        }
+        elapsed = now - dl->since_ms;
+        posted = dl->posted - dl->posted_base;
+        rt_kprintf("%s: %s, %d posted %d handled %d dropped %d deferred, queued %d peak %d bytes\n",
+                   dl->name, dl->is_inline ? "inline" : "queued", posted, dl->handled - dl->handled_base,
+                   dl->dropped, dl->deferred, downlink_queued(dl), dl->queued_peak);
+        if (elapsed && posted)
+        {
+            // tcpip thread time spent in our callback, per mille of wall time
+            rt_kprintf("%s: tcpip occupancy %d.%d%%, callback avg %d us max %d us over %d ms\n", dl->name,
+                       (uint32_t)((uint64_t)dl->cb_cycles * 1000 / cycles_per_ms / elapsed) / 10,
+                       (uint32_t)((uint64_t)dl->cb_cycles * 1000 / cycles_per_ms / elapsed) % 10,
+                       dl->cb_cycles / posted / (cycles_per_ms / 1000),
+                       dl->cb_max / (cycles_per_ms / 1000), elapsed);
+        }
+    }
+}
+MSH_CMD_EXPORT(downlink, downlink stat|reset|inline|queued: websocket downlink dispatch);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file   downlink.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __DOWNLINK_H__
+#define __DOWNLINK_H__
+
+#include <rtthread.h>
+#include <stddef.h>
+
+/*
+ * Downlink dispatcher. The websocket callback runs on the tcpip thread, so
+ * it only copies the message and queues it; JSON parsing, base64 decoding
+ * and audio writes run on the dispatcher's own worker thread.
+ */
+typedef void (*downlink_handler_t)(void *ctx, const char *data, size_t len);
+
+typedef struct downlink downlink_t;
+
+/* Workers live as long as the app, like the sessions owning them. */
+downlink_t  *downlink_create(const char *name, downlink_handler_t handler, void *ctx);
+
+/* Called from the websocket callback, never blocks. */
+rt_err_t    downlink_post(downlink_t *dl, const char *buf, size_t len);
+/* Whether the worker is far behind, so the socket should not take more
+ * data for now. Called on the tcpip thread before the data is parsed. */
+int         downlink_backlogged(downlink_t *dl);
+
+/* Adds the messages and bytes received so far, for rate statistics. */
+void        downlink_counters(const downlink_t *dl, uint32_t *msgs, uint32_t *bytes);
+
+#endif /* __DOWNLINK_H__ */
@@ -0,0 +1,100 @@
+/**
+  ******************************************************************************
+  * @file   g711.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include "g711.h"
+
+#define G711_BIAS       0x84
+#define G711_CLIP       32635
+
+uint8_t g711_ulaw_encode(int16_t pcm)
+{
+    int sign = (pcm >> 8) & 0x80;
+    int v = sign ? -pcm : pcm;
+    int exp = 7, mant;
+
+    if (v > G711_CLIP)
+        v = G711_CLIP;
+    v += G711_BIAS;
+    while (exp > 0 && !(v & (0x4000 >> (7 - exp))))
+        exp--;
+    mant = (v >> (exp + 3)) & 0x0F;
+    return ~(sign | (exp << 4) | mant);
+}
+
+int16_t g711_ulaw_decode(uint8_t ulaw)
+{
+    int v;
+
+    ulaw = ~ulaw;
+    v = ((((ulaw & 0x0F) << 3) + G711_BIAS) << ((ulaw & 0x70) >> 4)) - G711_BIAS;
+    return (ulaw & 0x80) ? -v : v;
+}
+
+uint32_t g711_encode_16k(const int16_t *in, uint32_t samples, uint8_t *out)
+{
+    uint32_t i;
+
+    // averaging the pair is a crude low pass, enough for speech into G.711
+    for (i = 0; i + 1 < samples; i += 2)
+        out[i / 2] = g711_ulaw_encode((int16_t)(((int32_t)in[i] + in[i + 1]) >> 1));
+    return samples / 2;
+}
+
+void g711_decode_16k(g711_upsampler_t *up, const uint8_t *in, uint32_t n, int16_t *out)
+{
+    int16_t last = up->last, s;
+    uint32_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        s = g711_ulaw_decode(in[i]);
+        out[2 * i] = (int16_t)(((int32_t)last + s) >> 1);
+        out[2 * i + 1] = s;
+        last = s;
+    }
+    up->last = last;
+}
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
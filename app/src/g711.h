@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file   g711.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __G711_H__
+#define __G711_H__
+
+#include <stdint.h>
+
+/*
+ * G.711 mu-law at 8 kHz for the narrow link profile, converted from and to
+ * the 16 kHz pcm16 the codec runs at. A quarter of the pcm16 bytes.
+ */
+typedef struct
+{
+    int16_t     last;       // previous 8 kHz sample, for interpolation
+} g711_upsampler_t;
+
+uint8_t g711_ulaw_encode(int16_t pcm);
+int16_t g711_ulaw_decode(uint8_t ulaw);
+
+/* 16 kHz pcm16 in, one mu-law byte per sample pair out; samples is even.
+ * out may alias in. Returns bytes written. */
+uint32_t g711_encode_16k(const int16_t *in, uint32_t samples, uint8_t *out);
+/* n mu-law bytes in, 2n samples of 16 kHz pcm16 out. */
+void     g711_decode_16k(g711_upsampler_t *up, const uint8_t *in, uint32_t n, int16_t *out);
+
+#endif /* __G711_H__ */
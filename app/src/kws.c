@@ -0,0 +1,626 @@
+/**
+  ******************************************************************************
+  * @file   kws.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include "dfs_posix.h"
+#include "kws.h"
+#include "cycle_counter.h"
+#include "spsc_ring.h"
+
+#define KWS_MODEL_MAGIC     0x3153574B      // "KWS1"
+#define KWS_SMOOTH_LEN      8
+#define KWS_REFRACTORY      100             // frames, 1 s
+#define KWS_PI              3.14159265358979f
+
+#define KWS_EVENT_DATA      (1 << 0)
+#define KWS_EVENT_EXIT      (1 << 1)
+
+/* Model file layout, little endian:
+ *   kws_file_hdr_t
+ *   n_layers x { kws_file_layer_t, int32_t bias[out], int8_t weight[out * in] padded to 4 }
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t n_mfcc;
+    uint16_t n_frames;
+    float    feat_scale;
+    uint8_t  n_layers;
+    uint8_t  threshold;
+    uint16_t reserved;
+} kws_file_hdr_t;
+
+typedef struct
+{
+    uint16_t in;
+    uint16_t out;
+    uint8_t  shift;
+    uint8_t  relu;
+    uint16_t reserved;
+} kws_file_layer_t;
+
+/* Front end tables, shared by all instances. */
+static float   g_window[KWS_FRAME_LEN];
+static float   g_tw_cos[KWS_FFT_LEN / 2];
+static float   g_tw_sin[KWS_FFT_LEN / 2];
+static int16_t g_mel_bin[KWS_NUM_MEL + 2];
+static float   g_dct[KWS_NUM_MFCC][KWS_NUM_MEL];
+static uint8_t g_tables_ready;
+
+static float kws_hz_to_mel(float hz)
+{
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float kws_mel_to_hz(float mel)
+{
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+static void kws_init_tables(void)
+{
+    int i, j;
+    float mel_lo, mel_hi;
+
+    if (g_tables_ready)
+        return;
+    for (i = 0; i < KWS_FRAME_LEN; i++)
+        g_window[i] = 0.54f - 0.46f * cosf(2 * KWS_PI * i / (KWS_FRAME_LEN - 1));
+    for (i = 0; i < KWS_FFT_LEN / 2; i++)
+    {
+        g_tw_cos[i] = cosf(2 * KWS_PI * i / KWS_FFT_LEN);
+        g_tw_sin[i] = sinf(2 * KWS_PI * i / KWS_FFT_LEN);
+    }
+    mel_lo = kws_hz_to_mel(20.0f);
+    mel_hi = kws_hz_to_mel(4000.0f);
+    for (i = 0; i < KWS_NUM_MEL + 2; i++)
+    {
+        float hz = kws_mel_to_hz(mel_lo + (mel_hi - mel_lo) * i / (KWS_NUM_MEL + 1));
+        g_mel_bin[i] = (int16_t)(hz * KWS_FFT_LEN / KWS_SAMPLE_RATE + 0.5f);
+    }
+    for (i = 0; i < KWS_NUM_MFCC; i++)
+        for (j = 0; j < KWS_NUM_MEL; j++)
+            g_dct[i][j] = cosf(KWS_PI * i * (j + 0.5f) / KWS_NUM_MEL);
+    g_tables_ready = 1;
+}
+
+/* In place radix-2 complex FFT of KWS_FFT_LEN / 2 points. */
+static void kws_fft(float *re, float *im)
+{
+    const int n = KWS_FFT_LEN / 2;
+    int i, j, k, m;
+
+    for (i = 1, j = 0; i < n; i++)
+    {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+        if (i < j)
+        {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (m = 2; m <= n; m <<= 1)
+    {
+        int step = KWS_FFT_LEN / m;
+        for (i = 0; i < n; i += m)
+        {
+            for (k = 0; k < m / 2; k++)
+            {
+                float wr = g_tw_cos[k * step];
+                float wi = -g_tw_sin[k * step];
+                int a = i + k, b = i + k + m / 2;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* MFCC of the current analysis window, quantised into the feature ring. */
+static void kws_frontend(kws_t *kws)
+{
+    const int half = KWS_FFT_LEN / 2;
+    float *re = kws->fft_re, *im = kws->fft_im;
+    float power[KWS_FFT_LEN / 2 + 1];
+    float logmel[KWS_NUM_MEL];
+    int i, k;
+
+    // Real FFT packed into a half length complex FFT, with pre-emphasis.
+    for (i = 0; i < half; i++)
+    {
+        int n0 = 2 * i, n1 = 2 * i + 1;
+        float x0 = 0, x1 = 0;
+        if (n0 < KWS_FRAME_LEN)
+            x0 = (kws->pcm[n0] - 0.97f * kws->pcm[n0 ? n0 - 1 : 0]) * g_window[n0];
+        if (n1 < KWS_FRAME_LEN)
+            x1 = (kws->pcm[n1] - 0.97f * kws->pcm[n0]) * g_window[n1];
+        re[i] = x0 * (1.0f / 32768);
+        im[i] = x1 * (1.0f / 32768);
+    }
+    kws_fft(re, im);
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (k = 1; k < half; k++)
+    {
+        int m = half - k;
+        float er = (re[k] + re[m]) * 0.5f, ei = (im[k] - im[m]) * 0.5f;
+        float orr = (im[k] + im[m]) * 0.5f, oi = -(re[k] - re[m]) * 0.5f;
+        float wr = g_tw_cos[k], wi = -g_tw_sin[k];
+        float xr = er + orr * wr - oi * wi;
+        float xi = ei + orr * wi + oi * wr;
+        power[k] = xr * xr + xi * xi;
+    }
+
+    for (i = 0; i < KWS_NUM_MEL; i++)
+    {
+        int lo = g_mel_bin[i], mid = g_mel_bin[i + 1], hi = g_mel_bin[i + 2];
+        float e = 1e-6f;
+        for (k = lo; k < mid; k++)
+            e += power[k] * (k - lo) / (float)(mid - lo);
+        for (k = mid; k < hi; k++)
+            e += power[k] * (hi - k) / (float)(hi - mid);
+        logmel[i] = logf(e);
+    }
+
+    int8_t *feat = kws->feat[kws->feat_head];
+    for (i = 0; i < KWS_NUM_MFCC; i++)
+    {
+        float c = 0;
+        for (k = 0; k < KWS_NUM_MEL; k++)
+            c += logmel[k] * g_dct[i][k];
+        int q = (int)lrintf(c * kws->model->feat_scale);
+        feat[i] = (int8_t)(q > 127 ? 127 : (q < -128 ? -128 : q));
+    }
+    kws->feat_head = (kws->feat_head + 1) % KWS_NUM_FRAMES;
+    if (kws->feat_count < KWS_NUM_FRAMES)
+        kws->feat_count++;
+}
+
+static int32_t kws_dot(const int8_t *w, const int8_t *x, int n, int32_t acc)
+{
+    int i = 0;
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    for (; i + 4 <= n; i += 4)
+    {
+        uint32_t wv, xv;
+        memcpy(&wv, w + i, 4);
+        memcpy(&xv, x + i, 4);
+        acc = __SMLAD(__SXTB16(wv), __SXTB16(xv), acc);
+        acc = __SMLAD(__SXTB16(__ROR(wv, 8)), __SXTB16(__ROR(xv, 8)), acc);
+    }
+#endif
+    for (; i < n; i++)
+        acc += w[i] * x[i];
+    return acc;
+}
+
+/* Returns the keyword posterior, Q8. */
+static uint8_t kws_infer(kws_t *kws)
+{
+    const kws_model_t *model = kws->model;
+    int8_t *in = kws->act[0], *out = kws->act[1];
+    float logit[8], max = -1e30f, sum = 0;
+    int l, o, t;
+
+    // oldest frame first
+    for (t = 0; t < KWS_NUM_FRAMES; t++)
+        memcpy(in + t * KWS_NUM_MFCC, kws->feat[(kws->feat_head + t) % KWS_NUM_FRAMES], KWS_NUM_MFCC);
+
+    for (l = 0; l < model->n_layers; l++)
+    {
+        const kws_layer_t *layer = &model->layer[l];
+        int last = (l == model->n_layers - 1);
+        for (o = 0; o < layer->out; o++)
+        {
+            int32_t acc = kws_dot(layer->weight + o * layer->in, in, layer->in, layer->bias[o]);
+            if (last)
+            {
+                logit[o] = (float)acc / (1 << layer->shift);
+                if (logit[o] > max)
+                    max = logit[o];
+                continue;
+            }
+            acc >>= layer->shift;
+            if (layer->relu && acc < 0)
+                acc = 0;
+            out[o] = (int8_t)(acc > 127 ? 127 : (acc < -128 ? -128 : acc));
+        }
+        int8_t *tmp = in;
+        in = out;
+        out = tmp;
+    }
+
+    for (o = 0; o < model->n_classes; o++)
+    {
+        logit[o] = expf(logit[o] - max);
+        sum += logit[o];
+    }
+    // class 0 is filler, anything else is a keyword
+    return (uint8_t)((1.0f - logit[0] / sum) * 255.0f);
+}
+
+int kws_model_load(kws_model_t *model, const char *path)
+{
+    struct stat st;
+    kws_file_hdr_t *hdr;
+    uint8_t *p, *end;
+    int fd, l;
+    uint16_t width = KWS_NUM_FRAMES * KWS_NUM_MFCC;
+
+    memset(model, 0, sizeof(*model));
+    if (stat(path, &st) != 0 || st.st_size < (int)sizeof(kws_file_hdr_t))
+        return -RT_ERROR;
+    model->blob = rt_malloc(st.st_size);
+    if (!model->blob)
+        return -RT_ENOMEM;
+    model->size = st.st_size;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || read(fd, model->blob, st.st_size) != st.st_size)
+    {
+        if (fd >= 0)
+            close(fd);
+        goto Fail;
+    }
+    close(fd);
+
+    hdr = (kws_file_hdr_t *)model->blob;
+    if (hdr->magic != KWS_MODEL_MAGIC || hdr->n_mfcc != KWS_NUM_MFCC || hdr->n_frames != KWS_NUM_FRAMES
+            || hdr->n_layers == 0 || hdr->n_layers > KWS_MAX_LAYERS)
+        goto Fail;
+    model->feat_scale = hdr->feat_scale;
+    model->threshold = hdr->threshold;
+    model->n_layers = hdr->n_layers;
+
+    p = (uint8_t *)(hdr + 1);
+    end = (uint8_t *)model->blob + st.st_size;
+    for (l = 0; l < model->n_layers; l++)
+    {
+        kws_file_layer_t *fl = (kws_file_layer_t *)p;
+        kws_layer_t *layer = &model->layer[l];
+        if (p + sizeof(*fl) > end || fl->in != width)
+            goto Fail;
+        layer->in = fl->in;
+        layer->out = fl->out;
+        layer->shift = fl->shift;
+        layer->relu = fl->relu;
+        p += sizeof(*fl);
+        layer->bias = (const int32_t *)p;
+        p += fl->out * sizeof(int32_t);
+        layer->weight = (const int8_t *)p;
+        p += RT_ALIGN(fl->out * fl->in, 4);
+        if (p > end)
+            goto Fail;
+        width = fl->out;
+        if (width > model->max_width)
+            model->max_width = width;
+    }
+    model->n_classes = model->layer[model->n_layers - 1].out;
+    if (model->n_classes < 2 || model->n_classes > 8)
+        goto Fail;
+    if (model->max_width < KWS_NUM_FRAMES * KWS_NUM_MFCC)
+        model->max_width = KWS_NUM_FRAMES * KWS_NUM_MFCC;
+    return RT_EOK;
+
+Fail:
+    rt_kprintf("kws: bad model %s\n", path);
+    kws_model_free(model);
+    return -RT_ERROR;
+}
+
+void kws_model_free(kws_model_t *model)
+{
+    if (model->blob)
+        rt_free(model->blob);
+    memset(model, 0, sizeof(*model));
+}
+
+int kws_init(kws_t *kws, const kws_model_t *model)
+{
+    memset(kws, 0, sizeof(*kws));
+    kws_init_tables();
+    kws->model = model;
+    kws->act[0] = rt_malloc(model->max_width * 2);
+    if (!kws->act[0])
+        return -RT_ENOMEM;
+    kws->act[1] = kws->act[0] + model->max_width;
+    return RT_EOK;
+}
+
+void kws_deinit(kws_t *kws)
+{
+    if (kws->act[0])
+        rt_free(kws->act[0]);
+    kws->act[0] = kws->act[1] = NULL;
+}
+
+int kws_process(kws_t *kws, const int16_t *pcm, uint32_t samples)
+{
+    int detected = 0;
+
+    while (samples)
+    {
+        uint32_t n = KWS_FRAME_LEN - kws->pcm_fill;
+        if (n > samples)
+            n = samples;
+        memcpy(&kws->pcm[kws->pcm_fill], pcm, n * sizeof(int16_t));
+        kws->pcm_fill += n;
+        pcm += n;
+        samples -= n;
+        if (kws->pcm_fill < KWS_FRAME_LEN)
+            break;
+
+        kws_frontend(kws);
+        memmove(kws->pcm, kws->pcm + KWS_FRAME_SHIFT, (KWS_FRAME_LEN - KWS_FRAME_SHIFT) * sizeof(int16_t));
+        kws->pcm_fill = KWS_FRAME_LEN - KWS_FRAME_SHIFT;
+
+        if (kws->refractory)
+            kws->refractory--;
+        if (kws->feat_count < KWS_NUM_FRAMES || ++kws->infer_phase < KWS_INFER_EVERY)
+            continue;
+        kws->infer_phase = 0;
+
+        uint32_t avg = 0;
+        kws->post[kws->post_idx++ % KWS_SMOOTH_LEN] = kws_infer(kws);
+        for (int i = 0; i < KWS_SMOOTH_LEN; i++)
+            avg += kws->post[i];
+        avg /= KWS_SMOOTH_LEN;
+        if (avg >= kws->model->threshold && !kws->refractory)
+        {
+            detected++;
+            kws->refractory = KWS_REFRACTORY;
+            memset(kws->post, 0, sizeof(kws->post));
+        }
+    }
+    return detected;
+}
+
+/* Background detection on the mic stream. ----------------------------------*/
+typedef struct
+{
+    rt_thread_t     thread;
+    rt_event_t      event;
+    spsc_ring_t     *rb_pcm;
+    kws_model_t     model;
+    kws_t           kws;
+    void (*detected)(void);
+    uint8_t         is_exit;
+} kws_runner_t;
+
+static kws_runner_t g_kws_runner;
+
+static void kws_thread_entry(void *p)
+{
+    kws_runner_t *thiz = &g_kws_runner;
+    int16_t frame[KWS_FRAME_SHIFT];
+
+    while (!thiz->is_exit)
+    {
+        rt_uint32_t evt = 0;
+        rt_event_recv(thiz->event, KWS_EVENT_DATA | KWS_EVENT_EXIT, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                      RT_WAITING_FOREVER, &evt);
+        while (!thiz->is_exit && spsc_ring_data_len(thiz->rb_pcm) >= sizeof(frame))
+        {
+            spsc_ring_get(thiz->rb_pcm, frame, sizeof(frame));
+            if (kws_process(&thiz->kws, frame, KWS_FRAME_SHIFT) && thiz->detected)
+            {
+                rt_kprintf("kws: wake word\n");
+                thiz->detected();
+            }
+        }
+    }
+}
+
+int kws_start(const char *model_path, void (*detected)(void))
+{
+    kws_runner_t *thiz = &g_kws_runner;
+
+    if (thiz->thread)
+        return RT_EOK;
+    if (kws_model_load(&thiz->model, model_path) != RT_EOK)
+        return -RT_ERROR;
+    if (kws_init(&thiz->kws, &thiz->model) != RT_EOK)
+    {
+        kws_model_free(&thiz->model);
+        return -RT_ENOMEM;
+    }
+    thiz->detected = detected;
+    thiz->is_exit = 0;
+    thiz->event = rt_event_create("kws", RT_IPC_FLAG_FIFO);
+    RT_ASSERT(thiz->event);
+    thiz->rb_pcm = spsc_ring_create(4096);   // 12 frames
+    RT_ASSERT(thiz->rb_pcm);
+    // below the chat and tts threads, detection may lag but never the audio
+    thiz->thread = rt_thread_create("kws",
+                                    kws_thread_entry,
+                                    NULL,
+                                    3072,
+                                    RT_THREAD_PRIORITY_LOW,
+                                    RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->thread);
+    rt_thread_startup(thiz->thread);
+    return RT_EOK;
+}
+
+void kws_stop(void)
+{
+    kws_runner_t *thiz = &g_kws_runner;
+
+    if (!thiz->thread)
+        return;
+    thiz->is_exit = 1;
+    rt_event_send(thiz->event, KWS_EVENT_EXIT);
+    while (rt_thread_find("kws"))
+        rt_thread_mdelay(10);
+    thiz->thread = NULL;
+    rt_event_delete(thiz->event);
+    spsc_ring_destroy(thiz->rb_pcm);
+    kws_deinit(&thiz->kws);
+    kws_model_free(&thiz->model);
+}
+
+void kws_feed(const int16_t *pcm, uint32_t samples)
+{
+    kws_runner_t *thiz = &g_kws_runner;
+
+    if (!thiz->thread || thiz->is_exit)
+        return;
+    spsc_ring_put(thiz->rb_pcm, pcm, samples * sizeof(int16_t));
+    if (spsc_ring_data_len(thiz->rb_pcm) >= KWS_FRAME_SHIFT * sizeof(int16_t))
+        rt_event_send(thiz->event, KWS_EVENT_DATA);
+}
+
+/* Benchmark on recorded 16 kHz mono pcm16 fixtures. The optional label file
+ * holds one keyword onset per line, in seconds. Needs a trained model in the
+ * layout above; none ships with the tree, so detection rate and false
+ * accepts per hour are only as good as the model and fixtures given. */
+#define KWS_BENCH_MAX_LABELS    64
+#define KWS_BENCH_HIT_WINDOW    (150)   // frames after the onset, 1.5 s
+
+static void kws_bench(int argc, char **argv)
+{
+    kws_model_t model;
+    kws_t *kws;
+    int16_t frame[KWS_FRAME_SHIFT];
+    uint32_t labels[KWS_BENCH_MAX_LABELS];
+    uint8_t label_hit[KWS_BENCH_MAX_LABELS] = {0};
+    int n_labels = 0, hits = 0, false_accepts = 0, fd;
+    uint32_t frames = 0, cycles_max = 0;
+    uint64_t cycles_total = 0;      // hours of fixture audio overflow 32 bits
+
+    if (argc < 3)
+    {
+        rt_kprintf("usage: kws_bench <model> <pcm16 file> [label file]\n");
+        rt_kprintf("       the model is not part of the tree, train one and copy it over\n");
+        return;
+    }
+    if (argc > 3)
+    {
+        FILE *fp = fopen(argv[3], "r");
+        char line[32];
+        while (fp && n_labels < KWS_BENCH_MAX_LABELS && fgets(line, sizeof(line), fp))
+            labels[n_labels++] = (uint32_t)(strtof(line, NULL) * 100);
+        if (fp)
+            fclose(fp);
+    }
+    if (kws_model_load(&model, argv[1]) != RT_EOK)
+    {
+        rt_kprintf("kws_bench: no usable model at %s, none ships with the tree\n", argv[1]);
+        return;
+    }
+    kws = rt_malloc(sizeof(kws_t));
+    if (!kws || kws_init(kws, &model) != RT_EOK)
+        goto Exit;
+    fd = open(argv[2], O_RDONLY);
+    if (fd < 0)
+    {
+        rt_kprintf("open %s fail\n", argv[2]);
+        goto Exit;
+    }
+
+    cycle_counter_init();
+    while (read(fd, frame, sizeof(frame)) == sizeof(frame))
+    {
+        uint32_t start = cycle_counter_get();
+        int det = kws_process(kws, frame, KWS_FRAME_SHIFT);
+        uint32_t cycles = cycle_counter_get() - start;
+
+        cycles_total += cycles;
+        if (cycles > cycles_max)
+            cycles_max = cycles;
+        if (det)
+        {
+            int matched = 0;
+            for (int i = 0; i < n_labels; i++)
+            {
+                if (frames >= labels[i] && frames < labels[i] + KWS_BENCH_HIT_WINDOW && !label_hit[i])
+                {
+                    label_hit[i] = 1;
+                    hits++;
+                    matched = 1;
+                    break;
+                }
+            }
+            if (!matched)
+                false_accepts++;
+            rt_kprintf("  detect at %d.%02d s\n", frames / 100, frames % 100);
+        }
+        frames++;
+    }
+    close(fd);
+
+    rt_kprintf("kws: %d frames (%d s), model %d bytes, state %d bytes\n",
+               frames, frames / 100, model.size, model.max_width * 2 + (int)sizeof(kws_t));
+    if (n_labels)
+        rt_kprintf("kws: detection %d/%d (%d%%)\n", hits, n_labels, hits * 100 / n_labels);
+    if (frames)
+    {
+        uint32_t fa_per_hour_x100 = (uint32_t)((uint64_t)false_accepts * 36000000 / frames);
+        rt_kprintf("kws: false accepts %d, %d.%02d per hour\n", false_accepts,
+                   fa_per_hour_x100 / 100, fa_per_hour_x100 % 100);
+        rt_kprintf("kws: cycles per 10 ms frame avg %d max %d\n", (uint32_t)(cycles_total / frames), cycles_max);
+    }
+Exit:
+    if (kws)
+    {
+        kws_deinit(kws);
+        rt_free(kws);
+    }
+    kws_model_free(&model);
+}
+MSH_CMD_EXPORT(kws_bench, Benchmark wake word detection on a recorded fixture);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
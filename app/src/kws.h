@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file   kws.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __KWS_H__
+#define __KWS_H__
+
+#include <stdint.h>
+
+#define KWS_SAMPLE_RATE     16000
+#define KWS_FRAME_SHIFT     160     // 10 ms hop
+#define KWS_FRAME_LEN       480     // 30 ms analysis window
+#define KWS_FFT_LEN         512
+#define KWS_NUM_MEL         40
+#define KWS_NUM_MFCC        10
+#define KWS_NUM_FRAMES      49      // ~0.5 s of context
+#define KWS_MAX_LAYERS      4
+#define KWS_INFER_EVERY     3       // run the model every 30 ms
+
+typedef struct
+{
+    uint16_t        in;
+    uint16_t        out;
+    uint8_t         shift;
+    uint8_t         relu;
+    const int32_t   *bias;
+    const int8_t    *weight;        // out rows of in weights
+} kws_layer_t;
+
+typedef struct
+{
+    void            *blob;          // model file contents
+    uint32_t        size;
+    float           feat_scale;
+    uint8_t         threshold;      // smoothed keyword posterior, Q8
+    uint8_t         n_layers;
+    uint8_t         n_classes;
+    uint16_t        max_width;
+    kws_layer_t     layer[KWS_MAX_LAYERS];
+} kws_model_t;
+
+typedef struct
+{
+    const kws_model_t *model;
+    int16_t     pcm[KWS_FRAME_LEN];
+    uint16_t    pcm_fill;
+    int8_t      feat[KWS_NUM_FRAMES][KWS_NUM_MFCC];
+    uint8_t     feat_head;
+    uint8_t     feat_count;
+    uint8_t     infer_phase;
+    uint8_t     post[8];            // last keyword posteriors, Q8
+    uint8_t     post_idx;
+    uint16_t    refractory;         // frames left before the next trigger
+    int8_t      *act[2];            // activation ping-pong buffers
+    float       fft_re[KWS_FFT_LEN / 2];
+    float       fft_im[KWS_FFT_LEN / 2];
+} kws_t;
+
+/* Loads a model file, layout in kws.c. No trained model ships with the
+ * tree: the wake word and kws_bench need one copied to the device. */
+int  kws_model_load(kws_model_t *model, const char *path);
+void kws_model_free(kws_model_t *model);
+
+int  kws_init(kws_t *kws, const kws_model_t *model);
+void kws_deinit(kws_t *kws);
+/* Feed 16 kHz mono PCM, returns the number of keyword detections. */
+int  kws_process(kws_t *kws, const int16_t *pcm, uint32_t samples);
+
+/* Run detection in the background on the mic stream. */
+int  kws_start(const char *model_path, void (*detected)(void));
+void kws_stop(void);
+void kws_feed(const int16_t *pcm, uint32_t samples);
+
+#endif /* __KWS_H__ */
@@ -0,0 +1,176 @@
+/**
+  ******************************************************************************
+  * @file   link_policy.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stddef.h>
+#include <string.h>
+#include "link_policy.h"
+
+void link_policy_init(link_policy_t *lp, const lp_ops_t *ops, uint32_t idle_ms)
+{
+    memset(lp, 0, sizeof(*lp));
+    lp->ops = ops;
+    lp->idle_ms = idle_ms;
+    lp->mode = LP_MODE_POWER_SAVE;
+}
+
+static int link_policy_set_mode(link_policy_t *lp, lp_mode_t mode, uint32_t now_ms)
+{
+    if (lp->ops && lp->ops->set_mode && lp->ops->set_mode(lp->ops->ctx, mode) != 0)
+    {
+        lp->refused++;
+        return -1;
+    }
+    lp->mode = mode;
+    lp->mode_since_ms = now_ms;
+    lp->transitions++;
+    return 0;
+}
+
+int link_policy_activity(link_policy_t *lp, lp_source_t src, uint32_t now_ms)
+{
+    if (src < LP_SRC_NUM)
+        lp->activity[src]++;
+    lp->last_activity_ms = now_ms;
+    if (lp->mode == LP_MODE_ACTIVE)
+        return 0;
+    // refused: still in power save, the next activity asks again
+    return link_policy_set_mode(lp, LP_MODE_ACTIVE, now_ms) == 0;
+}
+
+uint32_t link_policy_poll(link_policy_t *lp, uint32_t now_ms)
+{
+    uint32_t idle;
+
+    if (lp->mode != LP_MODE_ACTIVE)
+        return 0;
+    idle = now_ms - lp->last_activity_ms;
+    if (idle >= lp->idle_ms)
+        return link_policy_set_mode(lp, LP_MODE_POWER_SAVE, now_ms) ? LINK_POLICY_RETRY_MS : 0;
+    return lp->idle_ms - idle;
+}
+
+int link_policy_reapply(link_policy_t *lp)
+{
+    if (lp->ops && lp->ops->set_mode)
+        return lp->ops->set_mode(lp->ops->ctx, lp->mode);
+    return 0;
+}
+
+/* The policy against a stub link on synthetic time. */
+typedef struct
+{
+    lp_mode_t   mode;
+    uint32_t    calls;
+    int         refuse;
+    int         failed;
+} lp_test_link_t;
+
+static int lp_test_set_mode(void *ctx, lp_mode_t mode)
+{
+    lp_test_link_t *l = ctx;
+
+    l->calls++;
+    if (l->refuse)
+        return -1;
+    l->mode = mode;
+    return 0;
+}
+
+static void lp_test_check(lp_test_link_t *l, int ok, const char *what)
+{
+    if (!ok)
+    {
+        rt_kprintf("link_policy: FAIL %s\n", what);
+        l->failed++;
+    }
+}
+
+static void link_policy_test(int argc, char **argv)
+{
+    lp_test_link_t l = {LP_MODE_POWER_SAVE, 0, 0, 0};
+    lp_ops_t ops = {lp_test_set_mode, &l};
+    link_policy_t lp;
+
+    link_policy_init(&lp, &ops, 1000);
+    lp_test_check(&l, link_policy_poll(&lp, 0) == 0, "idle link polls");
+    lp_test_check(&l, link_policy_activity(&lp, LP_SRC_UPLINK, 0) == 1 && l.mode == LP_MODE_ACTIVE,
+                  "activity activates");
+    lp_test_check(&l, link_policy_activity(&lp, LP_SRC_TTS, 100) == 0 && l.calls == 1,
+                  "active link asked again");
+    lp_test_check(&l, link_policy_poll(&lp, 500) == 600, "poll before idle");
+    lp_test_check(&l, link_policy_poll(&lp, 1100) == 0 && l.mode == LP_MODE_POWER_SAVE,
+                  "idle goes to power save");
+
+    // a refused request keeps the old mode and is asked for again
+    l.refuse = 1;
+    lp_test_check(&l, link_policy_activity(&lp, LP_SRC_RESPONSE, 2000) == 0 && lp.mode == LP_MODE_POWER_SAVE,
+                  "refused activation");
+    l.refuse = 0;
+    lp_test_check(&l, link_policy_activity(&lp, LP_SRC_RESPONSE, 2010) == 1 && l.mode == LP_MODE_ACTIVE,
+                  "activation retried");
+    l.refuse = 1;
+    lp_test_check(&l, link_policy_poll(&lp, 3010) == LINK_POLICY_RETRY_MS && lp.mode == LP_MODE_ACTIVE,
+                  "refused power save");
+    l.refuse = 0;
+    lp_test_check(&l, link_policy_poll(&lp, 3010 + LINK_POLICY_RETRY_MS) == 0 && l.mode == LP_MODE_POWER_SAVE,
+                  "power save retried");
+    lp_test_check(&l, lp.refused == 2 && lp.transitions == 4, "counters");
+
+    // the ms clock wraps
+    link_policy_activity(&lp, LP_SRC_UPLINK, 0xFFFFFE00);
+    lp_test_check(&l, link_policy_poll(&lp, 100) == 388, "poll across the wrap");
+    lp_test_check(&l, link_policy_poll(&lp, 0x3E8 - 0x200) == 0 && l.mode == LP_MODE_POWER_SAVE,
+                  "idle across the wrap");
+
+    // a new link gets the current mode
+    l.mode = LP_MODE_ACTIVE;
+    lp_test_check(&l, link_policy_reapply(&lp) == 0 && l.mode == LP_MODE_POWER_SAVE, "reapply");
+
+    if (!l.failed)
+        rt_kprintf("link_policy: PASS\n");
+}
+MSH_CMD_EXPORT(link_policy_test, link policy transitions against a stub link);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
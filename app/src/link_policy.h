@@ -0,0 +1,104 @@
+/**
+  ******************************************************************************
+  * @file   link_policy.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LINK_POLICY_H__
+#define __LINK_POLICY_H__
+
+#include <stdint.h>
+
+#define LINK_POLICY_RETRY_MS    100
+
+/* Pipeline stages that keep the Bluetooth link in active mode. */
+typedef enum
+{
+    LP_SRC_UPLINK,      // chat mic audio being appended
+    LP_SRC_RESPONSE,    // chat response requested or audio arriving
+    LP_SRC_TTS,         // tts playback
+    LP_SRC_NUM,
+} lp_source_t;
+
+typedef enum
+{
+    LP_MODE_POWER_SAVE,
+    LP_MODE_ACTIVE,
+} lp_mode_t;
+
+/* Link mode requests, implemented on top of bt_interface on the target and
+ * by a stub in link_policy_test. set_mode returns 0 once the request is
+ * taken, anything else leaves the policy in its old mode to ask again. */
+typedef struct
+{
+    int  (*set_mode)(void *ctx, lp_mode_t mode);
+    void *ctx;
+} lp_ops_t;
+
+typedef struct
+{
+    const lp_ops_t *ops;
+    uint32_t    idle_ms;
+    lp_mode_t   mode;
+    uint32_t    last_activity_ms;
+    uint32_t    mode_since_ms;
+    uint32_t    transitions;
+    uint32_t    refused;        // mode requests set_mode did not take
+    uint32_t    activity[LP_SRC_NUM];
+} link_policy_t;
+
+/* The policy itself has no OS dependency: time is passed in by the caller,
+ * which also owns the idle timer and serialises the calls. */
+void     link_policy_init(link_policy_t *lp, const lp_ops_t *ops, uint32_t idle_ms);
+/* Returns 1 if this activity switched the link to active mode, 0 when it
+ * already was or the request was refused. */
+int      link_policy_activity(link_policy_t *lp, lp_source_t src, uint32_t now_ms);
+/* Returns ms until the next poll is due, or 0 when no poll is needed. A
+ * refused switch to power save is retried after LINK_POLICY_RETRY_MS. */
+uint32_t link_policy_poll(link_policy_t *lp, uint32_t now_ms);
+/* Requests the current mode again, for a link that came up without it.
+ * Returns what set_mode returned. */
+int      link_policy_reapply(link_policy_t *lp);
+
+/* Report pipeline activity, provided by the BT application. */
+void link_policy_notify(lp_source_t src);
+
+#endif /* __LINK_POLICY_H__ */
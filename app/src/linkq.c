@@ -0,0 +1,321 @@
+/**
+  ******************************************************************************
+  * @file   linkq.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uplink.h"
+#include "pipeline.h"
+#include "linkq.h"
+
+#define LINKQ_MSS               1460    // the first ack waits for one segment to get through
+#define LINKQ_GOOD_RTT_MS       200
+#define LINKQ_JITTER_MAX_MS     PIPE_JITTER_MAX_MS
+#define LINKQ_BACKLOG_FRAMES    (2 * UPLINK_MAX_AGG)    // more than this is falling behind
+#define LINKQ_BAD_MS            3000    // sustained backlog before a reprobe
+#define LINKQ_SAMPLE_GAP_MS     500     // no samples this long, the run is over
+#define LINKQ_REPROBE_MS        60000   // a degraded profile tries to step back up
+
+// formats and wire bytes of a frame, as the pipeline profile allows them
+#if defined(PIPE_WIRE_ULAW)
+    #define LINKQ_WIRE          "g711_ulaw", "g711_ulaw", PIPE_ULAW_FRAME_BYTES
+#else
+    #define LINKQ_WIRE          "pcm16", "pcm16", PIPE_FRAME_BYTES
+#endif
+#if defined(PIPE_WIRE_PCM16)
+    #define LINKQ_POOR_WIRE     "pcm16", "pcm16", PIPE_FRAME_BYTES
+#else
+    #define LINKQ_POOR_WIRE     "g711_ulaw", "g711_ulaw", PIPE_ULAW_FRAME_BYTES
+#endif
+
+static const linkq_profile_t g_linkq_profiles[LINKQ_NUM] =
+{
+    [LINKQ_GOOD] = {"good", LINKQ_WIRE, PIPE_FRAMES(10), 0},
+    [LINKQ_FAIR] = {"fair", LINKQ_WIRE, PIPE_FRAMES(40), 120},
+    [LINKQ_POOR] = {"poor", LINKQ_POOR_WIRE, PIPE_FRAMES(80), 240},
+};
+
+PIPE_ASSERT(PIPE_FRAMES(80) <= UPLINK_MAX_AGG, poor_link_aggregation_fits);
+
+void linkq_init(linkq_t *q)
+{
+    memset(q, 0, sizeof(*q));
+    q->cls = LINKQ_GOOD;
+}
+
+const linkq_profile_t *linkq_profile(linkq_class_t cls)
+{
+    return &g_linkq_profiles[cls < LINKQ_NUM ? cls : LINKQ_POOR];
+}
+
+uint32_t linkq_need_kbps(const linkq_profile_t *p)
+{
+    // PIPE_FRAMES_PER_S frames a second, overhead shared by agg_min frames
+    return UPLINK_MSG_BYTES(p->frame_bytes, p->agg_min) * 8 * PIPE_FRAMES_PER_S / p->agg_min / 1000;
+}
+
+void linkq_probe_start(linkq_probe_t *p, uint32_t bytes, uint32_t sndbuf_size,
+                       uint32_t sndbuf_free, uint32_t now_ms)
+{
+    memset(p, 0, sizeof(*p));
+    p->bytes = bytes;
+    p->sndbuf_size = sndbuf_size;
+    p->last_free = sndbuf_free;
+    p->start_ms = now_ms;
+}
+
+int linkq_probe_poll(linkq_probe_t *p, uint32_t sndbuf_free, uint32_t now_ms)
+{
+    uint32_t ms = now_ms - p->start_ms;
+
+    if (!ms)
+        ms = 1;
+    if (!p->first_ack_ms && sndbuf_free > p->last_free)
+        p->first_ack_ms = ms;
+    p->last_free = sndbuf_free;
+    if (sndbuf_free >= p->sndbuf_size)
+    {
+        if (!p->first_ack_ms)
+            p->first_ack_ms = ms;
+        p->all_acked_ms = ms;
+        return 1;
+    }
+    return 0;
+}
+
+linkq_class_t linkq_probe_result(linkq_t *q, const linkq_probe_t *p, uint32_t now_ms)
+{
+    uint32_t first = p->first_ack_ms ? p->first_ack_ms : now_ms - p->start_ms;
+    uint32_t drain = p->all_acked_ms > first ? p->all_acked_ms - first : 0;
+    uint32_t kbps, rtt;
+
+    // after the first ack the rest of the burst drains at the bottleneck rate
+    if (!p->all_acked_ms)
+        kbps = p->bytes * 8 / (now_ms - p->start_ms + 1);   // timed out, a bound at best
+    else if (p->bytes > LINKQ_MSS)
+        kbps = (p->bytes - LINKQ_MSS) * 8 / (drain ? drain : 1);   // acked in one go: at least this fast
+    else
+        kbps = p->bytes * 8 / first;
+    rtt = kbps ? LINKQ_MSS * 8 / kbps : first;
+    rtt = first > rtt ? first - rtt : 1;
+    q->rtt_ms = rtt;
+    q->kbps = kbps;
+    // audio keeps at most half the send buffer in flight, one window per RTT
+    if (kbps > p->sndbuf_size / 2 * 8 / rtt)
+        kbps = p->sndbuf_size / 2 * 8 / rtt;
+    // both directions share the air time, full duplex audio needs twice the uplink
+    if (kbps >= 2 * linkq_need_kbps(linkq_profile(LINKQ_GOOD)) && rtt <= LINKQ_GOOD_RTT_MS)
+        q->cls = LINKQ_GOOD;
+    else if (kbps * 2 >= 3 * linkq_need_kbps(linkq_profile(LINKQ_FAIR)))
+        q->cls = LINKQ_FAIR;
+    else
+        q->cls = LINKQ_POOR;
+    q->jitter_ms = linkq_profile(q->cls)->jitter_ms + (q->cls == LINKQ_GOOD ? 0 : rtt / 2);
+    if (q->jitter_ms > LINKQ_JITTER_MAX_MS)
+        q->jitter_ms = LINKQ_JITTER_MAX_MS;
+    q->probe_ms = now_ms;
+    q->reprobe = 0;
+    q->bad_since_ms = 0;
+    q->probes++;
+    return q->cls;
+}
+
+void linkq_uplink(linkq_t *q, uint32_t backlog_frames, uint32_t drops, uint32_t now_ms)
+{
+    int bad = backlog_frames > LINKQ_BACKLOG_FRAMES || drops != q->last_drops;
+
+    if (now_ms - q->last_sample_ms > LINKQ_SAMPLE_GAP_MS)
+        q->bad_since_ms = 0;
+    q->last_sample_ms = now_ms;
+    q->last_drops = drops;
+    if (!bad)
+    {
+        q->bad_since_ms = 0;
+        return;
+    }
+    if (!q->bad_since_ms)
+        q->bad_since_ms = now_ms ? now_ms : 1;
+    else if (!q->reprobe && now_ms - q->bad_since_ms >= LINKQ_BAD_MS)
+    {
+        q->reprobe = 1;
+        q->degraded++;
+    }
+}
+
+int linkq_reprobe_due(const linkq_t *q, uint32_t now_ms)
+{
+    return q->reprobe || (q->cls != LINKQ_GOOD && now_ms - q->probe_ms >= LINKQ_REPROBE_MS);
+}
+
+/*
+ * Stand-in for the server end of a shaped link: segments leave the send
+ * buffer at kbps, each is acked one RTT after it is through the bottleneck.
+ * The probe runs against it exactly as on the socket, then the chosen
+ * profile's uplink runs for a while at the same rate.
+ */
+#define LINKQ_SIM_MSS           1460
+#define LINKQ_SIM_SNDBUF        12288
+#define LINKQ_SIM_MAX_RTT       512
+#define LINKQ_SIM_PROBE_BYTES   (3 * UPLINK_MSG_BYTES(PIPE_FRAME_BYTES, UPLINK_MAX_AGG))
+
+typedef struct
+{
+    uint32_t    kbps;
+    uint32_t    rtt_ms;
+    uint32_t    queued;         // written, not yet through the bottleneck
+    uint32_t    in_flight[LINKQ_SIM_MAX_RTT];   // bytes through the bottleneck per ms, acked rtt later
+    uint32_t    used;           // send buffer occupied, unacked
+    uint32_t    credit;         // bottleneck bits carried between ms steps
+} linkq_sim_link_t;
+
+static void linkq_sim_step(linkq_sim_link_t *l, uint32_t now_ms)
+{
+    uint32_t slot = now_ms % LINKQ_SIM_MAX_RTT, out;
+
+    // acks for what went through rtt ago
+    l->used -= l->in_flight[slot];
+    l->in_flight[slot] = 0;
+    l->credit += l->kbps;               // bits per ms
+    out = l->credit / 8;
+    if (out > l->queued)
+        out = l->queued;
+    out = out / LINKQ_SIM_MSS * LINKQ_SIM_MSS + (out == l->queued ? out % LINKQ_SIM_MSS : 0);
+    l->credit -= out * 8;
+    if (l->credit > 8 * LINKQ_SIM_MSS)
+        l->credit = 8 * LINKQ_SIM_MSS;
+    l->queued -= out;
+    l->in_flight[(slot + l->rtt_ms) % LINKQ_SIM_MAX_RTT] += out;
+}
+
+static linkq_class_t linkq_sim_probe(linkq_t *q, uint32_t kbps, uint32_t rtt_ms)
+{
+    linkq_sim_link_t l = {0};
+    linkq_probe_t p;
+    uint32_t ms;
+
+    l.kbps = kbps;
+    l.rtt_ms = rtt_ms < LINKQ_SIM_MAX_RTT ? rtt_ms : LINKQ_SIM_MAX_RTT - 1;
+    l.queued = l.used = LINKQ_SIM_PROBE_BYTES;
+    linkq_probe_start(&p, LINKQ_SIM_PROBE_BYTES, LINKQ_SIM_SNDBUF, LINKQ_SIM_SNDBUF - l.used, 0);
+    for (ms = 1; ms <= 2000; ms++)
+    {
+        linkq_sim_step(&l, ms);
+        if (ms % 5 == 0 && linkq_probe_poll(&p, LINKQ_SIM_SNDBUF - l.used, ms))
+            break;
+    }
+    return linkq_probe_result(q, &p, ms);
+}
+
+/* Runs the profile's uplink for seconds, returns mic frames dropped. */
+static uint32_t linkq_sim_uplink(linkq_t *q, uint32_t kbps, uint32_t rtt_ms, uint32_t seconds,
+                                 uint32_t *reprobe_ms)
+{
+    const linkq_profile_t *prof = linkq_profile(q->cls);
+    linkq_sim_link_t l = {0};
+    uplink_ctrl_t u;
+    uint32_t backlog = 0, drops = 0, ms, n;
+
+    l.kbps = kbps;
+    l.rtt_ms = rtt_ms < LINKQ_SIM_MAX_RTT ? rtt_ms : LINKQ_SIM_MAX_RTT - 1;
+    uplink_ctrl_init(&u, prof->frame_bytes, LINKQ_SIM_SNDBUF);
+    uplink_ctrl_config(&u, prof->frame_bytes, prof->agg_min);
+    *reprobe_ms = 0;
+    for (ms = 1; ms <= seconds * 1000; ms++)
+    {
+        linkq_sim_step(&l, ms);
+        if (ms % PIPE_FRAME_MS)
+            continue;
+        if (backlog < PIPE_MIC_RING / PIPE_FRAME_BYTES)     // the chat mic ring
+            backlog++;
+        else
+            drops++;
+        while ((n = uplink_ctrl_next(&u, backlog, LINKQ_SIM_SNDBUF - l.used, 0)) != 0)
+        {
+            l.used += UPLINK_MSG_BYTES(prof->frame_bytes, n);
+            l.queued += UPLINK_MSG_BYTES(prof->frame_bytes, n);
+            uplink_ctrl_result(&u, n, 0);
+            backlog -= n;
+        }
+        linkq_uplink(q, backlog, drops, ms);
+        if (!*reprobe_ms && q->reprobe)
+            *reprobe_ms = ms;
+    }
+    return drops;
+}
+
+static void linkq_sim(int argc, char **argv)
+{
+    static const uint16_t rates[] = {96, 160, 256, 400, 600, 1000, 2000};
+    static const uint16_t rtts[] = {20, 150, 400};
+    uint32_t i, j, drops, reprobe_ms;
+    linkq_t q;
+
+    rt_kprintf("profiles need: good %d, fair %d, poor %d kbps uplink\n",
+               linkq_need_kbps(linkq_profile(LINKQ_GOOD)), linkq_need_kbps(linkq_profile(LINKQ_FAIR)),
+               linkq_need_kbps(linkq_profile(LINKQ_POOR)));
+    rt_kprintf("link kbps/rtt  probe kbps/rtt  profile jitter  drops/10s  reprobe\n");
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        for (j = 0; j < sizeof(rtts) / sizeof(rtts[0]); j++)
+        {
+            linkq_init(&q);
+            linkq_sim_probe(&q, rates[i], rtts[j]);
+            drops = linkq_sim_uplink(&q, rates[i], rtts[j], 10, &reprobe_ms);
+            rt_kprintf("%9d/%-4d %10d/%-4d %-7s %6d %10d %8d\n", rates[i], rtts[j], q.kbps, q.rtt_ms,
+                       linkq_profile(q.cls)->name, q.jitter_ms, drops, reprobe_ms);
+        }
+    }
+    // the link sinks under a good profile: the backlog must ask for a probe
+    linkq_init(&q);
+    linkq_sim_probe(&q, 2000, 20);
+    drops = linkq_sim_uplink(&q, 200, 20, 10, &reprobe_ms);
+    rt_kprintf("2000 -> 200 kbps under %s: %d drops, reprobe after %d ms, ",
+               linkq_profile(q.cls)->name, drops, reprobe_ms);
+    linkq_sim_probe(&q, 200, 20);
+    drops = linkq_sim_uplink(&q, 200, 20, 10, &reprobe_ms);
+    rt_kprintf("then %s with %d drops\n", linkq_profile(q.cls)->name, drops);
+}
+MSH_CMD_EXPORT(linkq_sim, link probe and profile choice against shaped links);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
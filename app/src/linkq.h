@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file   linkq.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LINKQ_H__
+#define __LINKQ_H__
+
+#include <stdint.h>
+
+/*
+ * Link quality: a short probe at session start measures RTT and throughput
+ * over the session's own socket, and a profile is picked from the result.
+ * While audio flows the uplink backlog is watched, and a sustained backlog
+ * or a degraded profile asks for another probe.
+ */
+typedef enum
+{
+    LINKQ_GOOD,
+    LINKQ_FAIR,
+    LINKQ_POOR,
+    LINKQ_NUM,
+} linkq_class_t;
+
+typedef struct
+{
+    const char  *name;
+    const char  *in_format;     // session input_audio_format
+    const char  *out_format;    // session output_audio_format
+    uint16_t    frame_bytes;    // wire bytes of a PIPE_FRAME_MS mic frame
+    uint8_t     agg_min;        // mic frames per append message at least
+    uint16_t    jitter_ms;      // answer audio held before playback starts, plus RTT/2
+} linkq_profile_t;
+
+/* Probe: time the acks of a burst written into an idle send buffer. */
+typedef struct
+{
+    uint32_t    bytes;
+    uint32_t    sndbuf_size;
+    uint32_t    last_free;
+    uint32_t    start_ms;
+    uint32_t    first_ack_ms;   // 0 until the first ack
+    uint32_t    all_acked_ms;
+} linkq_probe_t;
+
+typedef struct
+{
+    linkq_class_t   cls;
+    uint32_t        rtt_ms;
+    uint32_t        kbps;
+    uint16_t        jitter_ms;
+    uint8_t         reprobe;        // backlog stayed high, probe again when idle
+    uint32_t        probe_ms;       // time of the last probe
+    uint32_t        last_sample_ms;
+    uint32_t        bad_since_ms;   // 0 while the uplink keeps up
+    uint32_t        last_drops;
+    uint32_t        probes;
+    uint32_t        degraded;
+} linkq_t;
+
+/* The estimator has no OS dependency, time is passed in by the caller. */
+void     linkq_init(linkq_t *q);
+const linkq_profile_t *linkq_profile(linkq_class_t cls);
+/* Uplink kbps the profile needs at its least aggregation. */
+uint32_t linkq_need_kbps(const linkq_profile_t *p);
+
+void     linkq_probe_start(linkq_probe_t *p, uint32_t bytes, uint32_t sndbuf_size,
+                           uint32_t sndbuf_free, uint32_t now_ms);
+/* Returns 1 once everything written is acked. */
+int      linkq_probe_poll(linkq_probe_t *p, uint32_t sndbuf_free, uint32_t now_ms);
+/* Classifies a finished or timed out probe, returns the new class. */
+linkq_class_t linkq_probe_result(linkq_t *q, const linkq_probe_t *p, uint32_t now_ms);
+
+/* Uplink sample on every pump: backlog in frames and the ring drop count. */
+void     linkq_uplink(linkq_t *q, uint32_t backlog_frames, uint32_t drops, uint32_t now_ms);
+int      linkq_reprobe_due(const linkq_t *q, uint32_t now_ms);
+
+#endif /* __LINKQ_H__ */
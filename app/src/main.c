@@ -68,27 +68,145 @@ void HAL_MspInit(void)
 #include "bt_connection_manager.h"
 
 #include "ulog.h"
+#include "lwip/netif.h"
+#include "reconnect.h"
+#include "link_policy.h"
+#include "boot.h"
+#include "chat.h"
+#include "ui.h"
+#include "prompt.h"
+#include "stats.h"
+#include "mixer.h"
 
 
-#define BT_APP_READY 1
-
-#define BT_APP_CONNECT_PAN  1
+#define BT_APP_CONNECT_PAN  2
 #define PAN_TIMER_MS        1000
+#define ACL_RETRY_DELAY_MS  3000
+#define IP_POLL_MS          100
+#define BT_APP_LINK_ACTIVE      3
+#define BT_APP_LINK_POWER_SAVE  4
+
+#ifndef VOLC_LINK_IDLE_MS
+    #define VOLC_LINK_IDLE_MS   2000
+#endif
 
 typedef struct
 {
     BOOL bt_connected;
+    BOOL has_last_addr;
     bt_notify_device_mac_t bd_addr;
-    rt_timer_t pan_connect_timer;
+    bt_notify_device_mac_t last_addr;
 } bt_app_t;
 static bt_app_t g_bt_app_env;
 static rt_mailbox_t g_bt_app_mb;
+static rt_sem_t g_bt_ready;
 
-void bt_app_connect_pan_timeout_handle(void *parameter)
+static link_policy_t g_link_policy;
+static rt_timer_t g_link_idle_timer;
+static rt_tick_t g_link_request_tick;
+
+static void bt_app_request_pan(void)
 {
-    if ((g_bt_app_mb != NULL) && (g_bt_app_env.bt_connected))
+    if ((g_bt_app_mb != NULL) && (g_bt_app_env.bt_connected || g_bt_app_env.has_last_addr))
         rt_mb_send(g_bt_app_mb, BT_APP_CONNECT_PAN);
-    return;
+}
+
+/* ACL and PAN are both recovered by connecting the PAN profile: when the
+ * ACL is gone, the connect pages the last device first. */
+static rt_err_t bt_app_reconnect_action(reconn_layer_t layer)
+{
+    if (!g_bt_app_env.bt_connected && !g_bt_app_env.has_last_addr)
+        return -RT_ERROR;
+    bt_app_request_pan();
+    return RT_EOK;
+}
+
+static uint32_t bt_app_now_ms(void)
+{
+    return rt_tick_get() * 1000 / RT_TICK_PER_SECOND;
+}
+
+/* Called with interrupts disabled, the mode is applied by the main thread.
+ * A full mailbox refuses the request and the policy keeps its old mode. */
+static int bt_app_link_set_mode(void *ctx, lp_mode_t mode)
+{
+    rt_err_t err = rt_mb_send(g_bt_app_mb, mode == LP_MODE_ACTIVE ? BT_APP_LINK_ACTIVE : BT_APP_LINK_POWER_SAVE);
+
+    if (err == RT_EOK)
+        g_link_request_tick = rt_tick_get();
+    return err;
+}
+
+static const lp_ops_t g_link_policy_ops =
+{
+    .set_mode = bt_app_link_set_mode,
+};
+
+static void bt_app_link_idle_timeout(void *parameter)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    uint32_t next = link_policy_poll(&g_link_policy, bt_app_now_ms());
+    rt_hw_interrupt_enable(level);
+
+    if (next)
+    {
+        rt_tick_t tick = rt_tick_from_millisecond(next);
+        rt_timer_control(g_link_idle_timer, RT_TIMER_CTRL_SET_TIME, &tick);
+        rt_timer_start(g_link_idle_timer);
+    }
+}
+
+void link_policy_notify(lp_source_t src)
+{
+    if (!g_link_idle_timer)
+        return;
+
+    rt_base_t level = rt_hw_interrupt_disable();
+    int activated = link_policy_activity(&g_link_policy, src, bt_app_now_ms());
+    rt_hw_interrupt_enable(level);
+
+    if (activated)
+    {
+        rt_tick_t tick = rt_tick_from_millisecond(g_link_policy.idle_ms);
+        rt_timer_control(g_link_idle_timer, RT_TIMER_CTRL_SET_TIME, &tick);
+        rt_timer_start(g_link_idle_timer);
+    }
+}
+
+static void bt_app_link_apply(uint32_t value)
+{
+    uint32_t delay_ms = (rt_tick_get() - g_link_request_tick) * 1000 / RT_TICK_PER_SECOND;
+    rt_tick_t start = rt_tick_get();
+
+    if (!g_bt_app_env.bt_connected)
+        return;
+    if (value == BT_APP_LINK_ACTIVE)
+    {
+        bt_interface_set_sniff_enable(FALSE);
+        bt_interface_exit_sniff_mode((unsigned char *)&g_bt_app_env.bd_addr);
+    }
+    else
+    {
+        bt_interface_set_sniff_enable(TRUE);
+    }
+    LOG_I("link %s: queued %d ms, applied in %d ms, %d transitions, %d refused",
+          value == BT_APP_LINK_ACTIVE ? "active" : "power save", delay_ms,
+          (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND, g_link_policy.transitions,
+          g_link_policy.refused);
+}
+
+/* IP comes up on its own once PAN is connected, just poll the interface,
+ * every IP_POLL_MS rather than with the supervisor's backoff. */
+static rt_err_t bt_app_ip_probe(reconn_layer_t layer)
+{
+    struct netif *netif = netif_default;
+
+    if (netif && netif_is_up(netif) && !ip4_addr_isany_val(*netif_ip4_addr(netif)))
+    {
+        reconnect_notify_up(RECONN_LAYER_IP);
+        return RT_EOK;
+    }
+    return -RT_ERROR;
 }
 
 
@@ -97,7 +215,8 @@ void bt_app_connect_pan_timeout_handle(void *parameter)
 #include "dfs_posix.h"
 #include "drv_flash.h"
 #define NAND_MTD_NAME    "root"
-int mnt_init(void)
+/* Boot step: mount the root file system, formatting it on first use. */
+static void boot_fs(void)
 {
     //TODO: how to get base address
     register_nand_device(FS_REGION_START_ADDR & (0xFC000000), FS_REGION_START_ADDR - (FS_REGION_START_ADDR & (0xFC000000)), FS_REGION_SIZE, NAND_MTD_NAME);
@@ -120,9 +239,11 @@ int mnt_init(void)
         else
             rt_kprintf("dfs_mkfs elm flash fail\n");
     }
-    return RT_EOK;
 }
-INIT_ENV_EXPORT(mnt_init);
+#else
+static void boot_fs(void)
+{
+}
 #endif
 
 
@@ -136,7 +257,8 @@ static int bt_app_interface_event_handle(uint16_t type, uint16_t event_id, uint8
         {
         case BT_NOTIFY_COMMON_BT_STACK_READY:
         {
-            rt_mb_send(g_bt_app_mb, BT_APP_READY);
+            boot_mark("bt_ready");
+            rt_sem_release(g_bt_ready);
         }
         break;
         case BT_NOTIFY_COMMON_ACL_DISCONNECTED:
@@ -147,9 +269,7 @@ static int bt_app_interface_event_handle(uint16_t type, uint16_t event_id, uint8
                   info->mac.addr[1], info->mac.addr[0], info->res);
             g_bt_app_env.bt_connected = FALSE;
             memset(&g_bt_app_env.bd_addr, 0xFF, sizeof(g_bt_app_env.bd_addr));
-
-            if (g_bt_app_env.pan_connect_timer)
-                rt_timer_stop(g_bt_app_env.pan_connect_timer);
+            reconnect_notify_down(RECONN_LAYER_ACL);
         }
         break;
         case BT_NOTIFY_COMMON_ENCRYPTION:
@@ -177,18 +297,25 @@ static int bt_app_interface_event_handle(uint16_t type, uint16_t event_id, uint8
 
         if (pan_conn)
         {
+            rt_base_t level;
+            int err;
+
             LOG_I("bd addr 0x%.2x:%.2x:%.2x:%.2x:%.2x:%.2x\n", g_bt_app_env.bd_addr.addr[5],
                   g_bt_app_env.bd_addr.addr[4], g_bt_app_env.bd_addr.addr[3],
                   g_bt_app_env.bd_addr.addr[2], g_bt_app_env.bd_addr.addr[1],
                   g_bt_app_env.bd_addr.addr[0]);
             g_bt_app_env.bt_connected = TRUE;
-            // Trigger PAN connection after PAN_TIMER_MS period to avoid SDP confliction.
-            if (!g_bt_app_env.pan_connect_timer)
-                g_bt_app_env.pan_connect_timer = rt_timer_create("connect_pan", bt_app_connect_pan_timeout_handle, (void *)&g_bt_app_env,
-                                                 rt_tick_from_millisecond(PAN_TIMER_MS), RT_TIMER_FLAG_SOFT_TIMER);
-            else
-                rt_timer_stop(g_bt_app_env.pan_connect_timer);
-            rt_timer_start(g_bt_app_env.pan_connect_timer);
+            g_bt_app_env.last_addr = g_bt_app_env.bd_addr;
+            g_bt_app_env.has_last_addr = TRUE;
+            // The supervisor connects PAN after PAN_TIMER_MS to avoid SDP confliction.
+            reconnect_notify_up(RECONN_LAYER_ACL);
+            // a new ACL starts with the default sniff policy, and modes
+            // requested while it was down were dropped: apply ours again
+            level = rt_hw_interrupt_disable();
+            err = link_policy_reapply(&g_link_policy);
+            rt_hw_interrupt_enable(level);
+            if (err)
+                LOG_W("link mode not reapplied: %d", err);
         }
     }
     else if (type == BT_NOTIFY_PAN)
@@ -198,11 +325,13 @@ static int bt_app_interface_event_handle(uint16_t type, uint16_t event_id, uint8
         case BT_NOTIFY_PAN_PROFILE_CONNECTED:
         {
             LOG_I("pan connect successed \n");
+            reconnect_notify_up(RECONN_LAYER_PAN);
         }
         break;
         case BT_NOTIFY_PAN_PROFILE_DISCONNECTED:
         {
             LOG_I("pan disconnect with remote device\n");
+            reconnect_notify_down(RECONN_LAYER_PAN);
         }
         break;
         default:
@@ -220,45 +349,108 @@ uint32_t bt_get_class_of_device()
 }
 
 
-/**
-  * @brief  Main program
-  * @param  None
-  * @retval 0 if success, otherwise failure number
-  */
 #ifdef BT_DEVICE_NAME
     static const char *local_name = BT_DEVICE_NAME;
 #else
     static const char *local_name = "sifli_pan";
 #endif
 
+/* Boot step: enable the stack and wait for stack/profile ready. */
+static void boot_bt(void)
+{
+    sifli_ble_enable();
+    if (RT_EOK == rt_sem_take(g_bt_ready, 8000))
+        LOG_I("BT/BLE stack and profile ready");
+    else
+        LOG_I("BT/BLE stack and profile init failed");
+
+    // Update Bluetooth name
+    bt_interface_set_local_name(strlen(local_name), (void *)local_name);
+}
+
+static void boot_chat(void)
+{
+    chat_prepare();
+}
+
+static void boot_ui(void)
+{
+    ui_init();
+}
+
+static void boot_prompt(void)
+{
+    prompt_init();
+}
+
+enum
+{
+    BOOT_STEP_BT,
+    BOOT_STEP_FS,
+    BOOT_STEP_CHAT,
+    BOOT_STEP_UI,
+    BOOT_STEP_PROMPT,
+    BOOT_STEP_NUM
+};
+
+static const boot_step_t g_boot_steps[BOOT_STEP_NUM] =
+{
+    [BOOT_STEP_BT]      = {"bt", boot_bt, 0},
+    [BOOT_STEP_FS]      = {"fs", boot_fs, 0},
+    [BOOT_STEP_CHAT]    = {"chat", boot_chat, 0},
+    // both read their assets from the file system
+    [BOOT_STEP_UI]      = {"ui", boot_ui, BOOT_DEP(BOOT_STEP_FS)},
+    [BOOT_STEP_PROMPT]  = {"prompt", boot_prompt, BOOT_DEP(BOOT_STEP_FS)},
+};
+
+/**
+  * @brief  Main program
+  * @param  None
+  * @retval 0 if success, otherwise failure number
+  */
 int main(void)
 {
     g_bt_app_mb = rt_mb_create("bt_app", 8, RT_IPC_FLAG_FIFO);
+    g_bt_ready = rt_sem_create("bt_ready", 0, RT_IPC_FLAG_FIFO);
+    RT_ASSERT(g_bt_app_mb && g_bt_ready);
 #ifdef BSP_BT_CONNECTION_MANAGER
     bt_cm_set_profile_target(BT_CM_PAN, BT_SLAVE_ROLE, 1);
 #endif // BSP_BT_CONNECTION_MANAGER
 
+    reconnect_init();
+    reconnect_register(RECONN_LAYER_ACL, bt_app_reconnect_action, ACL_RETRY_DELAY_MS);
+    reconnect_register(RECONN_LAYER_PAN, bt_app_reconnect_action, PAN_TIMER_MS);
+    reconnect_set_poll(RECONN_LAYER_IP, IP_POLL_MS);
+    reconnect_register(RECONN_LAYER_IP, bt_app_ip_probe, 0);
+
+    link_policy_init(&g_link_policy, &g_link_policy_ops, VOLC_LINK_IDLE_MS);
+    g_link_idle_timer = rt_timer_create("link_idle", bt_app_link_idle_timeout, NULL,
+                                        rt_tick_from_millisecond(VOLC_LINK_IDLE_MS),
+                                        RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+    RT_ASSERT(g_link_idle_timer);
+    stats_init();
+    mixer_init();
+
     bt_interface_register_bt_event_notify_callback(bt_app_interface_event_handle);
 
-    sifli_ble_enable();
+    // Stack bring-up, file system and the voice pipeline overlap, see boot_stat.
+    boot_start(g_boot_steps, BOOT_STEP_NUM);
+
+    uint32_t value;
     while (1)
     {
-        uint32_t value;
-        // Wait for stack/profile ready.
-        if (RT_EOK == rt_mb_recv(g_bt_app_mb, (rt_uint32_t *)&value, 8000) && value == BT_APP_READY)
-            LOG_I("BT/BLE stack and profile ready");
-        else
-            LOG_I("BT/BLE stack and profile init failed");
-
-        // Update Bluetooth name
-        bt_interface_set_local_name(strlen(local_name), (void *)local_name);
-
         // handle pan connect event
         rt_mb_recv(g_bt_app_mb, (rt_uint32_t *)&value, RT_WAITING_FOREVER);
         if (value == BT_APP_CONNECT_PAN)
         {
             if (g_bt_app_env.bt_connected)
                 bt_interface_conn_ext((char *)&g_bt_app_env.bd_addr, BT_PROFILE_PAN);
+            else if (g_bt_app_env.has_last_addr)
+                bt_interface_conn_ext((char *)&g_bt_app_env.last_addr, BT_PROFILE_PAN);
+        }
+        else if (value == BT_APP_LINK_ACTIVE || value == BT_APP_LINK_POWER_SAVE)
+        {
+            bt_app_link_apply(value);
         }
     }
     return 0;
@@ -276,7 +468,7 @@ static void pan_cmd(int argc, char **argv)
     }
     // only valid after connection setup but phone didn't enable pernal hop
     else if (strcmp(argv[1], "conn_pan") == 0)
-        bt_app_connect_pan_timeout_handle(NULL);
+        bt_app_request_pan();
 }
 MSH_CMD_EXPORT(pan_cmd, Connect PAN to last paired device);
 
@@ -0,0 +1,703 @@
+/**
+  ******************************************************************************
+  * @file   mic_pre.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mic_pre.h"
+#include "cycle_counter.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    #define MIC_PRE_DSP     1
+#endif
+
+#define MIC_PRE_CPLX        (MIC_PRE_FFT / 2)   // complex points of the packed transform
+#define MIC_PRE_HPF_HZ      100.0f
+#define MIC_PRE_PI          3.14159265358979f
+
+#define MIC_PRE_WARMUP      16          // hops averaged into the first noise estimate
+#define MIC_PRE_OVER        40          // noise over-subtraction, Q4
+#define MIC_PRE_GAIN_MIN    4915        // -16.5 dB, Q15
+#define MIC_PRE_GAIN_MAX    32767
+
+#define MIC_PRE_AGC_TARGET  3000        // speech rms, about -21 dBFS
+#define MIC_PRE_AGC_MAX     (8 << 12)   // +18 dB
+#define MIC_PRE_AGC_MIN     (1 << 11)   // -6 dB
+#define MIC_PRE_AGC_PEAK    29000
+#define MIC_PRE_AGC_QUIET   64          // rms below this is never speech
+
+/* Tables shared by all instances. */
+static int16_t  g_win[MIC_PRE_WIN];                 // sine window, Q15
+static uint32_t g_tw_fwd[MIC_PRE_CPLX / 2];         // packed cos, -sin
+static uint32_t g_tw_inv[MIC_PRE_CPLX / 2];         // packed cos, sin
+static int16_t  g_split_cos[MIC_PRE_CPLX / 2 + 1];
+static int16_t  g_split_sin[MIC_PRE_CPLX / 2 + 1];
+static uint8_t  g_bitrev[MIC_PRE_CPLX];
+static int32_t  g_hpf_b0, g_hpf_a1, g_hpf_a2;       // Q28, b1 = -2 b0, b2 = b0
+static uint8_t  g_tables_ready;
+
+static void mic_pre_tables(void)
+{
+    float k, norm;
+    int i, j, b;
+
+    if (g_tables_ready)
+        return;
+    for (i = 0; i < MIC_PRE_WIN; i++)
+        g_win[i] = (int16_t)lrintf(32767.0f * sinf(MIC_PRE_PI * (i + 0.5f) / MIC_PRE_WIN));
+    for (i = 0; i < MIC_PRE_CPLX / 2; i++)
+    {
+        int32_t c = lrintf(32767.0f * cosf(2 * MIC_PRE_PI * i / MIC_PRE_CPLX));
+        int32_t s = lrintf(32767.0f * sinf(2 * MIC_PRE_PI * i / MIC_PRE_CPLX));
+        g_tw_fwd[i] = ((uint32_t)c & 0xFFFF) | ((uint32_t)-s << 16);
+        g_tw_inv[i] = ((uint32_t)c & 0xFFFF) | ((uint32_t)s << 16);
+    }
+    for (i = 0; i <= MIC_PRE_CPLX / 2; i++)
+    {
+        g_split_cos[i] = (int16_t)lrintf(32767.0f * cosf(2 * MIC_PRE_PI * i / MIC_PRE_FFT));
+        g_split_sin[i] = (int16_t)lrintf(32767.0f * sinf(2 * MIC_PRE_PI * i / MIC_PRE_FFT));
+    }
+    for (i = 0; i < MIC_PRE_CPLX; i++)
+    {
+        for (j = 0, b = 1; b < MIC_PRE_CPLX; b <<= 1)
+            j = (j << 1) | ((i & b) ? 1 : 0);
+        g_bitrev[i] = (uint8_t)j;
+    }
+    // second order Butterworth high-pass
+    k = tanf(MIC_PRE_PI * MIC_PRE_HPF_HZ / 16000.0f);
+    norm = 1.0f / (1.0f + 1.41421356f * k + k * k);
+    g_hpf_b0 = lrintf(norm * (1 << 28));
+    g_hpf_a1 = lrintf(2.0f * (k * k - 1.0f) * norm * (1 << 28));
+    g_hpf_a2 = lrintf((1.0f - 1.41421356f * k + k * k) * norm * (1 << 28));
+    g_tables_ready = 1;
+}
+
+static inline int16_t mic_pre_lo(uint32_t v)
+{
+    return (int16_t)v;
+}
+
+static inline int16_t mic_pre_hi(uint32_t v)
+{
+    return (int16_t)(v >> 16);
+}
+
+static inline uint32_t mic_pre_pack(int32_t lo, int32_t hi)
+{
+    return ((uint32_t)lo & 0xFFFF) | ((uint32_t)hi << 16);
+}
+
+static inline int16_t mic_pre_sat16(int32_t v)
+{
+#ifdef MIC_PRE_DSP
+    return (int16_t)__SSAT(v, 16);
+#else
+    return (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+#endif
+}
+
+static inline int mic_pre_bitlen(uint32_t v)
+{
+#ifdef MIC_PRE_DSP
+    return 32 - __CLZ(v);
+#else
+    int n = 0;
+    while (v)
+    {
+        n++;
+        v >>= 1;
+    }
+    return n;
+#endif
+}
+
+/* Lanes go out of +-2^13 when bits 14 or 15 of lane + 2^13 are set. The
+ * carry out of the low lane can only flag a high lane at the edge,
+ * which costs one needless halving. */
+#define MIC_PRE_RANGE_BIAS  0x20002000u
+#define MIC_PRE_RANGE_MASK  0xC000C000u
+
+/* Radix-2 butterflies on packed complex Q15, both builds give the same
+ * bits. The halving one keeps a stage that could overflow in range:
+ * a' = (a + b w) / 2, b' = (a - b w) / 2. Both return the range bits
+ * of the outputs. */
+static inline uint32_t mic_pre_butterfly_half(uint32_t *pa, uint32_t *pb, uint32_t w)
+{
+    uint32_t a = *pa, b = *pb;
+#ifdef MIC_PRE_DSP
+    uint32_t t = __PKHBT((uint32_t)((int32_t)__SMUSD(b, w) >> 16), __SMUADX(b, w), 0);
+    uint32_t h = __SHADD16(a, 0);
+
+    *pa = __QADD16(h, t);
+    *pb = __QSUB16(h, t);
+    return (*pa + MIC_PRE_RANGE_BIAS) | (*pb + MIC_PRE_RANGE_BIAS);
+#else
+    int32_t br = mic_pre_lo(b), bi = mic_pre_hi(b), wr = mic_pre_lo(w), wi = mic_pre_hi(w);
+    int32_t tr = (br * wr - bi * wi) >> 16, ti = (br * wi + bi * wr) >> 16;
+    int32_t hr = mic_pre_lo(a) >> 1, hi = mic_pre_hi(a) >> 1;
+
+    *pa = mic_pre_pack(mic_pre_sat16(hr + tr), mic_pre_sat16(hi + ti));
+    *pb = mic_pre_pack(mic_pre_sat16(hr - tr), mic_pre_sat16(hi - ti));
+    return (*pa + MIC_PRE_RANGE_BIAS) | (*pb + MIC_PRE_RANGE_BIAS);
+#endif
+}
+
+static inline uint32_t mic_pre_butterfly(uint32_t *pa, uint32_t *pb, uint32_t w)
+{
+    uint32_t a = *pa, b = *pb;
+#ifdef MIC_PRE_DSP
+    uint32_t t = __PKHBT((uint32_t)((int32_t)__SMUSD(b, w) >> 15), (uint32_t)((int32_t)__SMUADX(b, w) >> 15), 16);
+
+    *pa = __QADD16(a, t);
+    *pb = __QSUB16(a, t);
+    return (*pa + MIC_PRE_RANGE_BIAS) | (*pb + MIC_PRE_RANGE_BIAS);
+#else
+    int32_t br = mic_pre_lo(b), bi = mic_pre_hi(b), wr = mic_pre_lo(w), wi = mic_pre_hi(w);
+    int32_t tr = (int16_t)((br * wr - bi * wi) >> 15), ti = (int16_t)((br * wi + bi * wr) >> 15);
+    int32_t ar = mic_pre_lo(a), ai = mic_pre_hi(a);
+
+    *pa = mic_pre_pack(mic_pre_sat16(ar + tr), mic_pre_sat16(ai + ti));
+    *pb = mic_pre_pack(mic_pre_sat16(ar - tr), mic_pre_sat16(ai - ti));
+    return (*pa + MIC_PRE_RANGE_BIAS) | (*pb + MIC_PRE_RANGE_BIAS);
+#endif
+}
+
+/* In place complex transform of MIC_PRE_CPLX points in block floating
+ * point: a stage halves only when its input could overflow. Returns the
+ * number of halvings, the result is the transform over 2^halvings. */
+static int mic_pre_fft(uint32_t *z, const uint32_t *tw)
+{
+    uint32_t i, j, len, half, step, t, range = 0;
+    int halvings = 0;
+
+    for (i = 0; i < MIC_PRE_CPLX; i++)
+    {
+        j = g_bitrev[i];
+        if (i < j)
+        {
+            t = z[i];
+            z[i] = z[j];
+            z[j] = t;
+        }
+        range |= z[i] + MIC_PRE_RANGE_BIAS;
+    }
+    for (len = 2, step = MIC_PRE_CPLX / 2; len <= MIC_PRE_CPLX; len <<= 1, step >>= 1)
+    {
+        half = len >> 1;
+        if (range & MIC_PRE_RANGE_MASK)
+        {
+            halvings++;
+            for (range = 0, i = 0; i < MIC_PRE_CPLX; i += len)
+            {
+                for (j = 0; j < half; j++)
+                    range |= mic_pre_butterfly_half(&z[i + j], &z[i + j + half], tw[j * step]);
+            }
+        }
+        else
+        {
+            for (range = 0, i = 0; i < MIC_PRE_CPLX; i += len)
+            {
+                for (j = 0; j < half; j++)
+                    range |= mic_pre_butterfly(&z[i + j], &z[i + j + half], tw[j * step]);
+            }
+        }
+    }
+    return halvings;
+}
+
+static void mic_pre_hpf(mic_pre_t *m, int16_t *pcm)
+{
+    int32_t x1 = m->hpf_x[0], x2 = m->hpf_x[1], y1 = m->hpf_y[0], y2 = m->hpf_y[1];
+    int i;
+
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        int32_t x = pcm[i] * 256;
+        int64_t acc = (int64_t)g_hpf_b0 * (x - 2 * x1 + x2)
+                      - (int64_t)g_hpf_a1 * y1 - (int64_t)g_hpf_a2 * y2;
+        int32_t y = (int32_t)(acc >> 28);
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        pcm[i] = mic_pre_sat16((y + 128) >> 8);
+    }
+    m->hpf_x[0] = x1;
+    m->hpf_x[1] = x2;
+    m->hpf_y[0] = y1;
+    m->hpf_y[1] = y2;
+}
+
+/* Alpha max plus beta min, within 4% of the true magnitude. */
+static inline uint32_t mic_pre_mag(int32_t re, int32_t im)
+{
+    uint32_t a = (uint32_t)abs(re), b = (uint32_t)abs(im);
+
+    if (a < b)
+    {
+        uint32_t t = a;
+        a = b;
+        b = t;
+    }
+    return a - (a >> 5) + (b >> 1) - (b >> 4) - (b >> 5);
+}
+
+static inline uint32_t mic_pre_shift(uint32_t v, int sh)
+{
+    return sh >= 0 ? v << sh : v >> -sh;
+}
+
+/* Updates the noise estimate of bin k with its magnitude, returns the
+ * suppression gain, Q15. */
+static int32_t mic_pre_bin_gain(mic_pre_t *m, int k, uint32_t mag)
+{
+    uint32_t s = m->smooth[k], n = m->noise[k], over;
+    int32_t g, r;
+    int sh;
+
+    if (m->hold)
+    {
+        // flushing the tail: its zero padding would drag the estimates down
+    }
+    else if (m->warmup)
+    {
+        uint32_t t = MIC_PRE_WARMUP - m->warmup;
+        s = s - (s >> 2) + (mag >> 2);
+        n = (n * t + s) / (t + 1);
+    }
+    else
+    {
+        s = s - (s >> 2) + (mag >> 2);
+        if (s < n)
+            n = s;
+        else
+            n += (n >> 8) + 1;  // about 3 dB a second
+    }
+    m->smooth[k] = s;
+    m->noise[k] = n;
+
+    over = (n * MIC_PRE_OVER) >> 4;
+    if (over >= mag)
+    {
+        g = MIC_PRE_GAIN_MIN;
+    }
+    else
+    {
+        sh = mic_pre_bitlen(mag) - 16;
+        if (sh > 0)
+        {
+            over >>= sh;
+            mag >>= sh;
+        }
+        r = (int32_t)((over << 15) / mag);
+        g = MIC_PRE_GAIN_MAX - r;
+        if (g < MIC_PRE_GAIN_MIN)
+            g = MIC_PRE_GAIN_MIN;
+    }
+    // fall slowly and rise at once, against musical noise without eating onsets
+    if (g < m->gain[k])
+        g = (g + m->gain[k]) >> 1;
+    if (!m->hold)
+        m->gain[k] = (uint16_t)g;
+    return g;
+}
+
+/* Spectral suppression on the frame of the last two hops, overlap added. */
+static void mic_pre_ns(mic_pre_t *m, int16_t *pcm)
+{
+    int16_t *v = m->fft.real;
+    uint32_t *z = m->fft.cplx;
+    uint32_t peak = 0;
+    int i, k, sh, s2, e1, e2, msh, sft;
+
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        v[i] = (int16_t)((m->prev[i] * g_win[i]) >> 15);
+        v[i + MIC_PRE_HOP] = (int16_t)((pcm[i] * g_win[i + MIC_PRE_HOP]) >> 15);
+        peak |= (uint32_t)abs(v[i]) | (uint32_t)abs(v[i + MIC_PRE_HOP]);
+    }
+    memcpy(m->prev, pcm, sizeof(m->prev));
+    memset(v + MIC_PRE_WIN, 0, (MIC_PRE_FFT - MIC_PRE_WIN) * sizeof(int16_t));
+
+    // normalize so the first stage runs at full precision without halving
+    sh = 13 - mic_pre_bitlen(peak);
+    for (i = 0; i < MIC_PRE_WIN; i++)
+        v[i] = sh >= 0 ? (int16_t)(v[i] * (1 << sh)) : (int16_t)(v[i] >> -sh);
+
+    e1 = mic_pre_fft(z, g_tw_fwd);
+    // bin magnitudes independent of the block scaling, from doubled bins
+    msh = e1 - 1 - sh;
+
+    // Split the packed transform into the real spectrum, weigh each bin
+    // and its mirror, and pack them back for the inverse.
+    {
+        int32_t a = mic_pre_lo(z[0]), b = mic_pre_hi(z[0]);
+        int32_t g0 = mic_pre_bin_gain(m, 0, mic_pre_shift(mic_pre_mag(a + b, 0), msh + 1));
+        int32_t gn = mic_pre_bin_gain(m, MIC_PRE_CPLX, mic_pre_shift(mic_pre_mag(a - b, 0), msh + 1));
+
+        z[0] = mic_pre_pack(((g0 + gn) * a + (g0 - gn) * b) >> 16, ((g0 - gn) * a + (g0 + gn) * b) >> 16);
+    }
+    for (k = 1; k <= MIC_PRE_CPLX / 2; k++)
+    {
+        int j = MIC_PRE_CPLX - k;
+        int32_t ar = mic_pre_lo(z[k]), ai = mic_pre_hi(z[k]);
+        int32_t br = mic_pre_lo(z[j]), bi = mic_pre_hi(z[j]);
+        int32_t c = g_split_cos[k], s = g_split_sin[k];
+        // twice the even and odd half spectra
+        int32_t er = ar + br, ei = ai - bi;
+        int32_t or = ai + bi, oi = br - ar;
+        int32_t wr = (int32_t)(((int64_t)c * or + (int64_t)s * oi) >> 15);
+        int32_t wi = (int32_t)(((int64_t)c * oi - (int64_t)s * or) >> 15);
+        int32_t gk, gj, gs, gd, er2, ei2, wr2, wi2, or2, oi2;
+
+        // X[k] = E + W O and conj X[N - k] = E - W O, both doubled
+        gk = mic_pre_bin_gain(m, k, mic_pre_shift(mic_pre_mag(er + wr, ei + wi), msh));
+        gj = mic_pre_bin_gain(m, j, mic_pre_shift(mic_pre_mag(er - wr, ei - wi), msh));
+        gs = gk + gj;
+        gd = gk - gj;
+        er2 = (int32_t)(((int64_t)gs * er + (int64_t)gd * wr) >> 16);
+        ei2 = (int32_t)(((int64_t)gs * ei + (int64_t)gd * wi) >> 16);
+        wr2 = (int32_t)(((int64_t)gd * er + (int64_t)gs * wr) >> 16);
+        wi2 = (int32_t)(((int64_t)gd * ei + (int64_t)gs * wi) >> 16);
+        or2 = (int32_t)(((int64_t)c * wr2 - (int64_t)s * wi2) >> 15);
+        oi2 = (int32_t)(((int64_t)c * wi2 + (int64_t)s * wr2) >> 15);
+        z[j] = mic_pre_pack(mic_pre_sat16((er2 + oi2) >> 1), mic_pre_sat16((or2 - ei2) >> 1));
+        z[k] = mic_pre_pack(mic_pre_sat16((er2 - oi2) >> 1), mic_pre_sat16((ei2 + or2) >> 1));
+    }
+    if (m->warmup && !m->hold)
+        m->warmup--;
+
+    peak = 0;
+    for (k = 0; k < MIC_PRE_CPLX; k++)
+        peak |= (uint32_t)abs(mic_pre_lo(z[k])) | (uint32_t)abs(mic_pre_hi(z[k]));
+    s2 = 13 - mic_pre_bitlen(peak);
+    if (s2 > 0)
+    {
+        for (k = 0; k < MIC_PRE_CPLX; k++)
+            z[k] = mic_pre_pack(mic_pre_lo(z[k]) * (1 << s2), mic_pre_hi(z[k]) * (1 << s2));
+    }
+    else
+    {
+        s2 = 0;
+    }
+    e2 = mic_pre_fft(z, g_tw_inv);
+
+    // back to sample scale with 4 fraction bits for the overlap add
+    sft = 19 + sh + s2 - e1 - e2;
+    if (sft < 0)
+        sft = 0;    // only a near silent frame gets here, it stays near silent
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        int32_t y = m->ola[i] + ((v[i] * g_win[i]) >> sft);
+
+        pcm[i] = mic_pre_sat16((y + 8) >> 4);
+        m->ola[i] = (v[i + MIC_PRE_HOP] * g_win[i + MIC_PRE_HOP]) >> sft;
+    }
+}
+
+static uint32_t mic_pre_isqrt(uint32_t v)
+{
+    uint32_t r = 0, b = 1u << 30;
+
+    while (b > v)
+        b >>= 2;
+    while (b)
+    {
+        if (v >= r + b)
+        {
+            v -= r + b;
+            r = (r >> 1) + b;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        b >>= 2;
+    }
+    return r;
+}
+
+/* Levels speech towards the target, holding the gain through pauses. */
+static void mic_pre_agc(mic_pre_t *m, int16_t *pcm)
+{
+    uint64_t energy = 0;
+    uint32_t rms, peak = 0;
+    int32_t g = m->agc_gain, want, cur, step;
+    int i;
+
+    if (m->hold)
+    {
+        // the padded tail says nothing about the level, keep the gain
+        for (i = 0; i < MIC_PRE_HOP; i++)
+            pcm[i] = mic_pre_sat16((pcm[i] * g) >> 12);
+        return;
+    }
+#ifdef MIC_PRE_DSP
+    for (i = 0; i < MIC_PRE_HOP; i += 2)
+    {
+        uint32_t pair;
+        memcpy(&pair, pcm + i, sizeof(pair));
+        energy = __SMLALD(pair, pair, energy);
+    }
+#else
+    for (i = 0; i < MIC_PRE_HOP; i++)
+        energy += (int32_t)pcm[i] * pcm[i];
+#endif
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        if ((uint32_t)abs(pcm[i]) > peak)
+            peak = abs(pcm[i]);
+    }
+    rms = mic_pre_isqrt((uint32_t)(energy / MIC_PRE_HOP));
+
+    if (!m->hops || rms < m->agc_floor)
+        m->agc_floor = rms;
+    else
+        m->agc_floor += (m->agc_floor >> 7) + 1;
+    m->speech = rms > MIC_PRE_AGC_QUIET && rms > m->agc_floor * 3;
+    if (m->speech)
+    {
+        m->speech_hops++;
+        want = (int32_t)((MIC_PRE_AGC_TARGET << 12) / rms);
+        if (want > MIC_PRE_AGC_MAX)
+            want = MIC_PRE_AGC_MAX;
+        if (want < MIC_PRE_AGC_MIN)
+            want = MIC_PRE_AGC_MIN;
+        // fast down, slow up
+        g += want < g ? (want - g) >> 2 : (want - g) >> 6;
+    }
+    if (peak && ((peak * (uint32_t)g) >> 12) > MIC_PRE_AGC_PEAK)
+        g = (int32_t)((MIC_PRE_AGC_PEAK << 12) / peak);
+
+    // ramp across the hop so gain steps do not click
+    cur = m->agc_gain << 8;
+    step = (g - m->agc_gain) * 256 / MIC_PRE_HOP;
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        pcm[i] = mic_pre_sat16((pcm[i] * (cur >> 8)) >> 12);
+        cur += step;
+    }
+    m->agc_gain = g;
+}
+
+void mic_pre_init(mic_pre_t *m, uint32_t flags)
+{
+    int k;
+
+    mic_pre_tables();
+    memset(m, 0, sizeof(*m));
+    m->flags = (uint8_t)flags;
+    m->warmup = MIC_PRE_WARMUP;
+    m->agc_gain = 1 << 12;
+    for (k = 0; k < MIC_PRE_BINS; k++)
+        m->gain[k] = MIC_PRE_GAIN_MAX;
+}
+
+void mic_pre_reset(mic_pre_t *m)
+{
+    memset(m->hpf_x, 0, sizeof(m->hpf_x));
+    memset(m->hpf_y, 0, sizeof(m->hpf_y));
+    memset(m->prev, 0, sizeof(m->prev));
+    memset(m->ola, 0, sizeof(m->ola));
+}
+
+void mic_pre_process(mic_pre_t *m, int16_t *pcm)
+{
+    if (m->flags & MIC_PRE_HPF)
+        mic_pre_hpf(m, pcm);
+    if (m->flags & MIC_PRE_NS)
+        mic_pre_ns(m, pcm);
+    if (m->flags & MIC_PRE_AGC)
+        mic_pre_agc(m, pcm);
+    m->hops++;
+}
+
+int mic_pre_flush(mic_pre_t *m, int16_t *pcm)
+{
+    memset(pcm, 0, MIC_PRE_HOP * sizeof(int16_t));
+    if (!(m->flags & MIC_PRE_NS))
+        return 0;
+    // a silent hop completes the last window; the high-pass already ran
+    m->hold = 1;
+    mic_pre_ns(m, pcm);
+    if (m->flags & MIC_PRE_AGC)
+        mic_pre_agc(m, pcm);
+    m->hold = 0;
+    return MIC_PRE_HOP;
+}
+
+int mic_pre_agc_db10(const mic_pre_t *m)
+{
+    return (int)lrintf(200.0f * log10f(m->agc_gain / 4096.0f));
+}
+
+int mic_pre_noise_dbfs(const mic_pre_t *m)
+{
+    uint64_t sum = 0;
+    int k;
+
+    for (k = 1; k < MIC_PRE_BINS; k++)
+        sum += m->noise[k];
+    if (!sum)
+        return -99;
+    // white noise of rms r gives bin magnitudes of about 11.2 r
+    return (int)lrintf(20.0f * log10f((float)sum / (MIC_PRE_BINS - 1) / 11.2f / 32768.0f));
+}
+
+/*
+ * Fixture: syllables of a harmonic voice, 300 ms on and 200 ms off after
+ * a 600 ms lead-in, in white noise with DC and 50 Hz hum.
+ */
+#define MIC_PRE_BENCH_HOPS      400
+#define MIC_PRE_BENCH_LEAD      60
+
+static int mic_pre_bench_voiced(int hop)
+{
+    return hop >= MIC_PRE_BENCH_LEAD && (hop - MIC_PRE_BENCH_LEAD) % 50 < 30;
+}
+
+static void mic_pre_bench_fixture(int16_t *pcm, int hop, float speech_rms, float noise_rms, uint32_t *seed)
+{
+    int i, h;
+
+    for (i = 0; i < MIC_PRE_HOP; i++)
+    {
+        float t = (hop * MIC_PRE_HOP + i) / 16000.0f, v = 0, n = 0;
+
+        if (mic_pre_bench_voiced(hop))
+        {
+            float f0 = 130.0f + 30.0f * sinf(2 * MIC_PRE_PI * 0.7f * t);
+            float env = sinf(MIC_PRE_PI * ((hop - MIC_PRE_BENCH_LEAD) % 50 * MIC_PRE_HOP + i) / (30 * MIC_PRE_HOP));
+            for (h = 1; h * f0 < 3500.0f; h++)
+                v += sinf(2 * MIC_PRE_PI * h * f0 * t) / h;
+            v *= env * speech_rms * 1.2f;
+        }
+        for (h = 0; h < 4; h++)
+        {
+            *seed = *seed * 1664525u + 1013904223u;
+            n += (int32_t)(*seed >> 16) - 32768;
+        }
+        n *= noise_rms / 37837.0f;  // sum of 4 uniforms, unit rms
+        v += n + 400.0f + 250.0f * sinf(2 * MIC_PRE_PI * 50.0f * t);
+        pcm[i] = mic_pre_sat16((int32_t)lrintf(v));
+    }
+}
+
+static void mic_pre_bench_run(uint32_t flags, int snr_db, int speech_dbfs)
+{
+    static mic_pre_t pre;
+    int16_t pcm[MIC_PRE_HOP];
+    float speech_rms = 32768.0f * powf(10.0f, speech_dbfs / 20.0f);
+    float noise_rms = speech_rms * powf(10.0f, -snr_db / 20.0f);
+    double e_speech = 0, e_noise = 0;
+    uint32_t n_speech = 0, n_noise = 0, seed = 12345, max = 0, start, cycles;
+    uint64_t total = 0;
+    int hop, i, delay = (flags & MIC_PRE_NS) ? 1 : 0;
+    float snr_out;
+
+    mic_pre_init(&pre, flags);
+    for (hop = 0; hop < MIC_PRE_BENCH_HOPS; hop++)
+    {
+        mic_pre_bench_fixture(pcm, hop, speech_rms, noise_rms, &seed);
+        rt_enter_critical();
+        start = cycle_counter_get();
+        mic_pre_process(&pre, pcm);
+        cycles = cycle_counter_get() - start;
+        rt_exit_critical();
+        total += cycles;
+        if (cycles > max)
+            max = cycles;
+
+        // settled part only, away from syllable edges
+        int src = hop - delay, pos = (src - MIC_PRE_BENCH_LEAD) % 50;
+        if (src < 100 || pos < 3 || (pos > 27 && pos < 33) || pos > 47)
+            continue;
+        double e = 0;
+        for (i = 0; i < MIC_PRE_HOP; i++)
+            e += (double)pcm[i] * pcm[i];
+        if (mic_pre_bench_voiced(src))
+        {
+            e_speech += e;
+            n_speech++;
+        }
+        else
+        {
+            e_noise += e;
+            n_noise++;
+        }
+    }
+    e_speech /= n_speech;
+    e_noise /= n_noise;
+    snr_out = e_speech > e_noise ? 10.0f * log10f((float)((e_speech - e_noise) / (e_noise + 1))) : 0;
+    rt_kprintf("mic_pre: snr %2d dB -> %3d dB, speech %d dBFS -> %d dBFS, agc %d dB, cycles avg %u max %u: %s\n",
+               snr_db, (int)lrintf(snr_out), speech_dbfs,
+               (int)lrintf(10.0f * log10f((float)(e_speech / MIC_PRE_HOP) / (32768.0f * 32768.0f))),
+               mic_pre_agc_db10(&pre) / 10, (uint32_t)(total / MIC_PRE_BENCH_HOPS), max,
+               max <= MIC_PRE_BUDGET_CYCLES ? "ok" : "OVER BUDGET");
+}
+
+/* mic_pre_bench [snr_db] [speech_dbfs] [flags]: quality and cycles per
+ * hop on synthetic noisy speech, against MIC_PRE_BUDGET_CYCLES. */
+static void mic_pre_bench(int argc, char **argv)
+{
+    static const int snr[] = {20, 10, 5, 0};
+    int speech_dbfs = argc > 2 ? atoi(argv[2]) : -35;
+    uint32_t flags = argc > 3 ? strtoul(argv[3], NULL, 0) : MIC_PRE_ALL;
+    int i;
+
+    cycle_counter_init();
+    rt_kprintf("mic_pre: flags 0x%x, target %u cycles per 10 ms\n", flags, MIC_PRE_BUDGET_CYCLES);
+    if (argc > 1)
+    {
+        mic_pre_bench_run(flags, atoi(argv[1]), speech_dbfs);
+        return;
+    }
+    for (i = 0; i < sizeof(snr) / sizeof(snr[0]); i++)
+        mic_pre_bench_run(flags, snr[i], speech_dbfs);
+}
+MSH_CMD_EXPORT(mic_pre_bench, mic_pre_bench [snr_db] [speech_dbfs] [flags]: mic preprocessing check);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
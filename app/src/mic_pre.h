@@ -0,0 +1,110 @@
+/**
+  ******************************************************************************
+  * @file   mic_pre.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __MIC_PRE_H__
+#define __MIC_PRE_H__
+
+#include <stdint.h>
+
+/*
+ * Mic preprocessing before the uplink, 16 kHz mono in 10 ms hops:
+ * high-pass (DC and hum), spectral noise suppression, then AGC. Fixed
+ * point throughout, with ARM DSP instructions where the core has them.
+ * Noise suppression works on 20 ms sine windows with 50% overlap, so
+ * it delays the audio by one hop.
+ */
+#define MIC_PRE_HOP         160     // samples per call, 10 ms
+#define MIC_PRE_WIN         (MIC_PRE_HOP * 2)
+#define MIC_PRE_FFT         512     // real transform, the window zero padded
+#define MIC_PRE_BINS        (MIC_PRE_FFT / 2 + 1)
+
+#define MIC_PRE_HPF         (1 << 0)
+#define MIC_PRE_NS          (1 << 1)
+#define MIC_PRE_AGC         (1 << 2)
+#define MIC_PRE_ALL         (MIC_PRE_HPF | MIC_PRE_NS | MIC_PRE_AGC)
+
+/* Cycle target for one hop, 0.8 ms at 240 MHz. Not yet measured on the
+ * SF32LB52x: mic_pre_bench there, and the mic_pre command during a chat,
+ * show what a hop really takes. */
+#ifndef MIC_PRE_BUDGET_CYCLES
+    #define MIC_PRE_BUDGET_CYCLES   200000
+#endif
+
+typedef struct
+{
+    uint8_t     flags;
+    uint8_t     speech;                     // last hop was above the noise floor
+    uint8_t     hold;                       // flushing, estimates left alone
+    uint16_t    warmup;                     // hops until the noise estimate settles
+    int32_t     hpf_x[2];                   // biquad history, Q8
+    int32_t     hpf_y[2];
+    int16_t     prev[MIC_PRE_HOP];          // first half of the analysis window
+    int32_t     ola[MIC_PRE_HOP];           // synthesis tail of the last window
+    uint32_t    smooth[MIC_PRE_BINS];       // time smoothed magnitude per bin
+    uint32_t    noise[MIC_PRE_BINS];        // noise magnitude per bin, minimum tracked
+    uint16_t    gain[MIC_PRE_BINS];         // suppression gain per bin, Q15
+    int32_t     agc_gain;                   // Q12
+    uint32_t    agc_floor;                  // rms of the quietest recent hops
+    union
+    {
+        int16_t     real[MIC_PRE_FFT];      // windowed frame
+        uint32_t    cplx[MIC_PRE_FFT / 2];  // packed complex, re in the low half
+    } fft;
+    uint32_t    hops;
+    uint32_t    speech_hops;
+} mic_pre_t;
+
+void mic_pre_init(mic_pre_t *m, uint32_t flags);
+/* Starts a new stream, keeping the noise and level estimates. */
+void mic_pre_reset(mic_pre_t *m);
+/* Processes MIC_PRE_HOP samples in place. */
+void mic_pre_process(mic_pre_t *m, int16_t *pcm);
+/* End of the stream: fills pcm with the hop noise suppression still holds
+ * back and returns its samples, 0 when nothing is held. */
+int  mic_pre_flush(mic_pre_t *m, int16_t *pcm);
+/* AGC gain in tenths of a dB and the mean noise floor in dBFS. */
+int  mic_pre_agc_db10(const mic_pre_t *m);
+int  mic_pre_noise_dbfs(const mic_pre_t *m);
+
+#endif /* __MIC_PRE_H__ */
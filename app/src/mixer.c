@@ -0,0 +1,486 @@
+/**
+  ******************************************************************************
+  * @file   mixer.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mixer.h"
+#include "spsc_ring.h"
+#include "tsm.h"
+#include "trace.h"
+#include "pipeline.h"
+#include "stats.h"
+
+#define MIXER_HOP_BYTES         (MIXER_HOP * sizeof(int16_t))
+#define MIXER_OUT_CACHE         PIPE_OUT_CACHE  // codec cache: the latency of the mix
+
+PIPE_ASSERT(MIXER_HOP == PIPE_HOP, mixer_hop_is_the_pipeline_hop);
+#define MIXER_POLL_MS           5
+#define MIXER_IDLE_MS           1000        // output kept open after the last channel closed
+#define MIXER_UNITY             32768       // Q15
+#define MIXER_DUCK_DB           12
+#define MIXER_ATTACK_HOPS       3
+#define MIXER_RELEASE_HOPS      30
+#define MIXER_VOLUME            15
+
+#define MIXER_EVENT_DATA        (1 << 0)
+
+struct mixer_ch
+{
+    char                        name[MIXER_NAME_LEN];
+    uint8_t                     prio;
+    volatile uint8_t            in_use;
+    volatile uint8_t            closing;    // plays out, then the mixer frees it
+    uint8_t                     playing;    // had audio in the last hop
+    spsc_ring_t                 *ring;
+    audio_server_callback_func  cb;
+    void                        *ctx;
+    tsm_t                       *tsm;       // plays through time compression
+    volatile uint32_t           catchup;    // backlog target in samples, 0 plays at 1x
+    int32_t                     gain;       // Q15 where the last hop ended
+    uint32_t                    bytes;
+    uint32_t                    underruns;
+    uint32_t                    ducked_hops;
+};
+
+typedef struct
+{
+    mixer_ch_t      ch[MIXER_CHANNELS];
+    rt_thread_t     thread;
+    rt_event_t      event;
+    audio_io_t      *out;
+    audio_io_tap_t  tap;
+    void            *tap_ctx;
+    int32_t         duck;                   // Q15 gain of a ducked channel
+    uint32_t        idle_ms;
+    uint32_t        hops;
+    uint32_t        out_full;               // hops that waited for codec cache room
+    uint32_t        opens;
+    int16_t         in[MIXER_HOP];
+    int16_t         mix[MIXER_HOP];
+    int32_t         acc[MIXER_HOP];
+} mixer_t;
+
+static mixer_t g_mixer;
+
+static int32_t mixer_duck_gain(int db)
+{
+    int32_t g = MIXER_UNITY;
+
+    while (db-- > 0)
+        g = g * 29205 >> 15;    // -1 dB
+    return g;
+}
+
+static int mixer_out_callback(audio_server_callback_cmt_t cmd, void *callback_userdata, uint32_t reserved)
+{
+    return 0;   // channels report their own underruns
+}
+
+static void mixer_out_open(mixer_t *m)
+{
+    audio_parameter_t pa = {0};
+
+    pa.write_bits_per_sample = 16;
+    pa.write_channnel_num = 1;
+    pa.read_bits_per_sample = 16;
+    pa.read_channnel_num = 1;
+    pa.write_samplerate = PIPE_RATE;
+    pa.read_samplerate = PIPE_RATE;
+    pa.write_cache_size = MIXER_OUT_CACHE;
+    m->out = audio_io_open_sink(NULL, &pa, mixer_out_callback, m);
+    if (!m->out)
+        return;
+    audio_io_set_tap(m->out, m->tap, m->tap_ctx);
+    m->opens++;
+}
+
+static void mixer_free(mixer_ch_t *ch)
+{
+    spsc_ring_t *ring = ch->ring;
+
+    ch->ring = NULL;
+    spsc_ring_destroy(ring);
+    rt_free(ch->tsm);
+    ch->tsm = NULL;
+    ch->in_use = 0;
+}
+
+/* Moves what the channel's ring holds into its time compression stage.
+ * Returns the bytes the channel has left to play. */
+static uint32_t mixer_catchup_fill(mixer_ch_t *ch)
+{
+    uint32_t room, n;
+    int16_t *in;
+
+    if (ch->catchup && !ch->tsm)
+    {
+        ch->tsm = rt_malloc(sizeof(tsm_t));
+        if (!ch->tsm)
+        {
+            rt_kprintf("mixer: %s plays at 1x, no memory to catch up\n", ch->name);
+            ch->catchup = 0;
+        }
+        else
+        {
+            tsm_init(ch->tsm);
+        }
+    }
+    if (!ch->tsm)
+        return spsc_ring_data_len(ch->ring);
+    tsm_set_target(ch->tsm, ch->catchup);
+    in = tsm_in(ch->tsm, &room);
+    n = spsc_ring_get(ch->ring, in, room * sizeof(int16_t));
+    tsm_in_done(ch->tsm, n / sizeof(int16_t));
+    return spsc_ring_data_len(ch->ring) + tsm_buffered(ch->tsm) * sizeof(int16_t);
+}
+
+/* One hop of the channel into m->in, through its time compression stage
+ * when it has one. */
+static void mixer_read(mixer_t *m, mixer_ch_t *ch)
+{
+    uint32_t n, backlog;
+
+    if (!ch->tsm)
+    {
+        n = spsc_ring_get(ch->ring, m->in, MIXER_HOP_BYTES);
+    }
+    else
+    {
+        backlog = spsc_ring_data_len(ch->ring) / sizeof(int16_t) + tsm_buffered(ch->tsm);
+        if (tsm_process(ch->tsm, backlog, m->in))
+            n = MIXER_HOP_BYTES;
+        else
+            n = tsm_drain(ch->tsm, m->in) * sizeof(int16_t);
+    }
+    memset((uint8_t *)m->in + n, 0, MIXER_HOP_BYTES - n);
+}
+
+/* Sums one hop into m->mix. 0 when no channel had a hop ready. */
+static int mixer_mix(mixer_t *m)
+{
+    int top = -1, ready[MIXER_CHANNELS], i, n;
+    mixer_ch_t *ch;
+
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        uint32_t queued;
+
+        ch = &m->ch[i];
+        ready[i] = 0;
+        if (!ch->in_use || !ch->ring)
+            continue;
+        queued = mixer_catchup_fill(ch);
+        // a partial hop waits for the rest, unless it is the tail
+        ready[i] = queued >= MIXER_HOP_BYTES || (ch->closing && queued);
+        if (ready[i] && ch->prio > top)
+            top = ch->prio;
+        if (!queued && ch->closing)
+        {
+            mixer_free(ch);
+        }
+        else if (!ready[i] && ch->playing)
+        {
+            audio_server_callback_func cb = ch->cb;
+
+            ch->playing = 0;
+            ch->underruns++;
+            if (cb)
+                cb(as_callback_cmd_cache_empty, ch->ctx, 0);
+        }
+    }
+    if (top < 0)
+        return 0;
+
+    memset(m->acc, 0, sizeof(m->acc));
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        int32_t target, g0, g1, step;
+
+        ch = &m->ch[i];
+        if (!ch->in_use || !ch->ring)
+            continue;
+        target = ch->prio < top ? m->duck : MIXER_UNITY;
+        g0 = ch->gain;
+        if (g0 > target)
+        {
+            step = (MIXER_UNITY - m->duck) / MIXER_ATTACK_HOPS;
+            g1 = g0 - step > target ? g0 - step : target;
+        }
+        else
+        {
+            step = (MIXER_UNITY - m->duck) / MIXER_RELEASE_HOPS;
+            g1 = g0 + step < target ? g0 + step : target;
+        }
+        ch->gain = g1;
+        if (!ready[i])
+            continue;
+        mixer_read(m, ch);
+        ch->playing = 1;
+        if (g1 < MIXER_UNITY)
+            ch->ducked_hops++;
+        // the gain glides across the hop, a step would click
+        for (n = 0; n < MIXER_HOP; n++)
+            m->acc[n] += m->in[n] * (g0 + (g1 - g0) * n / MIXER_HOP) >> 15;
+    }
+    for (n = 0; n < MIXER_HOP; n++)
+        m->mix[n] = m->acc[n] > 32767 ? 32767 : (m->acc[n] < -32768 ? -32768 : m->acc[n]);
+    m->hops++;
+    return 1;
+}
+
+static void mixer_entry(void *p)
+{
+    mixer_t *m = (mixer_t *)p;
+    int pending = 0, i, open;
+
+    while (1)
+    {
+        rt_uint32_t evt;
+
+        if (!pending)
+            pending = mixer_mix(m);
+        if (pending)
+        {
+            m->idle_ms = 0;
+            if (!m->out)
+                mixer_out_open(m);
+            if (!m->out)
+            {
+                pending = 0;    // no codec, the hop is lost
+                rt_thread_mdelay(MIXER_POLL_MS);
+                continue;
+            }
+            if (audio_io_write(m->out, (uint8_t *)m->mix, MIXER_HOP_BYTES))
+            {
+                pending = 0;
+                continue;
+            }
+            m->out_full++;
+            rt_thread_mdelay(MIXER_POLL_MS);
+            continue;
+        }
+
+        for (i = 0, open = 0; i < MIXER_CHANNELS; i++)
+            open |= m->ch[i].in_use;
+        if (m->out && !open && (m->idle_ms += MIXER_POLL_MS) >= MIXER_IDLE_MS)
+        {
+            audio_io_close(m->out);
+            m->out = NULL;
+        }
+        rt_event_recv(m->event, MIXER_EVENT_DATA, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                      rt_tick_from_millisecond(MIXER_POLL_MS), &evt);
+    }
+}
+
+void mixer_init(void)
+{
+    mixer_t *m = &g_mixer;
+
+    if (m->thread)
+        return;
+    m->duck = mixer_duck_gain(MIXER_DUCK_DB);
+    m->event = rt_event_create("mixer", RT_IPC_FLAG_FIFO);
+    // above every writer, a starved mixer is an underrun for all of them
+    m->thread = rt_thread_create("mixer", mixer_entry, m, 2048,
+                                 RT_THREAD_PRIORITY_MIDDLE + RT_THREAD_PRIORITY_HIGHER - 2,
+                                 RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(m->event && m->thread);
+    audio_server_set_private_volume(AUDIO_TYPE_LOCAL_MUSIC, MIXER_VOLUME);
+    rt_thread_startup(m->thread);
+}
+
+mixer_ch_t *mixer_open(const char *name, uint8_t prio, uint32_t ring_size,
+                       audio_server_callback_func cb, void *ctx)
+{
+    mixer_t *m = &g_mixer;
+    mixer_ch_t *ch = NULL;
+    spsc_ring_t *ring;
+    uint32_t size = MIXER_HOP_BYTES;
+    int i;
+
+    RT_ASSERT(m->thread);
+    while (size < ring_size)
+        size <<= 1;
+    ring = spsc_ring_create(size);
+    if (!ring)
+        return NULL;
+    rt_enter_critical();
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        if (!m->ch[i].in_use)
+        {
+            ch = &m->ch[i];
+            ch->in_use = 1;     // not mixed before it has a ring
+            break;
+        }
+    }
+    rt_exit_critical();
+    if (!ch)
+    {
+        rt_kprintf("mixer: no free channel for %s\n", name);
+        spsc_ring_destroy(ring);
+        return NULL;
+    }
+    rt_strncpy(ch->name, name, MIXER_NAME_LEN - 1);
+    ch->name[MIXER_NAME_LEN - 1] = '\0';
+    ch->prio = prio;
+    ch->cb = cb;
+    ch->ctx = ctx;
+    ch->gain = MIXER_UNITY;
+    ch->playing = 0;
+    ch->closing = 0;
+    ch->bytes = 0;
+    ch->underruns = 0;
+    ch->ducked_hops = 0;
+    ch->catchup = 0;
+    ch->ring = ring;
+    return ch;
+}
+
+uint32_t mixer_write(mixer_ch_t *ch, const uint8_t *data, uint32_t len)
+{
+    uint32_t n;
+
+    // chat's prompts and answers take turns on one channel
+    rt_enter_critical();
+    n = spsc_ring_put(ch->ring, data, len);
+    rt_exit_critical();
+    ch->bytes += n;
+    if (n)
+        rt_event_send(g_mixer.event, MIXER_EVENT_DATA);
+    return n;
+}
+
+void mixer_set_catchup(mixer_ch_t *ch, uint32_t target_ms)
+{
+    ch->catchup = target_ms * (PIPE_RATE / 1000);   // the mixer sets the stage up on its next hop
+}
+
+void mixer_close(mixer_ch_t *ch)
+{
+    ch->cb = NULL;
+    ch->closing = 1;
+    rt_event_send(g_mixer.event, MIXER_EVENT_DATA);
+}
+
+void mixer_stats(volc_stats_t *s)
+{
+    mixer_t *m = &g_mixer;
+    int i;
+
+    // the mixer thread frees a closed channel's ring, hold it off
+    rt_enter_critical();
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        if (m->ch[i].ring)
+        {
+            stats_ring(&s->mix[i], m->ch[i].ring);
+            rt_snprintf(s->mix_name[i], MIXER_NAME_LEN, "%s", m->ch[i].name);
+        }
+    }
+    rt_exit_critical();
+}
+
+void mixer_set_tap(audio_io_tap_t tap, void *ctx)
+{
+    mixer_t *m = &g_mixer;
+
+    rt_enter_critical();
+    m->tap_ctx = ctx;
+    m->tap = tap;
+    if (m->out)
+        audio_io_set_tap(m->out, tap, ctx);
+    rt_exit_critical();
+}
+
+/* mixer [duck_db]: channels, gains and underruns; sets how far a lower
+ * priority channel is ducked. */
+static void mixer(int argc, char **argv)
+{
+    mixer_t *m = &g_mixer;
+    int i;
+
+    if (!m->thread)
+    {
+        rt_kprintf("mixer not started\n");
+        return;
+    }
+    if (argc > 1)
+        m->duck = mixer_duck_gain(atoi(argv[1]));
+    rt_kprintf("mixer: output %s, %d hops, %d waited for the codec, opened %d times, duck %d/32768\n",
+               m->out ? "open" : "closed", m->hops, m->out_full, m->opens, m->duck);
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        mixer_ch_t *ch = &m->ch[i];
+        uint32_t queued = 0, speed = 0, catchups = 0, fast_hops = 0;
+        int32_t skipped = 0;
+        int used;
+
+        rt_enter_critical();    // the mixer frees a closed channel's ring
+        used = ch->in_use && ch->ring;
+        if (used)
+            queued = spsc_ring_data_len(ch->ring);
+        if (used && ch->tsm)
+        {
+            queued += tsm_buffered(ch->tsm) * sizeof(int16_t);
+            speed = ch->tsm->speed;
+            catchups = ch->tsm->catchups;
+            fast_hops = ch->tsm->fast_hops;
+            skipped = ch->tsm->skipped;
+        }
+        rt_exit_critical();
+        if (used)
+            rt_kprintf("  %-*s prio %d, %d bytes, %d queued, gain %d, %d underruns, %d hops ducked%s\n",
+                       MIXER_NAME_LEN, ch->name, ch->prio, ch->bytes, queued,
+                       ch->gain, ch->underruns, ch->ducked_hops, ch->closing ? ", closing" : "");
+        if (used && speed)
+            rt_kprintf("  %-*s catch up to %d ms: speed %d/4096, %d catch ups, %d hops fast, %d ms skipped\n",
+                       MIXER_NAME_LEN, "", ch->catchup / (PIPE_RATE / 1000), speed, catchups, fast_hops,
+                       skipped / (PIPE_RATE / 1000));
+    }
+}
+MSH_CMD_EXPORT(mixer, mixer [duck_db]: speaker mixer channels and ducking);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
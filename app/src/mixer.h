@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file   mixer.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+#include <rtthread.h>
+#include "audio_server.h"
+#include "audio_io.h"
+
+#define MIXER_CHANNELS          4
+#define MIXER_NAME_LEN          12
+#define MIXER_HOP               160         // samples mixed at a time, 10 ms of 16 kHz mono
+
+/*
+ * The one speaker. Chat answers, prompts and TTS notifications each write
+ * to a channel; a mixer thread sums them 10 ms at a time into a codec
+ * sink that keeps only MIXER_OUT_CACHE of audio queued, so a new channel
+ * is heard promptly. While a channel has audio, every channel of lower
+ * priority is ducked, ramping down in 30 ms and back up in 300 ms.
+ * A channel that fell behind can catch up by playing slightly faster.
+ * Clients normally open channels as "mix:<prio>:<name>" audio_io sinks.
+ */
+typedef struct mixer_ch mixer_ch_t;
+
+void        mixer_init(void);
+
+/* ring_size is rounded up to a power of two, the backlog the writer may
+ * queue ahead of the speaker. cb gets as_callback_cmd_cache_empty when
+ * the channel runs dry while open. */
+mixer_ch_t  *mixer_open(const char *name, uint8_t prio, uint32_t ring_size,
+                        audio_server_callback_func cb, void *ctx);
+/* Same contract as audio_write: all of it, or 0 when the channel is full. */
+uint32_t    mixer_write(mixer_ch_t *ch, const uint8_t *data, uint32_t len);
+/* Plays the channel faster, pitch kept, while more than target_ms is
+ * queued on it, see tsm.h; 0 plays it at 1x. For live streams whose
+ * backlog is latency. */
+void        mixer_set_catchup(mixer_ch_t *ch, uint32_t target_ms);
+/* What is queued still plays, then the channel is freed. */
+void        mixer_close(mixer_ch_t *ch);
+
+/* Sees the mixed audio as it goes to the codec, see audio_io_set_tap. */
+void        mixer_set_tap(audio_io_tap_t tap, void *ctx);
+
+#endif /* __MIXER_H__ */
@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file   pipeline.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include "pipeline.h"
+#include "linkq.h"
+#include "aec.h"
+#include "mic_pre.h"
+#include "tsm.h"
+
+// the DSP stages all work on the same 10 ms hop
+PIPE_ASSERT(AEC_HOP == PIPE_HOP, aec_hop_is_the_pipeline_hop);
+PIPE_ASSERT(MIC_PRE_HOP == PIPE_HOP, mic_pre_hop_is_the_pipeline_hop);
+PIPE_ASSERT(TSM_HOP == PIPE_HOP, tsm_hop_is_the_pipeline_hop);
+
+static void pipeline(int argc, char **argv)
+{
+    int i;
+
+    rt_kprintf("profile %s: %d Hz, %d ms frames, wire %s\n", PIPE_PROFILE, PIPE_RATE, PIPE_FRAME_MS, PIPE_WIRE_NAME);
+    rt_kprintf("uplink:   dsp ring %d, mic ring %d, message %d + base64 %d\n", PIPE_MIC_RAW_RING, PIPE_MIC_RING,
+               PIPE_UPLINK_BYTES, PIPE_UPLINK_B64);
+    rt_kprintf("downlink: delta %d, jitter ring %d, speaker ring %d, codec cache %d, echo ref %d\n",
+               PIPE_DELTA_BYTES, PIPE_JITTER_RING, PIPE_SPK_RING, PIPE_OUT_CACHE, PIPE_REF_RING);
+    rt_kprintf("tts:      delta %d, mp3 ring %d, pcm ring %d, cache %d\n",
+               PIPE_TTS_DELTA_BYTES, PIPE_TTS_MP3_RING, PIPE_TTS_PCM_RING, PIPE_TTS_CACHE);
+    rt_kprintf("ram:      chat %d, +%d full duplex, tts %d bytes\n", PIPE_CHAT_RAM, PIPE_DUPLEX_RAM, PIPE_TTS_RAM);
+    rt_kprintf("latency:  up %d ms, down %d..%d ms (codec cache, jitter max %d, catch up above %d)\n",
+               PIPE_UP_MS, PIPE_DOWN_MIN_MS, PIPE_DOWN_MAX_MS, PIPE_JITTER_MAX_MS, PIPE_CATCHUP_MS);
+    for (i = 0; i < LINKQ_NUM; i++)
+    {
+        const linkq_profile_t *p = linkq_profile((linkq_class_t)i);
+
+        rt_kprintf("link %-5s in %-10s out %-10s frame %4d B, >= %d frames/msg, jitter %3d ms, %3d kbps\n",
+                   p->name, p->in_format, p->out_format, p->frame_bytes, p->agg_min, p->jitter_ms,
+                   linkq_need_kbps(p));
+    }
+}
+MSH_CMD_EXPORT(pipeline, show the audio pipeline profile built in);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,174 @@
+/**
+  ******************************************************************************
+  * @file   pipeline.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <stdint.h>
+#include "uplink.h"
+
+/*
+ * Audio pipeline profile, see "Audio pipeline profile" in Kconfig.proj.
+ * Every frame, ring and cache size of chat and TTS is derived here from
+ * the few choices made there, so the hot loops see constants and a
+ * combination that does not fit fails to build.
+ */
+#ifndef VOLC_AUDIO_RATE
+    #define VOLC_AUDIO_RATE             16000
+#endif
+#ifndef VOLC_AUDIO_FRAME_MS
+    #define VOLC_AUDIO_FRAME_MS         10
+#endif
+#ifndef VOLC_AUDIO_MIC_RING_MS
+    #define VOLC_AUDIO_MIC_RING_MS      256
+#endif
+#ifndef VOLC_AUDIO_SPK_MS
+    #define VOLC_AUDIO_SPK_MS           900
+#endif
+#ifndef VOLC_AUDIO_JITTER_MAX_MS
+    #define VOLC_AUDIO_JITTER_MAX_MS    250
+#endif
+#ifndef VOLC_AUDIO_CATCHUP_MS
+    #define VOLC_AUDIO_CATCHUP_MS       200
+#endif
+#ifndef VOLC_AUDIO_OUT_CACHE_MS
+    #define VOLC_AUDIO_OUT_CACHE_MS     80
+#endif
+#ifndef VOLC_AUDIO_TTS_MP3_KB
+    #define VOLC_AUDIO_TTS_MP3_KB       16
+#endif
+
+#if defined(VOLC_PROFILE_LOW_LATENCY)
+    #define PIPE_PROFILE                "low latency"
+#elif defined(VOLC_PROFILE_LOW_BANDWIDTH)
+    #define PIPE_PROFILE                "low bandwidth"
+#elif defined(VOLC_PROFILE_LOW_RAM)
+    #define PIPE_PROFILE                "low RAM"
+#else
+    #define PIPE_PROFILE                "balanced"
+#endif
+
+#if defined(VOLC_AUDIO_WIRE_ULAW)
+    #define PIPE_WIRE_ULAW              1           // every link class
+    #define PIPE_WIRE_NAME              "mu-law"
+#elif defined(VOLC_AUDIO_WIRE_PCM16)
+    #define PIPE_WIRE_PCM16             1
+    #define PIPE_WIRE_NAME              "pcm16"
+#else
+    #define PIPE_WIRE_ADAPTIVE          1           // mu-law once the link is poor
+    #define PIPE_WIRE_NAME              "pcm16, mu-law on poor links"
+#endif
+
+/* Compile time check, for compilers without _Static_assert. */
+#define PIPE_ASSERT(cond, name)         typedef char pipe_assert_##name[(cond) ? 1 : -1]
+
+/* Numeric symbol as a string literal, for JSON built at compile time. */
+#define PIPE_STR_(x)                    #x
+#define PIPE_STR(x)                     PIPE_STR_(x)
+
+/* Smallest power of two >= x, for the spsc rings, x > 0. */
+#define PIPE_OR1_(x)                    ((x) | ((x) >> 1))
+#define PIPE_OR2_(x)                    (PIPE_OR1_(x) | (PIPE_OR1_(x) >> 2))
+#define PIPE_OR4_(x)                    (PIPE_OR2_(x) | (PIPE_OR2_(x) >> 4))
+#define PIPE_OR8_(x)                    (PIPE_OR4_(x) | (PIPE_OR4_(x) >> 8))
+#define PIPE_OR16_(x)                   (PIPE_OR8_(x) | (PIPE_OR8_(x) >> 16))
+#define PIPE_POW2(x)                    (PIPE_OR16_((uint32_t)(x) - 1) + 1)
+
+// pcm16 mono everywhere on the device
+#define PIPE_RATE                       VOLC_AUDIO_RATE
+#define PIPE_BYTES_PER_MS               (PIPE_RATE / 1000 * sizeof(int16_t))
+#define PIPE_MS_BYTES(ms)               ((ms) * PIPE_BYTES_PER_MS)
+#define PIPE_HOP                        (PIPE_RATE / 100)           // 10 ms processing hop
+
+// uplink: frames of VOLC_AUDIO_FRAME_MS, 8 kHz mu-law on the wire is a quarter of them
+#define PIPE_FRAME_MS                   VOLC_AUDIO_FRAME_MS
+#define PIPE_FRAME_BYTES                PIPE_MS_BYTES(PIPE_FRAME_MS)
+#define PIPE_ULAW_FRAME_BYTES           (PIPE_FRAME_BYTES / 4)
+#define PIPE_FRAMES_PER_S               (1000 / PIPE_FRAME_MS)
+#define PIPE_FRAMES(ms)                 (((ms) + PIPE_FRAME_MS - 1) / PIPE_FRAME_MS)
+#define PIPE_MIC_RING                   PIPE_POW2(PIPE_MS_BYTES(VOLC_AUDIO_MIC_RING_MS))
+#define PIPE_MIC_RAW_RING               PIPE_POW2(PIPE_MS_BYTES(64))    // codec hops ahead of the mic dsp thread
+#define PIPE_UPLINK_BYTES               (PIPE_FRAME_BYTES * UPLINK_MAX_AGG)
+#define PIPE_UPLINK_B64                 (PIPE_UPLINK_BYTES * 4 / 3 + 128)   // buffer.append
+
+// downlink: answer deltas, the jitter buffer ahead of the speaker channel
+#define PIPE_DELTA_BYTES                4096        // largest decoded answer delta the server sends
+#define PIPE_JITTER_MAX_MS              VOLC_AUDIO_JITTER_MAX_MS
+#define PIPE_JITTER_RING                PIPE_POW2(PIPE_MS_BYTES(PIPE_JITTER_MAX_MS) + PIPE_DELTA_BYTES)
+#define PIPE_SPK_RING                   PIPE_POW2(PIPE_MS_BYTES(VOLC_AUDIO_SPK_MS))
+#define PIPE_CATCHUP_MS                 VOLC_AUDIO_CATCHUP_MS
+#define PIPE_OUT_CACHE_MS               VOLC_AUDIO_OUT_CACHE_MS
+#define PIPE_OUT_CACHE                  PIPE_MS_BYTES(PIPE_OUT_CACHE_MS)
+// echo reference: what the codec cache holds and a few hops of callback slack
+#define PIPE_REF_RING                   PIPE_POW2(2 * PIPE_OUT_CACHE + PIPE_MS_BYTES(40))
+
+// TTS
+#define PIPE_TTS_DELTA_BYTES            8192        // largest decoded mp3 delta
+#define PIPE_TTS_MP3_RING               PIPE_POW2(VOLC_AUDIO_TTS_MP3_KB * 1024)
+#define PIPE_TTS_PCM_RING               8192
+#define PIPE_TTS_CACHE                  4096        // the notification channel's backlog
+
+/* RAM the profile decides: rings, the codec cache and frame buffers. */
+#define PIPE_CHAT_RAM                   (PIPE_MIC_RAW_RING + PIPE_MIC_RING + PIPE_UPLINK_BYTES + PIPE_UPLINK_B64 + PIPE_DELTA_BYTES + \
+                                         PIPE_JITTER_RING + PIPE_SPK_RING + PIPE_OUT_CACHE)
+#define PIPE_DUPLEX_RAM                 PIPE_REF_RING
+#define PIPE_TTS_RAM                    (PIPE_TTS_DELTA_BYTES + PIPE_TTS_MP3_RING + PIPE_TTS_PCM_RING + PIPE_TTS_CACHE)
+
+/* Latency: a frame fills before it is sent, the codec cache plays out
+ * before anything mixed is heard; the jitter target and the catch up
+ * threshold are what a poor link or a stall add on top. */
+#define PIPE_UP_MS                      PIPE_FRAME_MS
+#define PIPE_DOWN_MIN_MS                PIPE_OUT_CACHE_MS
+#define PIPE_DOWN_MAX_MS                (PIPE_JITTER_MAX_MS + PIPE_CATCHUP_MS + PIPE_OUT_CACHE_MS)
+
+PIPE_ASSERT(PIPE_RATE == 16000, rate_is_the_dsp_rate);
+PIPE_ASSERT(PIPE_FRAME_MS % 10 == 0 && PIPE_FRAME_MS <= 40, frame_is_whole_hops);
+PIPE_ASSERT(PIPE_MIC_RING >= PIPE_UPLINK_BYTES + PIPE_FRAME_BYTES, mic_ring_holds_a_full_message);
+PIPE_ASSERT(PIPE_SPK_RING >= PIPE_MS_BYTES(PIPE_JITTER_MAX_MS) + PIPE_DELTA_BYTES, spk_ring_takes_the_jitter_buffer);
+PIPE_ASSERT(PIPE_MS_BYTES(PIPE_JITTER_MAX_MS + PIPE_CATCHUP_MS) < PIPE_SPK_RING, catchup_below_the_spk_ring);
+PIPE_ASSERT(PIPE_OUT_CACHE % (PIPE_HOP * sizeof(int16_t)) == 0, out_cache_is_whole_hops);
+PIPE_ASSERT(PIPE_TTS_MP3_RING >= PIPE_TTS_DELTA_BYTES, tts_ring_holds_a_delta);
+
+#endif /* __PIPELINE_H__ */
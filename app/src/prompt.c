@@ -0,0 +1,505 @@
+/**
+  ******************************************************************************
+  * @file   prompt.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dfs_posix.h"
+#include "audio_io.h"
+#include "prompt.h"
+#include "trace.h"
+
+#if PKG_USING_LIBHELIX
+    #include "mp3dec.h"
+#else
+#error "should config PKG_USING_LIBHELIX"
+#endif
+#ifdef PKG_LIB_OPUS
+    #include "opus.h"
+#endif
+
+#ifndef VOLC_PROMPT_DIR
+    #define VOLC_PROMPT_DIR     "/prompts"
+#endif
+
+#define PROMPT_VARIANTS         4
+#define PROMPT_PATH_LEN         48
+#define PROMPT_MAX_FRAME        1441    // 320 kbps at 32 kHz, padded
+#define PROMPT_LEAD_MS          80      // decoded audio kept ahead of the speaker
+#define PROMPT_FADE_TIMEOUT     200
+#define PROMPT_MP3_SAMPLES      (MAX_NCHAN * MAX_NGRAN * MAX_NSAMP)
+#define PROMPT_OPUS_MAX_MS      120     // longest packet Opus allows
+#define PROMPT_OPUS_RATE        48000   // Ogg Opus granule and pre-skip rate
+#ifdef PKG_LIB_OPUS
+    #define PROMPT_STACK_SIZE   8192    // libopus decodes on the stack
+#else
+    #define PROMPT_STACK_SIZE   3072
+#endif
+
+#define PROMPT_EVENT_PLAY       (1 << 0)
+
+typedef struct
+{
+    char        path[PROMPT_PATH_LEN];
+    uint32_t    *offset;        // frame start offsets, plus the end of the last frame for mp3
+    uint16_t    *length;        // opus packet sizes, NULL for mp3
+    uint16_t    frames;
+    uint16_t    samprate;
+    uint16_t    frame_samples;
+    uint16_t    pre_skip;       // opus samples at 48 kHz to drop at the start
+} prompt_file_t;
+
+typedef struct
+{
+    prompt_file_t   file[PROMPT_NUM][PROMPT_VARIANTS];
+    uint8_t         variants[PROMPT_NUM];
+    rt_thread_t     thread;
+    rt_event_t      event;
+    rt_sem_t        done;
+    audio_io_t      *speaker;
+    uint32_t        samplerate;
+    uint32_t        written;
+    uint32_t        seed;
+    prompt_id_t     id;
+    volatile uint8_t is_playing;
+    volatile uint8_t is_fading;
+} prompt_t;
+
+static const char *const prompt_name[PROMPT_NUM] =
+{
+    "thinking", "error",
+};
+
+static prompt_t g_prompt;
+
+/* Layer III only. Returns the frame length, 0 if hdr is not a frame header. */
+static uint32_t prompt_frame_header(const uint8_t *hdr, uint32_t *samprate, uint32_t *samples)
+{
+    static const uint16_t kbps[2][15] =
+    {
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},   // MPEG1
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},       // MPEG2, 2.5
+    };
+    static const uint16_t rates[3] = {44100, 48000, 32000};
+    uint32_t version, br, sr;
+
+    if (hdr[0] != 0xFF || (hdr[1] & 0xE0) != 0xE0 || ((hdr[1] >> 1) & 3) != 1)
+        return 0;
+    version = (hdr[1] >> 3) & 3;            // 3 MPEG1, 2 MPEG2, 0 MPEG2.5
+    br = hdr[2] >> 4;
+    sr = (hdr[2] >> 2) & 3;
+    if (version == 1 || br == 0 || br == 15 || sr == 3)
+        return 0;
+    *samprate = rates[sr] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    *samples = version == 3 ? 1152 : 576;
+    br = kbps[version == 3 ? 0 : 1][br] * 1000;
+    return (version == 3 ? 144 : 72) * br / *samprate + ((hdr[2] >> 1) & 1);
+}
+
+/* Makes room for one more frame entry and the end sentinel. */
+static int prompt_grow(prompt_file_t *f, uint32_t *cap)
+{
+    if (f->frames + 1 < *cap)
+        return RT_EOK;
+    uint32_t *offset = rt_realloc(f->offset, (*cap + 64) * sizeof(uint32_t));
+    if (!offset)
+        return -RT_ENOMEM;
+    f->offset = offset;
+    if (f->length)
+    {
+        uint16_t *length = rt_realloc(f->length, (*cap + 64) * sizeof(uint16_t));
+        if (!length)
+            return -RT_ENOMEM;
+        f->length = length;
+    }
+    *cap += 64;
+    return RT_EOK;
+}
+
+static void prompt_index_mp3(prompt_file_t *f, int fd)
+{
+    uint8_t hdr[10];
+    uint32_t pos = 0, cap = 0, samprate, samples, len;
+
+    if (read(fd, hdr, 10) == 10 && memcmp(hdr, "ID3", 3) == 0)
+        pos = 10 + ((hdr[6] & 0x7F) << 21 | (hdr[7] & 0x7F) << 14 | (hdr[8] & 0x7F) << 7 | (hdr[9] & 0x7F));
+    while (lseek(fd, pos, SEEK_SET) == pos && read(fd, hdr, 4) == 4)
+    {
+        len = prompt_frame_header(hdr, &samprate, &samples);
+        if (!len || len > PROMPT_MAX_FRAME || (f->frames && samprate != f->samprate))
+            break;  // trailing tag or garbage, the frames before it still play
+        if (prompt_grow(f, &cap) != RT_EOK)
+            break;
+        f->offset[f->frames++] = pos;
+        f->samprate = samprate;
+        f->frame_samples = samples;
+        pos += len;
+    }
+    if (f->frames)
+        f->offset[f->frames] = pos;
+}
+
+#ifdef PKG_LIB_OPUS
+/* Ogg Opus: walks the page segment tables and keeps every audio packet,
+ * after the OpusHead and OpusTags header packets. Only the tags may span
+ * pages in files this short, a continued audio packet ends the index. */
+static void prompt_index_opus(prompt_file_t *f, int fd)
+{
+    uint8_t hdr[27], lace[255], head[2];
+    uint32_t pos = 0, cap = 1, pkt = 0, len = 0, seg;
+    int packets = 0, cont = 0, i;
+
+    f->samprate = PROMPT_OPUS_RATE;
+    f->length = rt_malloc(sizeof(uint16_t));
+    if (!f->length)
+        return;
+    while (lseek(fd, pos, SEEK_SET) == pos && read(fd, hdr, 27) == 27 && memcmp(hdr, "OggS", 4) == 0)
+    {
+        if (read(fd, lace, hdr[26]) != hdr[26])
+            break;
+        if (!(hdr[5] & 1))
+            len = cont = 0;     // a fresh page, nothing carried over
+        else if (len)
+            cont = 1;
+        pos += 27 + hdr[26];
+        for (i = 0, seg = 0; i < hdr[26]; seg += lace[i++])
+        {
+            if (!len && !cont)
+                pkt = pos + seg;
+            len += lace[i];
+            if (lace[i] == 255)
+                continue;
+            if (packets == 0)
+            {
+                // OpusHead: the pre-skip is a little endian u16 at byte 10
+                if (len < 19 || lseek(fd, pkt + 10, SEEK_SET) != pkt + 10 || read(fd, head, 2) != 2)
+                    return;
+                f->pre_skip = head[0] | head[1] << 8;
+            }
+            else if (packets > 1 && len)
+            {
+                if (cont || len > PROMPT_MAX_FRAME || prompt_grow(f, &cap) != RT_EOK)
+                    return;
+                f->offset[f->frames] = pkt;
+                f->length[f->frames++] = len;
+            }
+            packets++;
+            len = cont = 0;
+        }
+        pos += seg;
+    }
+}
+#endif
+
+static int prompt_index(prompt_file_t *f)
+{
+    int fd = open(f->path, O_RDONLY);
+
+    if (fd < 0)
+        return -RT_ERROR;
+    f->frames = 0;
+#ifdef PKG_LIB_OPUS
+    if (strstr(f->path, ".opus"))
+        prompt_index_opus(f, fd);
+    else
+#endif
+        prompt_index_mp3(f, fd);
+    close(fd);
+    if (!f->frames)
+    {
+        rt_free(f->offset);
+        rt_free(f->length);
+        f->offset = RT_NULL;
+        f->length = RT_NULL;
+        return -RT_ERROR;
+    }
+    return RT_EOK;
+}
+
+/* Opus is decoded straight at the speaker rate and to mono, whatever the
+ * stream carries; mp3 must already be at the speaker rate. */
+static void *prompt_decoder_open(prompt_file_t *f, uint32_t samplerate)
+{
+#ifdef PKG_LIB_OPUS
+    if (f->length)
+    {
+        int err;
+        OpusDecoder *opus = opus_decoder_create(samplerate, 1, &err);
+        if (!opus)
+            TRACE(TRACE_AUDIO, TRACE_WARN, "prompt opus at %d Hz: %d", samplerate, err);
+        return opus;
+    }
+#endif
+    if (f->samprate != samplerate)
+    {
+        TRACE(TRACE_AUDIO, TRACE_WARN, "prompt rate %d, speaker %d", f->samprate, samplerate);
+        return RT_NULL;
+    }
+    return MP3InitDecoder();
+}
+
+static void prompt_decoder_close(prompt_file_t *f, void *decoder)
+{
+#ifdef PKG_LIB_OPUS
+    if (f->length)
+    {
+        opus_decoder_destroy((OpusDecoder *)decoder);
+        return;
+    }
+#endif
+    MP3FreeDecoder((HMP3Decoder)decoder);
+}
+
+/* Returns the mono samples decoded from one frame, or < 0 to skip it. */
+static int prompt_decode(prompt_file_t *f, void *decoder, uint8_t *frame, uint32_t size,
+                         int16_t *pcm, uint32_t pcm_max)
+{
+    MP3FrameInfo info;
+    uint8_t *ptr = frame;
+    int left = size, samples, n;
+
+#ifdef PKG_LIB_OPUS
+    if (f->length)
+        return opus_decode((OpusDecoder *)decoder, frame, size, pcm, pcm_max, 0);
+#endif
+    // the first frames may reference a bit reservoir we never had
+    if (MP3Decode((HMP3Decoder)decoder, &ptr, &left, pcm, 0))
+        return -1;
+    MP3GetLastFrameInfo((HMP3Decoder)decoder, &info);
+    samples = info.outputSamps;
+    if (info.nChans == 2)
+    {
+        samples /= 2;
+        for (n = 0; n < samples; n++)
+            pcm[n] = (pcm[2 * n] + pcm[2 * n + 1]) / 2;
+    }
+    return samples;
+}
+
+static void prompt_run(prompt_t *thiz)
+{
+    prompt_file_t *f;
+    void *decoder;
+    uint8_t *frame;
+    int16_t *pcm;
+    rt_tick_t start;
+    uint32_t played_ms = 0, i, skip = 0, pcm_max = PROMPT_MP3_SAMPLES;
+    int fd;
+
+    if (!thiz->variants[thiz->id])
+        return;
+    thiz->seed = thiz->seed * 1103515245 + 12345;
+    f = &thiz->file[thiz->id][(thiz->seed >> 16) % thiz->variants[thiz->id]];
+    decoder = prompt_decoder_open(f, thiz->samplerate);
+    if (!decoder)
+        return;
+    if (f->length)
+    {
+        skip = f->pre_skip * thiz->samplerate / PROMPT_OPUS_RATE;
+        pcm_max = thiz->samplerate * PROMPT_OPUS_MAX_MS / 1000;
+    }
+    fd = open(f->path, O_RDONLY);
+    frame = rt_malloc(PROMPT_MAX_FRAME);
+    pcm = rt_malloc(pcm_max * sizeof(int16_t));
+    if (fd < 0 || !frame || !pcm)
+        goto Exit;
+
+    start = rt_tick_get();
+    for (i = 0; i < f->frames; i++)
+    {
+        uint32_t size = f->length ? f->length[i] : f->offset[i + 1] - f->offset[i];
+        int samples, n;
+
+        if (lseek(fd, f->offset[i], SEEK_SET) != f->offset[i] || read(fd, frame, size) != size)
+            break;
+        samples = prompt_decode(f, decoder, frame, size, pcm, pcm_max);
+        if (samples <= 0)
+            continue;
+        if (skip)
+        {
+            // opus encoder delay, not part of the prompt
+            n = skip < samples ? skip : samples;
+            memmove(pcm, pcm + n, (samples - n) * sizeof(int16_t));
+            samples -= n;
+            skip -= n;
+            if (!samples)
+                continue;
+        }
+
+        // stay just ahead of the speaker so a fade out is heard promptly
+        while (!thiz->is_fading && played_ms > PROMPT_LEAD_MS &&
+                (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND < played_ms - PROMPT_LEAD_MS)
+            rt_thread_mdelay(5);
+        if (thiz->is_fading)
+        {
+            // server audio is here, ramp this frame down and stop
+            for (n = 0; n < samples; n++)
+                pcm[n] = pcm[n] * (samples - n) / samples;
+        }
+        if (!audio_io_write(thiz->speaker, (uint8_t *)pcm, samples * sizeof(int16_t)))
+            break;
+        thiz->written += samples * sizeof(int16_t);
+        played_ms += samples * 1000 / thiz->samplerate;
+        if (thiz->is_fading)
+            break;
+    }
+    TRACE(TRACE_AUDIO, TRACE_INFO, "prompt %d played %d ms", thiz->id, played_ms);
+
+Exit:
+    prompt_decoder_close(f, decoder);
+    rt_free(frame);
+    rt_free(pcm);
+    if (fd >= 0)
+        close(fd);
+}
+
+static int prompt_is_audio(const char *name)
+{
+#ifdef PKG_LIB_OPUS
+    if (strstr(name, ".opus"))
+        return 1;
+#endif
+    return strstr(name, ".mp3") != RT_NULL;
+}
+
+static void prompt_entry(void *p)
+{
+    prompt_t *thiz = &g_prompt;
+
+    while (1)
+    {
+        rt_uint32_t evt = 0;
+        rt_event_recv(thiz->event, PROMPT_EVENT_PLAY, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                      RT_WAITING_FOREVER, &evt);
+        prompt_run(thiz);
+        thiz->is_playing = 0;
+        rt_sem_release(thiz->done);
+    }
+}
+
+int prompt_init(void)
+{
+    prompt_t *thiz = &g_prompt;
+    struct dirent *ent;
+    DIR *dir;
+    int id, count = 0;
+
+    if (thiz->thread)
+        return RT_EOK;
+    dir = opendir(VOLC_PROMPT_DIR);
+    if (!dir)
+    {
+        rt_kprintf("no prompts in %s\n", VOLC_PROMPT_DIR);
+        return -RT_ERROR;
+    }
+    while ((ent = readdir(dir)) != NULL)
+    {
+        for (id = 0; id < PROMPT_NUM; id++)
+        {
+            size_t len = strlen(prompt_name[id]);
+            prompt_file_t *f;
+
+            if (strncmp(ent->d_name, prompt_name[id], len) != 0 || !prompt_is_audio(ent->d_name + len)
+                    || thiz->variants[id] == PROMPT_VARIANTS)
+                continue;
+            f = &thiz->file[id][thiz->variants[id]];
+            rt_snprintf(f->path, PROMPT_PATH_LEN, "%s/%s", VOLC_PROMPT_DIR, ent->d_name);
+            if (prompt_index(f) == RT_EOK)
+            {
+                rt_kprintf("prompt %s: %d frames at %d Hz\n", f->path, f->frames, f->samprate);
+                thiz->variants[id]++;
+                count++;
+            }
+            break;
+        }
+    }
+    closedir(dir);
+    if (!count)
+        return -RT_ERROR;
+
+    thiz->seed = rt_tick_get();
+    thiz->event = rt_event_create("prompt", RT_IPC_FLAG_FIFO);
+    thiz->done = rt_sem_create("prompt", 0, RT_IPC_FLAG_FIFO);
+    // above the chat thread so the prompt starts right at commit
+    thiz->thread = rt_thread_create("prompt", prompt_entry, NULL, PROMPT_STACK_SIZE,
+                                    RT_THREAD_PRIORITY_MIDDLE + RT_THREAD_PRIORITY_HIGHER - 1,
+                                    RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->event && thiz->done && thiz->thread);
+    rt_thread_startup(thiz->thread);
+    return RT_EOK;
+}
+
+rt_err_t prompt_play(prompt_id_t id, audio_io_t *speaker, uint32_t samplerate)
+{
+    prompt_t *thiz = &g_prompt;
+
+    if (!thiz->thread || !speaker || thiz->is_playing)
+        return -RT_EBUSY;
+    rt_sem_control(thiz->done, RT_IPC_CMD_RESET, 0);
+    thiz->id = id;
+    thiz->speaker = speaker;
+    thiz->samplerate = samplerate;
+    thiz->written = 0;
+    thiz->is_fading = 0;
+    thiz->is_playing = 1;
+    rt_event_send(thiz->event, PROMPT_EVENT_PLAY);
+    return RT_EOK;
+}
+
+uint32_t prompt_fade_out(void)
+{
+    prompt_t *thiz = &g_prompt;
+    uint32_t written;
+
+    if (thiz->is_playing)
+    {
+        thiz->is_fading = 1;
+        rt_sem_take(thiz->done, PROMPT_FADE_TIMEOUT);
+    }
+    written = thiz->written;
+    thiz->written = 0;
+    return written;
+}
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file   prompt.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __PROMPT_H__
+#define __PROMPT_H__
+
+#include <rtthread.h>
+#include "audio_io.h"
+
+/*
+ * Local earcons and filler phrases, played while the server is thinking.
+ * Files live in VOLC_PROMPT_DIR as <name>.mp3 or <name><n>.mp3, up to four
+ * variants per prompt picked at random, e.g. /prompts/thinking2.mp3.
+ * MP3 must be MPEG layer III at the speaker rate; stereo is downmixed.
+ * With PKG_LIB_OPUS, Ogg Opus <name>.opus files are taken as well and
+ * decoded at the speaker rate, whatever rate they were encoded from.
+ * Frame offsets are indexed by prompt_init, so play only reads and decodes.
+ */
+typedef enum
+{
+    PROMPT_THINKING,    // after the turn is committed
+    PROMPT_ERROR,       // the turn could not be sent
+    PROMPT_NUM
+} prompt_id_t;
+
+int         prompt_init(void);
+rt_err_t    prompt_play(prompt_id_t id, audio_io_t *speaker, uint32_t samplerate);
+
+/* Fades the playing prompt out over one frame and waits for it.
+ * Returns the bytes the prompt wrote to the speaker. */
+uint32_t    prompt_fade_out(void);
+
+#endif /* __PROMPT_H__ */
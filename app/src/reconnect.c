@@ -0,0 +1,392 @@
+/**
+  ******************************************************************************
+  * @file   reconnect.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include "reconnect.h"
+#include "boot.h"
+
+#define LOG_TAG "reconn"
+#include "ulog.h"
+
+#define RECONN_BACKOFF_BASE_MS      500
+#define RECONN_BACKOFF_MAX_MS       30000
+#define RECONN_ATTEMPT_TIMEOUT_MS   15000
+
+#define RECONN_EVENT_CHANGED        (1 << 0)
+
+typedef enum
+{
+    RL_DOWN,
+    RL_CONNECTING,
+    RL_UP,
+} reconn_state_t;
+
+typedef struct
+{
+    reconn_action_t     action;
+    reconn_state_t      state;
+    uint32_t            first_delay_ms;
+    uint32_t            poll_ms;        // fixed retry of a readiness poll, 0 backs off
+    rt_tick_t           down_tick;      // start of the current outage
+    rt_tick_t           next_tick;      // next attempt, or attempt deadline when connecting
+    uint8_t             in_outage;      // layer was up before it went down
+    reconn_metrics_t    metrics;
+} reconn_layer_ctx_t;
+
+typedef struct
+{
+    rt_thread_t         thread;
+    rt_event_t          event;
+    uint32_t            seed;
+    reconn_layer_ctx_t  layer[RECONN_LAYER_NUM];
+} reconn_t;
+
+static reconn_t g_reconn;
+
+static const char *const layer_name[RECONN_LAYER_NUM] =
+{
+    "acl", "pan", "ip", "ws", "session"
+};
+
+static uint32_t reconn_rand(reconn_t *thiz)
+{
+    // xorshift32, seeded from the tick counter on first use
+    uint32_t x = thiz->seed ? thiz->seed : (rt_tick_get() | 1);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    thiz->seed = x;
+    return x;
+}
+
+/* Exponential backoff with "equal jitter": half the window is fixed, the
+ * other half random, so a fleet of units does not retry in lockstep. */
+static uint32_t reconn_backoff_ms(reconn_t *thiz, uint32_t attempts)
+{
+    uint32_t delay = RECONN_BACKOFF_MAX_MS;
+    if (attempts < 16)
+    {
+        delay = RECONN_BACKOFF_BASE_MS << attempts;
+        if (delay > RECONN_BACKOFF_MAX_MS)
+            delay = RECONN_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + reconn_rand(thiz) % (delay / 2 + 1);
+}
+
+static uint32_t reconn_retry_ms(reconn_t *thiz, reconn_layer_ctx_t *l)
+{
+    return l->poll_ms ? l->poll_ms : reconn_backoff_ms(thiz, l->metrics.attempts);
+}
+
+static int reconn_lower_up(reconn_t *thiz, int layer)
+{
+    for (int i = 0; i < layer; i++)
+    {
+        if (thiz->layer[i].state != RL_UP)
+            return 0;
+    }
+    return 1;
+}
+
+/* Called with interrupts disabled. */
+static void reconn_mark_down(reconn_t *thiz, int layer, rt_tick_t now)
+{
+    reconn_layer_ctx_t *l = &thiz->layer[layer];
+
+    if (l->state == RL_UP)
+    {
+        l->in_outage = 1;
+        l->down_tick = now;
+    }
+    if (l->state != RL_DOWN || !l->metrics.attempts)
+        l->next_tick = now + rt_tick_from_millisecond(l->first_delay_ms);
+    l->state = RL_DOWN;
+}
+
+static void reconn_run(reconn_t *thiz)
+{
+    rt_base_t level;
+    rt_tick_t now = rt_tick_get();
+
+    for (int i = 0; i < RECONN_LAYER_NUM; i++)
+    {
+        reconn_layer_ctx_t *l = &thiz->layer[i];
+        reconn_action_t action = RT_NULL;
+
+        level = rt_hw_interrupt_disable();
+        if (l->state == RL_CONNECTING && (rt_int32_t)(now - l->next_tick) >= 0)
+        {
+            // attempt timed out, back off and try again
+            l->state = RL_DOWN;
+            l->next_tick = now + rt_tick_from_millisecond(reconn_retry_ms(thiz, l));
+        }
+        if (l->state == RL_DOWN && l->action && reconn_lower_up(thiz, i)
+                && (rt_int32_t)(now - l->next_tick) >= 0)
+        {
+            l->state = RL_CONNECTING;
+            l->next_tick = now + rt_tick_from_millisecond(RECONN_ATTEMPT_TIMEOUT_MS);
+            l->metrics.attempts++;
+            action = l->action;
+        }
+        rt_hw_interrupt_enable(level);
+
+        if (action)
+        {
+            if (l->poll_ms)
+                LOG_D("%s: poll %d", layer_name[i], l->metrics.attempts);
+            else
+                LOG_I("%s: attempt %d", layer_name[i], l->metrics.attempts);
+            if (action((reconn_layer_t)i) != RT_EOK)
+            {
+                level = rt_hw_interrupt_disable();
+                if (l->state == RL_CONNECTING)
+                {
+                    l->state = RL_DOWN;
+                    l->next_tick = rt_tick_get() + rt_tick_from_millisecond(reconn_retry_ms(thiz, l));
+                }
+                rt_hw_interrupt_enable(level);
+            }
+            now = rt_tick_get();
+        }
+        if (l->state != RL_UP)
+            break;  // nothing above a down layer can make progress
+    }
+}
+
+static int32_t reconn_next_wait(reconn_t *thiz)
+{
+    rt_tick_t now = rt_tick_get();
+    int32_t wait = RT_WAITING_FOREVER;
+
+    for (int i = 0; i < RECONN_LAYER_NUM; i++)
+    {
+        reconn_layer_ctx_t *l = &thiz->layer[i];
+        if (l->state == RL_UP)
+            continue;
+        if (l->action || l->state == RL_CONNECTING)
+        {
+            int32_t left = (int32_t)(l->next_tick - now);
+            wait = left > 0 ? left : 0;
+        }
+        break;
+    }
+    return wait;
+}
+
+static void reconn_thread_entry(void *p)
+{
+    reconn_t *thiz = &g_reconn;
+    while (1)
+    {
+        rt_uint32_t evt = 0;
+        rt_event_recv(thiz->event, RECONN_EVENT_CHANGED, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                      reconn_next_wait(thiz), &evt);
+        reconn_run(thiz);
+    }
+}
+
+void reconnect_init(void)
+{
+    reconn_t *thiz = &g_reconn;
+
+    if (thiz->thread)
+        return;
+    thiz->event = rt_event_create("reconn", RT_IPC_FLAG_FIFO);
+    RT_ASSERT(thiz->event);
+    thiz->thread = rt_thread_create("reconn",
+                                    reconn_thread_entry,
+                                    NULL,
+                                    2048,
+                                    RT_THREAD_PRIORITY_MIDDLE,
+                                    RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->thread);
+    rt_thread_startup(thiz->thread);
+}
+
+void reconnect_register(reconn_layer_t layer, reconn_action_t action, uint32_t first_delay_ms)
+{
+    reconn_t *thiz = &g_reconn;
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+
+    rt_base_t level = rt_hw_interrupt_disable();
+    thiz->layer[layer].action = action;
+    thiz->layer[layer].first_delay_ms = first_delay_ms;
+    if (thiz->layer[layer].state == RL_DOWN)
+        thiz->layer[layer].next_tick = rt_tick_get() + rt_tick_from_millisecond(first_delay_ms);
+    rt_hw_interrupt_enable(level);
+    if (thiz->event)
+        rt_event_send(thiz->event, RECONN_EVENT_CHANGED);
+}
+
+/* The action only checks whether the layer came up by itself, retry it
+ * every poll_ms instead of backing off, so readiness is seen promptly. */
+void reconnect_set_poll(reconn_layer_t layer, uint32_t poll_ms)
+{
+    reconn_t *thiz = &g_reconn;
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+
+    thiz->layer[layer].poll_ms = poll_ms;
+}
+
+void reconnect_unregister(reconn_layer_t layer)
+{
+    reconn_t *thiz = &g_reconn;
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+
+    rt_base_t level = rt_hw_interrupt_disable();
+    thiz->layer[layer].action = RT_NULL;
+    if (thiz->layer[layer].state == RL_CONNECTING)
+        thiz->layer[layer].state = RL_DOWN;
+    thiz->layer[layer].in_outage = 0;
+    thiz->layer[layer].metrics.attempts = 0;
+    rt_hw_interrupt_enable(level);
+}
+
+void reconnect_notify_up(reconn_layer_t layer)
+{
+    reconn_t *thiz = &g_reconn;
+    reconn_layer_ctx_t *l = &thiz->layer[layer];
+    uint32_t ttr_ms = 0;
+    uint32_t attempts;
+    int recovered = 0;
+
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+    rt_base_t level = rt_hw_interrupt_disable();
+    attempts = l->metrics.attempts;
+    if (l->state != RL_UP && l->in_outage)
+    {
+        ttr_ms = (rt_tick_get() - l->down_tick) * 1000 / RT_TICK_PER_SECOND;
+        l->metrics.last_ttr_ms = ttr_ms;
+        if (ttr_ms > l->metrics.max_ttr_ms)
+            l->metrics.max_ttr_ms = ttr_ms;
+        l->metrics.total_ttr_ms += ttr_ms;
+        l->metrics.recover_count++;
+        recovered = 1;
+    }
+    l->state = RL_UP;
+    l->in_outage = 0;
+    l->metrics.attempts = 0;
+    rt_hw_interrupt_enable(level);
+
+    if (recovered)
+        LOG_I("%s: up, recovered in %d ms after %d attempts", layer_name[layer], ttr_ms, attempts);
+    else
+        LOG_I("%s: up", layer_name[layer]);
+    boot_mark(layer_name[layer]);
+    if (thiz->event)
+        rt_event_send(thiz->event, RECONN_EVENT_CHANGED);
+}
+
+void reconnect_notify_down(reconn_layer_t layer)
+{
+    reconn_t *thiz = &g_reconn;
+    rt_tick_t now = rt_tick_get();
+
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+    rt_base_t level = rt_hw_interrupt_disable();
+    int was_up = (thiz->layer[layer].state == RL_UP);
+    for (int i = layer; i < RECONN_LAYER_NUM; i++)
+        reconn_mark_down(thiz, i, now);
+    rt_hw_interrupt_enable(level);
+
+    if (was_up)
+        LOG_I("%s: down", layer_name[layer]);
+    if (thiz->event)
+        rt_event_send(thiz->event, RECONN_EVENT_CHANGED);
+}
+
+/* The attempt in progress failed early, retry after the backoff or poll
+ * delay instead of waiting for the attempt timeout. */
+void reconnect_notify_failed(reconn_layer_t layer)
+{
+    reconn_t *thiz = &g_reconn;
+    reconn_layer_ctx_t *l = &thiz->layer[layer];
+
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+    rt_base_t level = rt_hw_interrupt_disable();
+    if (l->state == RL_CONNECTING)
+    {
+        l->state = RL_DOWN;
+        l->next_tick = rt_tick_get() + rt_tick_from_millisecond(reconn_retry_ms(thiz, l));
+    }
+    rt_hw_interrupt_enable(level);
+
+    LOG_I("%s: attempt %d failed", layer_name[layer], l->metrics.attempts);
+    if (thiz->event)
+        rt_event_send(thiz->event, RECONN_EVENT_CHANGED);
+}
+
+int reconnect_is_up(reconn_layer_t layer)
+{
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+    return g_reconn.layer[layer].state == RL_UP;
+}
+
+void reconnect_get_metrics(reconn_layer_t layer, reconn_metrics_t *metrics)
+{
+    RT_ASSERT(layer < RECONN_LAYER_NUM);
+    rt_base_t level = rt_hw_interrupt_disable();
+    *metrics = g_reconn.layer[layer].metrics;
+    rt_hw_interrupt_enable(level);
+}
+
+static void reconn_stat(int argc, char **argv)
+{
+    static const char *const state_name[] = {"down", "connecting", "up"};
+
+    rt_kprintf("layer    state       recovered  attempts  last_ms  max_ms  avg_ms\n");
+    for (int i = 0; i < RECONN_LAYER_NUM; i++)
+    {
+        reconn_metrics_t m;
+        reconnect_get_metrics((reconn_layer_t)i, &m);
+        rt_kprintf("%-8s %-11s %-10d %-9d %-8d %-7d %d\n", layer_name[i],
+                   state_name[g_reconn.layer[i].state], m.recover_count, m.attempts,
+                   m.last_ttr_ms, m.max_ttr_ms,
+                   m.recover_count ? m.total_ttr_ms / m.recover_count : 0);
+    }
+}
+MSH_CMD_EXPORT(reconn_stat, Show link recovery state and time-to-recover);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file   reconnect.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __RECONNECT_H__
+#define __RECONNECT_H__
+
+#include <rtthread.h>
+
+/*
+ * Link layers supervised by the reconnect state machine, lowest first.
+ * A layer is only retried when every layer below it is up, and losing a
+ * layer takes every layer above it down with it.
+ */
+typedef enum
+{
+    RECONN_LAYER_ACL,
+    RECONN_LAYER_PAN,
+    RECONN_LAYER_IP,
+    RECONN_LAYER_WS,
+    RECONN_LAYER_SESSION,
+    RECONN_LAYER_NUM,
+} reconn_layer_t;
+
+/* Issue one recovery attempt, return RT_EOK if it was started. The layer
+ * is reported up later through reconnect_notify_up(). */
+typedef rt_err_t (*reconn_action_t)(reconn_layer_t layer);
+
+typedef struct
+{
+    uint32_t recover_count;     // number of completed recoveries
+    uint32_t attempts;          // attempts since the layer went down
+    uint32_t last_ttr_ms;       // time to recover of the last outage
+    uint32_t max_ttr_ms;
+    uint32_t total_ttr_ms;
+} reconn_metrics_t;
+
+void reconnect_init(void);
+void reconnect_register(reconn_layer_t layer, reconn_action_t action, uint32_t first_delay_ms);
+void reconnect_set_poll(reconn_layer_t layer, uint32_t poll_ms);
+void reconnect_unregister(reconn_layer_t layer);
+void reconnect_notify_up(reconn_layer_t layer);
+void reconnect_notify_down(reconn_layer_t layer);
+void reconnect_notify_failed(reconn_layer_t layer);
+int  reconnect_is_up(reconn_layer_t layer);
+void reconnect_get_metrics(reconn_layer_t layer, reconn_metrics_t *metrics);
+
+#endif /* __RECONNECT_H__ */
@@ -0,0 +1,299 @@
+/**
+  ******************************************************************************
+  * @file   rts.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "lwip/tcpip.h"
+#include "lwip/altcp.h"
+#include "rts.h"
+#include "capture.h"
+#include "trace.h"
+
+#define RTS_HDR_LEN             512
+#define RTS_SEND_RETRY          20      // 5 ms apart
+
+#define RTS_EVENT_SENT          (1 << 0)
+
+typedef err_t (*rts_ws_fn_t)(int code, char *buf, size_t len);
+
+static rts_t *g_rts[RTS_MAX];
+
+/* In front of the websocket client's receive, on the tcpip thread. While a
+ * session's worker is far behind, the data is refused: lwIP (or the TLS
+ * layer) keeps it, the receive window is not opened and the data is offered
+ * again from the TCP timer. The server slows down, nothing is lost and the
+ * tcpip thread never waits. */
+static err_t rts_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    int i;
+
+    for (i = 0; i < RTS_MAX; i++)
+    {
+        if (g_rts[i] && g_rts[i]->clnt.pcb == pcb)
+        {
+            if (p && downlink_backlogged(g_rts[i]->downlink))
+                return ERR_MEM;
+            return g_rts[i]->ws_recv(arg, pcb, p, err);
+        }
+    }
+    // not a session socket any more, nobody takes the data
+    if (p)
+        pbuf_free(p);
+    return ERR_OK;
+}
+
+static void rts_sent_wake(rts_t *s)
+{
+    rt_event_t notify = s->sent_notify;
+
+    rt_event_send(s->sent, RTS_EVENT_SENT);
+    if (notify)
+        rt_event_send(notify, s->sent_set);
+}
+
+/* The peer acked data, so send room came free: wakes a writer waiting
+ * in rts_wait_sndbuf(). */
+static err_t rts_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
+{
+    int i;
+
+    for (i = 0; i < RTS_MAX; i++)
+    {
+        if (g_rts[i] && g_rts[i]->clnt.pcb == pcb)
+        {
+            rts_sent_wake(g_rts[i]);
+            return g_rts[i]->ws_sent ? g_rts[i]->ws_sent(arg, pcb, len) : ERR_OK;
+        }
+    }
+    return ERR_OK;
+}
+
+static err_t rts_ws(rts_t *s, int code, char *buf, size_t len)
+{
+    if (code == WS_CONNECT)
+    {
+        int status = (uint16_t)(uint32_t)buf;
+        if (status == 101)  // wss setup success
+        {
+            // the client set its callbacks up with the connection, go in front of them
+            if (s->clnt.pcb && s->clnt.pcb->recv != rts_recv)
+            {
+                s->ws_recv = s->clnt.pcb->recv;
+                altcp_recv(s->clnt.pcb, rts_recv);
+            }
+            if (s->clnt.pcb && s->clnt.pcb->sent != rts_sent)
+            {
+                s->ws_sent = s->clnt.pcb->sent;
+                altcp_sent(s->clnt.pcb, rts_sent);
+            }
+            s->is_connected = 1;
+            s->is_connecting = 0;
+            if (s->on_link)
+                s->on_link(s->ctx, RTS_LINK_UP);
+            rt_sem_release(s->sem);
+        }
+    }
+    else if (code == WS_DISCONNECT)
+    {
+        rt_kprintf("WebSocket closed\n");
+        if (s->on_link && (s->is_connected || s->is_connecting))
+            s->on_link(s->ctx, s->is_connected ? RTS_LINK_DOWN : RTS_LINK_FAILED);
+        s->is_connected = 0;
+        s->is_connecting = 0;
+        rt_sem_release(s->sem);
+        rts_sent_wake(s);       // no room will come, stop waiting
+    }
+    else if (code == WS_TEXT)
+    {
+        // parsed on the session's worker, keep the tcpip thread free;
+        // a lost event may stall the turn until its timeout, so say so
+        rt_err_t err = downlink_post(s->downlink, buf, len);
+        if (err != RT_EOK)
+        {
+            s->rx_dropped++;
+            TRACE(TRACE_DOWNLINK, TRACE_ERR, "message of %d bytes dropped, err=%d", len, err);
+        }
+    }
+    else
+    {
+        rt_kprintf("Got Code=%d\n", code);
+    }
+    return 0;
+}
+
+#define RTS_TRAMPOLINE(n) \
+    static err_t rts_ws_##n(int code, char *buf, size_t len) { return rts_ws(g_rts[n], code, buf, len); }
+RTS_TRAMPOLINE(0)
+RTS_TRAMPOLINE(1)
+RTS_TRAMPOLINE(2)
+RTS_TRAMPOLINE(3)
+
+static const rts_ws_fn_t rts_trampoline[RTS_MAX] = {rts_ws_0, rts_ws_1, rts_ws_2, rts_ws_3};
+
+rt_err_t rts_init(rts_t *s, const char *name, uint8_t cap_flag, downlink_handler_t handler,
+                  rts_link_cb_t on_link, void *ctx)
+{
+    int i;
+
+    memset(s, 0, sizeof(rts_t));
+    s->cap_flag = cap_flag;
+    s->on_link = on_link;
+    s->ctx = ctx;
+    rt_enter_critical();
+    for (i = 0; i < RTS_MAX && g_rts[i]; i++)
+        ;
+    if (i < RTS_MAX)
+        g_rts[i] = s;
+    rt_exit_critical();
+    if (i == RTS_MAX)
+    {
+        rt_kprintf("rts: %s, all %d sessions taken\n", name, RTS_MAX);
+        return -RT_EFULL;
+    }
+    s->slot = i;
+    s->sem = rt_sem_create(name, 0, RT_IPC_FLAG_FIFO);
+    s->sent = rt_event_create(name, RT_IPC_FLAG_FIFO);
+    s->downlink = downlink_create(name, handler, ctx);
+    RT_ASSERT(s->sem && s->sent && s->downlink);
+    return RT_EOK;
+}
+
+err_t rts_connect(rts_t *s, const char *host, const char *path, const char *token)
+{
+    err_t err;
+
+    if (s->is_connected)
+    {
+        // stale socket left behind by a lower layer outage
+        s->is_connected = 0;
+        rts_close(s);
+    }
+    rt_sem_control(s->sem, RT_IPC_CMD_RESET, 0);
+    wsock_init(&s->clnt, 1, 1, rts_trampoline[s->slot]);
+    s->is_connecting = 1;
+    err = wsock_connect(&s->clnt, RTS_HDR_LEN, host, path, LWIP_IANA_PORT_HTTPS, token, NULL,
+                        "Content-Type: application/json\r\n");
+    rt_kprintf("Web socket connection %d\r\n", err);
+    if (err)
+        s->is_connecting = 0;
+    return err;
+}
+
+void rts_close(rts_t *s)
+{
+    LOCK_TCPIP_CORE();
+    wsock_close(&s->clnt, WSOCK_RESULT_OK, ERR_OK);
+    UNLOCK_TCPIP_CORE();
+}
+
+err_t rts_send_texts(rts_t *s, const char *const *msgs, int count)
+{
+    err_t err = ERR_OK;
+    int sent = 0, i;
+
+    for (i = 0; i < count; i++)
+        capture_record(CAP_WS_TX, s->cap_flag, msgs[i], strlen(msgs[i]));
+    // control messages are small and audio leaves them half the send
+    // buffer, so a full buffer only needs a short wait
+    for (int retry = 0; retry < RTS_SEND_RETRY; retry++)
+    {
+        LOCK_TCPIP_CORE();
+        while (sent < count)
+        {
+            err = wsock_write(&s->clnt, msgs[sent], strlen(msgs[sent]), OPCODE_TEXT);
+            if (err != ERR_OK)
+                break;
+            s->tx_msgs++;
+            s->tx_bytes += strlen(msgs[sent]);
+            sent++;
+        }
+        UNLOCK_TCPIP_CORE();
+        if (err != ERR_MEM)
+            break;
+        rt_thread_mdelay(5);
+    }
+    if (err != ERR_OK)
+        TRACE(TRACE_UPLINK, TRACE_ERR, "control message err=%d, %d sent", err, sent);
+    return err;
+}
+
+err_t rts_send_text(rts_t *s, const char *msg)
+{
+    return rts_send_texts(s, &msg, 1);
+}
+
+uint32_t rts_sndbuf(rts_t *s)
+{
+    uint32_t room = 0;
+
+    LOCK_TCPIP_CORE();
+    if (s->clnt.pcb)
+        room = altcp_sndbuf(s->clnt.pcb);
+    UNLOCK_TCPIP_CORE();
+    return room;
+}
+
+void rts_wait_sndbuf(rts_t *s, rt_int32_t ticks)
+{
+    rt_uint32_t evt;
+
+    if (ticks > 0)
+        rt_event_recv(s->sent, RTS_EVENT_SENT, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, ticks, &evt);
+}
+
+void rts_notify_sent(rts_t *s, rt_event_t event, rt_uint32_t set)
+{
+    // set first: the tcpip thread reads the event and then the bits
+    s->sent_set = set;
+    s->sent_notify = event;
+}
+
+const char *rts_json_string(cJSON *json, const char *key)
+{
+    cJSON *item = cJSON_GetObjectItem(json, key);
+
+    return item && item->valuestring ? item->valuestring : "";
+}
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file   rts.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __RTS_H__
+#define __RTS_H__
+
+#include <rtthread.h>
+#include "lwip/altcp.h"
+#include "lwip/apps/websocket_client.h"
+#include <cJSON.h>
+#include "downlink.h"
+
+#define RTS_MAX                 4       // sessions open at the same time
+
+typedef enum
+{
+    RTS_LINK_UP,            // websocket handshake done
+    RTS_LINK_DOWN,          // an open socket closed
+    RTS_LINK_FAILED,        // the connect attempt never got up
+} rts_link_t;
+
+/* Socket state changes, on the tcpip thread; keep them short. */
+typedef void (*rts_link_cb_t)(void *ctx, rts_link_t link);
+
+/*
+ * The part of a realtime websocket session every client has in common:
+ * connect and close, the tcpip callback, a downlink worker that hands text
+ * messages to the owner, and control message writes with their counters.
+ * The lwIP callback takes no context, so each session claims one of
+ * RTS_MAX trampolines that find it again. The protocol itself, what is
+ * sent and what the messages mean, stays with the owner.
+ */
+typedef struct
+{
+    wsock_state_t       clnt;
+    downlink_t          *downlink;
+    rt_sem_t            sem;        // connected, closed; the owner may post its own
+    rt_event_t          sent;       // data acked or socket closed, see rts_wait_sndbuf
+    altcp_recv_fn       ws_recv;    // the websocket client's own callbacks, rts goes in front
+    altcp_sent_fn       ws_sent;    // may be NULL
+    rt_event_t          sent_notify;    // the owner's event told the same, see rts_notify_sent
+    rt_uint32_t         sent_set;
+    rts_link_cb_t       on_link;
+    void                *ctx;
+    uint8_t             slot;
+    uint8_t             cap_flag;   // CAP_FLAG_* of the owner
+    volatile uint8_t    is_connected;
+    volatile uint8_t    is_connecting;
+    uint32_t            tx_msgs;
+    uint32_t            tx_bytes;
+    uint32_t            rx_dropped; // server messages lost before the worker
+} rts_t;
+
+/* Once per session for the life of the app. handler gets every text
+ * message on the worker thread named name. */
+rt_err_t    rts_init(rts_t *s, const char *name, uint8_t cap_flag, downlink_handler_t handler,
+                     rts_link_cb_t on_link, void *ctx);
+/* Closes a stale socket first. The result arrives as on_link and on sem. */
+err_t       rts_connect(rts_t *s, const char *host, const char *path, const char *token);
+void        rts_close(rts_t *s);
+
+/* Control messages back to back under one core lock, retried for a while
+ * when the send buffer is full. */
+err_t       rts_send_texts(rts_t *s, const char *const *msgs, int count);
+err_t       rts_send_text(rts_t *s, const char *msg);
+/* Free room in the socket send buffer, 0 when closed. */
+uint32_t    rts_sndbuf(rts_t *s);
+/* Sleeps until the peer acks data, so rts_sndbuf() may have grown, the
+ * socket closes or ticks pass. An ack since the last wait returns at once. */
+void        rts_wait_sndbuf(rts_t *s, rt_int32_t ticks);
+/* For an owner that waits on its own event instead: every ack and the
+ * close also send set to event, until called with NULL. */
+void        rts_notify_sent(rts_t *s, rt_event_t event, rt_uint32_t set);
+
+/* String member of a message, "" when it is missing. */
+const char  *rts_json_string(cJSON *json, const char *key);
+
+#endif /* __RTS_H__ */
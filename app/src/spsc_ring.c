@@ -0,0 +1,351 @@
+/**
+  ******************************************************************************
+  * @file   spsc_ring.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf0_hal.h"
+#include "spsc_ring.h"
+
+/* Indices run freely and wrap at 2^32, only the offset is masked. */
+
+int spsc_ring_init(spsc_ring_t *r, uint8_t *buf, uint32_t size)
+{
+    if (!buf || !size || (size & (size - 1)))
+        return -RT_EINVAL;
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->size = size;
+    r->mask = size - 1;
+    return RT_EOK;
+}
+
+spsc_ring_t *spsc_ring_create(uint32_t size)
+{
+    spsc_ring_t *r = rt_malloc_align(sizeof(spsc_ring_t), SPSC_CACHE_LINE);
+    uint8_t *buf = rt_malloc(size);
+
+    if (!r || !buf || spsc_ring_init(r, buf, size) != RT_EOK)
+    {
+        if (r)
+            rt_free_align(r);
+        if (buf)
+            rt_free(buf);
+        return NULL;
+    }
+    r->owns_buf = 1;
+    return r;
+}
+
+void spsc_ring_destroy(spsc_ring_t *r)
+{
+    if (!r)
+        return;
+    if (r->owns_buf)
+        rt_free(r->buf);
+    rt_free_align(r);
+}
+
+uint32_t spsc_ring_put(spsc_ring_t *r, const void *data, uint32_t len)
+{
+    uint32_t head = r->p.head;
+    uint32_t used = head - r->c.tail;
+    uint32_t off, first;
+
+    if (r->size - used < len)
+    {
+        r->p.dropped++;
+        r->p.dropped_bytes += len;
+        return 0;
+    }
+    off = head & r->mask;
+    first = r->size - off;
+    if (first > len)
+        first = len;
+    memcpy(r->buf + off, data, first);
+    memcpy(r->buf, (const uint8_t *)data + first, len - first);
+    __DMB();    // data visible before the new head
+    r->p.head = head + len;
+    if (used + len > r->p.peak)
+        r->p.peak = used + len;
+    return len;
+}
+
+uint32_t spsc_ring_get(spsc_ring_t *r, void *data, uint32_t len)
+{
+    uint32_t tail = r->c.tail;
+    uint32_t avail = r->p.head - tail;
+    uint32_t off, first;
+
+    __DMB();    // head read before the data it covers
+    if (len > avail)
+        len = avail;
+    if (!len)
+        return 0;
+    off = tail & r->mask;
+    first = r->size - off;
+    if (first > len)
+        first = len;
+    memcpy(data, r->buf + off, first);
+    memcpy((uint8_t *)data + first, r->buf, len - first);
+    __DMB();    // data copied out before the slot is released
+    r->c.tail = tail + len;
+    return len;
+}
+
+uint32_t spsc_ring_get_frame(spsc_ring_t *r, void *frame, uint32_t frame_len)
+{
+    if (spsc_ring_data_len(r) < frame_len)
+    {
+        r->c.underrun++;
+        return 0;
+    }
+    return spsc_ring_get(r, frame, frame_len);
+}
+
+void spsc_ring_reset(spsc_ring_t *r)
+{
+    r->c.tail = r->p.head;
+}
+
+uint8_t *spsc_ring_write_acquire(spsc_ring_t *r, uint32_t len)
+{
+    uint32_t head = r->p.head;
+    uint32_t space = r->size - (head - r->c.tail);
+    uint32_t off = head & r->mask;
+    uint32_t pad = 0;
+
+    if (r->size - off < len)
+    {
+        pad = r->size - off;    // too little room before the end, start over at 0
+        off = 0;
+    }
+    if (!len || space < pad + len)
+        return NULL;
+    r->p.lend_pad = pad;
+    return r->buf + off;
+}
+
+void spsc_ring_write_commit(spsc_ring_t *r, uint32_t len)
+{
+    uint32_t head = r->p.head;
+    uint32_t pad = r->p.lend_pad;
+    uint32_t used;
+
+    if (!len)
+        return;
+    if (pad)
+    {
+        r->p.skip_from = head;
+        r->p.pad_bytes += pad;
+        r->p.lend_pad = 0;
+    }
+    __DMB();    // data and skip_from visible before the new head
+    r->p.head = head + pad + len;
+    used = head + pad + len - r->c.tail;
+    if (used > r->p.peak)
+        r->p.peak = used;
+}
+
+const uint8_t *spsc_ring_read_acquire(spsc_ring_t *r, uint32_t max, uint32_t *len)
+{
+    uint32_t tail = r->c.tail;
+    uint32_t avail = r->p.head - tail;
+    uint32_t skip, off, n;
+
+    __DMB();    // head read before skip_from and the data it covers
+    skip = r->p.skip_from;
+    if (!(skip & r->mask))
+        skip = tail - 1;    // never set, padding never starts at offset 0
+    if (avail && skip == tail)
+    {
+        // padding left by a wrapped lent write, nothing to read there
+        n = r->size - (tail & r->mask);
+        tail += n;
+        avail -= n;
+        __DMB();
+        r->c.tail = tail;
+    }
+    if (!avail)
+    {
+        *len = 0;
+        return NULL;
+    }
+    off = tail & r->mask;
+    n = r->size - off;
+    if (n > avail)
+        n = avail;
+    if (skip - tail < n)
+        n = skip - tail;
+    if (n > max)
+        n = max;
+    *len = n;
+    return r->buf + off;
+}
+
+void spsc_ring_read_release(spsc_ring_t *r, uint32_t len)
+{
+    __DMB();    // data consumed before the slot is released
+    r->c.tail += len;
+}
+
+/* Stress test: producer and consumer at random rates, checks every byte. */
+#define SPSC_STRESS_RING    1024
+#define SPSC_STRESS_FRAME   64
+
+typedef struct
+{
+    spsc_ring_t *ring;
+    rt_sem_t    done;
+    uint32_t    deadline;
+    uint32_t    produced;
+    uint32_t    consumed;
+    uint32_t    errors;
+    uint8_t     lend;               // use lent writes and reads instead of copies
+    volatile uint8_t producer_done;
+} spsc_stress_t;
+
+static uint32_t spsc_stress_rand(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static void spsc_stress_producer(void *p)
+{
+    spsc_stress_t *t = (spsc_stress_t *)p;
+    uint8_t frame[SPSC_STRESS_FRAME];
+    uint32_t seed = 0x1234567, seq = 0;
+
+    while ((rt_int32_t)(rt_tick_get() - t->deadline) < 0)
+    {
+        uint32_t len = 1 + spsc_stress_rand(&seed) % SPSC_STRESS_FRAME;
+        uint8_t *dst = t->lend ? spsc_ring_write_acquire(t->ring, SPSC_STRESS_FRAME) : frame;
+
+        if (!dst)
+            len = 0;
+        for (uint32_t i = 0; i < len; i++)
+            dst[i] = (uint8_t)(seq + i);
+        if (t->lend)
+            spsc_ring_write_commit(t->ring, len);
+        if (len && (t->lend || spsc_ring_put(t->ring, frame, len)))
+        {
+            seq += len;
+            t->produced += len;
+        }
+        if (spsc_stress_rand(&seed) % 4 == 0)
+            rt_thread_delay(spsc_stress_rand(&seed) % 3);
+    }
+    t->producer_done = 1;
+    rt_sem_release(t->done);
+}
+
+static void spsc_stress_consumer(void *p)
+{
+    spsc_stress_t *t = (spsc_stress_t *)p;
+    uint8_t frame[SPSC_STRESS_FRAME];
+    uint32_t seed = 0x7654321, seq = 0;
+
+    while (!t->producer_done || spsc_ring_data_len(t->ring))
+    {
+        uint32_t max = 1 + spsc_stress_rand(&seed) % SPSC_STRESS_FRAME;
+        const uint8_t *src = frame;
+        uint32_t len;
+
+        if (t->lend)
+            src = spsc_ring_read_acquire(t->ring, max, &len);
+        else
+            len = spsc_ring_get(t->ring, frame, max);
+        for (uint32_t i = 0; i < len; i++)
+        {
+            if (src[i] != (uint8_t)(seq + i))
+                t->errors++;
+        }
+        if (t->lend)
+            spsc_ring_read_release(t->ring, len);
+        seq += len;
+        t->consumed += len;
+        if (!len || spsc_stress_rand(&seed) % 4 == 0)
+            rt_thread_delay(spsc_stress_rand(&seed) % 3);
+    }
+    rt_sem_release(t->done);
+}
+
+static void spsc_stress(int argc, char **argv)
+{
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 10;
+    spsc_stress_t t = {0};
+    rt_thread_t prod, cons;
+
+    t.lend = argc > 2 && strcmp(argv[2], "lend") == 0;
+    t.ring = spsc_ring_create(SPSC_STRESS_RING);
+    t.done = rt_sem_create("spsc", 0, RT_IPC_FLAG_FIFO);
+    if (!t.ring || !t.done)
+        goto Exit;
+    t.deadline = rt_tick_get() + rt_tick_from_millisecond(seconds * 1000);
+    // producer above consumer, like the mic callback and the encoder thread
+    prod = rt_thread_create("spsc_p", spsc_stress_producer, &t, 1024, RT_THREAD_PRIORITY_MIDDLE, 2);
+    cons = rt_thread_create("spsc_c", spsc_stress_consumer, &t, 1024, RT_THREAD_PRIORITY_MIDDLE + 1, 2);
+    RT_ASSERT(prod && cons);
+    rt_thread_startup(prod);
+    rt_thread_startup(cons);
+    rt_sem_take(t.done, RT_WAITING_FOREVER);
+    rt_sem_take(t.done, RT_WAITING_FOREVER);
+
+    rt_kprintf("spsc: %s, produced %d consumed %d bytes, %d errors\n",
+               (t.errors || t.produced != t.consumed) ? "FAIL" : "PASS", t.produced, t.consumed, t.errors);
+    rt_kprintf("spsc: %d writes dropped (%d bytes), peak fill %d/%d\n",
+               t.ring->p.dropped, t.ring->p.dropped_bytes, t.ring->p.peak, SPSC_STRESS_RING);
+    if (t.lend)
+        rt_kprintf("spsc: %d bytes of wrap padding skipped\n", t.ring->p.pad_bytes);
+Exit:
+    if (t.done)
+        rt_sem_delete(t.done);
+    spsc_ring_destroy(t.ring);
+}
+MSH_CMD_EXPORT(spsc_stress, spsc_stress [seconds] [lend]: stress the lock free audio ring);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file   spsc_ring.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <rtthread.h>
+#include <stdint.h>
+
+#define SPSC_CACHE_LINE     32
+
+/*
+ * Single producer, single consumer byte ring, no locks. The producer only
+ * writes head, the consumer only writes tail, and each index sits on its own
+ * cache line. Writes are all or nothing, so a frame is never split by an
+ * overrun; rejected writes are counted instead.
+ */
+typedef struct
+{
+    struct
+    {
+        volatile uint32_t   head;
+        uint32_t            dropped;        // writes rejected, ring full
+        uint32_t            dropped_bytes;
+        uint32_t            peak;           // highest fill seen by the producer
+        volatile uint32_t   skip_from;      // lent write wrapped, bytes from here to the end are padding
+        uint32_t            lend_pad;       // padding the pending lent write needs
+        uint32_t            pad_bytes;      // total padding skipped by lent writes
+    } p ALIGN(SPSC_CACHE_LINE);
+    struct
+    {
+        volatile uint32_t   tail;
+        uint32_t            underrun;       // reads that found too little data
+    } c ALIGN(SPSC_CACHE_LINE);
+    uint8_t     *buf;
+    uint32_t    size;                       // power of two
+    uint32_t    mask;
+    uint8_t     owns_buf;
+} spsc_ring_t;
+
+int         spsc_ring_init(spsc_ring_t *r, uint8_t *buf, uint32_t size);
+spsc_ring_t *spsc_ring_create(uint32_t size);
+void        spsc_ring_destroy(spsc_ring_t *r);
+
+/* Producer side. */
+uint32_t    spsc_ring_put(spsc_ring_t *r, const void *data, uint32_t len);
+
+/*
+ * Lent writes: the producer fills the ring in place, e.g. a decoder writing
+ * its output straight into it. acquire returns len contiguous bytes, skipping
+ * the tail of the buffer when the region would wrap, or NULL if the ring is
+ * too full. commit publishes the bytes actually written (at most len). A ring
+ * written this way must be read with the lent reads below, which know about
+ * the skipped tail.
+ */
+uint8_t     *spsc_ring_write_acquire(spsc_ring_t *r, uint32_t len);
+void        spsc_ring_write_commit(spsc_ring_t *r, uint32_t len);
+
+/* Consumer side. */
+uint32_t    spsc_ring_get(spsc_ring_t *r, void *data, uint32_t len);
+uint32_t    spsc_ring_get_frame(spsc_ring_t *r, void *frame, uint32_t frame_len);
+void        spsc_ring_reset(spsc_ring_t *r);
+
+/* Lent reads: up to max contiguous bytes in place, released once consumed. */
+const uint8_t *spsc_ring_read_acquire(spsc_ring_t *r, uint32_t max, uint32_t *len);
+void        spsc_ring_read_release(spsc_ring_t *r, uint32_t len);
+
+static inline uint32_t spsc_ring_data_len(const spsc_ring_t *r)
+{
+    return r->p.head - r->c.tail;
+}
+
+static inline uint32_t spsc_ring_space_len(const spsc_ring_t *r)
+{
+    return r->size - (r->p.head - r->c.tail);
+}
+
+#endif /* __SPSC_RING_H__ */
@@ -0,0 +1,221 @@
+/**
+  ******************************************************************************
+  * @file   stats.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "stats.h"
+
+#define LOG_TAG "stats"
+#include "ulog.h"
+
+#ifndef VOLC_STATS_PERIOD_MS
+    #define VOLC_STATS_PERIOD_MS    60000
+#endif
+
+/* Threads whose stack margin matters, the same names list_thread shows. */
+static const char *const stats_threads[] =
+{
+    "doubchat", "chat_dsp", "chat_dl", "tts", "tts_dl", "mixer", "prompt", "kws",
+    "tcpip",
+};
+
+typedef struct
+{
+    rt_tick_t   tick;
+    uint32_t    tx_msgs;
+    uint32_t    tx_bytes;
+    uint32_t    rx_msgs;
+    uint32_t    rx_bytes;
+} stats_mark_t;
+
+typedef struct
+{
+    uint32_t    msgs_per_s[2];      // tx, rx
+    uint32_t    bytes_per_s[2];
+} stats_rate_t;
+
+static stats_mark_t g_stats_cmd;    // last `volc_stats`
+static stats_mark_t g_stats_log;    // last periodic snapshot
+
+void stats_ring(stats_ring_t *s, const spsc_ring_t *r)
+{
+    s->fill = spsc_ring_data_len(r);
+    s->peak = r->p.peak;
+    s->size = r->size;
+    s->dropped_bytes = r->p.dropped_bytes;
+    s->underrun = r->c.underrun;
+}
+
+static void stats_collect(volc_stats_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    chat_stats(s);
+    tts_stats(s);
+    mixer_stats(s);
+}
+
+/* Rates since the previous call on the same mark. */
+static void stats_rate(stats_mark_t *m, const volc_stats_t *s, stats_rate_t *r)
+{
+    rt_tick_t now = rt_tick_get();
+    uint32_t ms = (now - m->tick) * 1000 / RT_TICK_PER_SECOND;
+
+    if (!ms)
+        ms = 1;
+    r->msgs_per_s[0] = (s->tx_msgs - m->tx_msgs) * 1000 / ms;
+    r->msgs_per_s[1] = (s->rx_msgs - m->rx_msgs) * 1000 / ms;
+    r->bytes_per_s[0] = (uint32_t)((uint64_t)(s->tx_bytes - m->tx_bytes) * 1000 / ms);
+    r->bytes_per_s[1] = (uint32_t)((uint64_t)(s->rx_bytes - m->rx_bytes) * 1000 / ms);
+    m->tick = now;
+    m->tx_msgs = s->tx_msgs;
+    m->tx_bytes = s->tx_bytes;
+    m->rx_msgs = s->rx_msgs;
+    m->rx_bytes = s->rx_bytes;
+}
+
+/* Deepest stack use so far, from the '#' fill the kernel put there. -1 if
+ * the thread is not running. */
+static int stats_stack_used(const char *name, uint32_t *size)
+{
+    rt_thread_t t;
+    uint8_t *p;
+    int used = -1;
+
+    rt_enter_critical();    // the thread can not go away while its stack is scanned
+    t = rt_thread_find((char *)name);
+    if (t)
+    {
+        p = (uint8_t *)t->stack_addr;
+        while (p < (uint8_t *)t->stack_addr + t->stack_size && *p == '#')
+            p++;
+        used = t->stack_size - (p - (uint8_t *)t->stack_addr);
+        *size = t->stack_size;
+    }
+    rt_exit_critical();
+    return used;
+}
+
+static void stats_print_ring(const char *name, const stats_ring_t *r)
+{
+    rt_kprintf("%-8s %6d %6d %6d %8d %8d\n", name, r->fill, r->peak, r->size, r->dropped_bytes, r->underrun);
+}
+
+static void volc_stats(int argc, char **argv)
+{
+    volc_stats_t s;
+    stats_rate_t r;
+    rt_uint32_t total, used, max_used;
+    uint32_t size;
+    int i, n;
+
+    stats_collect(&s);
+    stats_rate(&g_stats_cmd, &s, &r);
+    rt_memory_info(&total, &used, &max_used);
+
+    rt_kprintf("ring       fill   peak   size  dropped underrun\n");
+    stats_print_ring("mic", &s.mic);
+    stats_print_ring("raw", &s.raw);
+    stats_print_ring("ref", &s.ref);
+    stats_print_ring("mp3", &s.mp3);
+    stats_print_ring("pcm", &s.pcm);
+    for (i = 0; i < MIXER_CHANNELS; i++)
+    {
+        if (s.mix[i].size)
+            stats_print_ring(s.mix_name[i], &s.mix[i]);
+    }
+    rt_kprintf("speaker: chat cache ~%d bytes, tts cache full %d times\n", s.chat_cache, s.tts_cache_full);
+    rt_kprintf("socket: %d bytes queued to send\n", s.sndq);
+    rt_kprintf("tx: %d msgs %d bytes, %d msg/s %d B/s\n", s.tx_msgs, s.tx_bytes, r.msgs_per_s[0], r.bytes_per_s[0]);
+    rt_kprintf("rx: %d msgs %d bytes, %d msg/s %d B/s, %d dropped\n", s.rx_msgs, s.rx_bytes,
+               r.msgs_per_s[1], r.bytes_per_s[1], s.rx_dropped);
+    rt_kprintf("heap: %d used, %d peak, %d total\n", used, max_used, total);
+    for (i = 0; i < sizeof(stats_threads) / sizeof(stats_threads[0]); i++)
+    {
+        n = stats_stack_used(stats_threads[i], &size);
+        if (n >= 0)
+            rt_kprintf("stack %-8s %5d/%d\n", stats_threads[i], n, size);
+    }
+}
+MSH_CMD_EXPORT(volc_stats, voice pipeline buffers heap and thread health);
+
+static void stats_entry(void *p)
+{
+    volc_stats_t s;
+    stats_rate_t r;
+    rt_uint32_t total, used, max_used;
+    uint32_t size;
+    int chat, tts, tcpip;
+
+    while (1)
+    {
+        rt_thread_mdelay(VOLC_STATS_PERIOD_MS);
+        stats_collect(&s);
+        stats_rate(&g_stats_log, &s, &r);
+        rt_memory_info(&total, &used, &max_used);
+        chat = stats_stack_used("doubchat", &size);
+        tts = stats_stack_used("tts", &size);
+        tcpip = stats_stack_used("tcpip", &size);
+        LOG_I("mic %d/%d drop %d, mp3 %d/%d drop %d, pcm %d/%d, spk %d, sndq %d",
+              s.mic.fill, s.mic.peak, s.mic.dropped_bytes, s.mp3.fill, s.mp3.peak, s.mp3.dropped_bytes,
+              s.pcm.fill, s.pcm.peak, s.chat_cache, s.sndq);
+        LOG_I("tx %d B/s %d msg/s, rx %d B/s %d msg/s, heap %d peak %d, stack chat %d tts %d tcpip %d",
+              r.bytes_per_s[0], r.msgs_per_s[0], r.bytes_per_s[1], r.msgs_per_s[1], used, max_used,
+              chat, tts, tcpip);
+    }
+}
+
+void stats_init(void)
+{
+    rt_thread_t thread;
+
+    g_stats_log.tick = rt_tick_get();
+    g_stats_cmd.tick = g_stats_log.tick;
+    if (!VOLC_STATS_PERIOD_MS)
+        return;
+    thread = rt_thread_create("stats", stats_entry, NULL, 1536, RT_THREAD_PRIORITY_LOW, RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thread);
+    rt_thread_startup(thread);
+}
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
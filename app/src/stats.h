@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * @file   stats.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <rtthread.h>
+#include "spsc_ring.h"
+#include "mixer.h"
+
+typedef struct
+{
+    uint32_t    fill;
+    uint32_t    peak;
+    uint32_t    size;
+    uint32_t    dropped_bytes;      // writes refused, ring full
+    uint32_t    underrun;           // reads that found too little data
+} stats_ring_t;
+
+/*
+ * Health snapshot of the voice pipeline. Every field is read from counters
+ * the pipeline keeps anyway, so collecting it costs nothing on the hot path.
+ */
+typedef struct
+{
+    stats_ring_t    mic;            // chat uplink
+    stats_ring_t    raw;            // chat codec mic, waiting for the dsp thread
+    stats_ring_t    ref;            // chat echo reference, full duplex only
+    stats_ring_t    mp3;            // tts downlink
+    stats_ring_t    pcm;            // tts decoder output
+    stats_ring_t    mix[MIXER_CHANNELS]; // speaker channels, size 0 when closed
+    char            mix_name[MIXER_CHANNELS][MIXER_NAME_LEN];
+    uint32_t        chat_cache;     // estimated audio_server cache fill, chat speaker
+    uint32_t        tts_cache_full; // tts audio_write found the cache full
+    uint32_t        sndq;           // chat bytes waiting in the TCP send buffer
+    uint32_t        tx_msgs;
+    uint32_t        tx_bytes;
+    uint32_t        rx_msgs;
+    uint32_t        rx_bytes;
+    uint32_t        rx_dropped;     // server messages lost before parsing
+} volc_stats_t;
+
+void    stats_ring(stats_ring_t *s, const spsc_ring_t *r);
+
+/* Filled in by the pipeline modules, adding to what is already there. */
+void    chat_stats(volc_stats_t *s);
+void    tts_stats(volc_stats_t *s);
+void    mixer_stats(volc_stats_t *s);
+
+/* Starts the periodic ulog snapshot, VOLC_STATS_PERIOD_MS 0 disables it. */
+void    stats_init(void);
+
+#endif /* __STATS_H__ */
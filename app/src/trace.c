@@ -0,0 +1,272 @@
+/**
+  ******************************************************************************
+  * @file   trace.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+#define TRACE_DEPTH             256     // power of two, 20 bytes per event
+#define TRACE_RATE_DEFAULT      50      // events per second per category
+#define TRACE_STREAM_PERIOD     100     // ms between stream thread drains
+
+typedef struct
+{
+    rt_tick_t   tick;
+    uint8_t     cat;
+    uint8_t     level;
+    uint16_t    seq;
+    const char  *fmt;
+    uint32_t    a;
+    uint32_t    b;
+} trace_event_t;
+
+typedef struct
+{
+    trace_event_t   ring[TRACE_DEPTH];
+    uint32_t        head;               // total events written
+    uint32_t        streamed;           // next event for the stream thread
+    uint16_t        rate[TRACE_CAT_NUM];
+    uint16_t        window_count[TRACE_CAT_NUM];
+    rt_tick_t       window_start[TRACE_CAT_NUM];
+    uint32_t        suppressed[TRACE_CAT_NUM];
+    uint32_t        written[TRACE_CAT_NUM];
+    rt_thread_t     stream_thread;
+    volatile uint8_t is_streaming;
+} trace_t;
+
+static const char *const trace_cat_name[TRACE_CAT_NUM] =
+{
+    "chat", "uplink", "downlink", "audio", "tts",
+};
+
+static const char trace_level_char[] = "EWID";
+
+uint8_t g_trace_level[TRACE_CAT_NUM] =
+{
+    TRACE_INFO, TRACE_INFO, TRACE_INFO, TRACE_INFO, TRACE_INFO,
+};
+
+static trace_t g_trace;
+
+void trace_write(trace_cat_t cat, trace_level_t level, const char *fmt, uint32_t a, uint32_t b)
+{
+    trace_t *thiz = &g_trace;
+    rt_tick_t now = rt_tick_get();
+    trace_event_t *ev;
+    rt_base_t mask;
+    uint16_t rate;
+
+    mask = rt_hw_interrupt_disable();
+    rate = thiz->rate[cat] ? thiz->rate[cat] : TRACE_RATE_DEFAULT;
+    if (now - thiz->window_start[cat] >= RT_TICK_PER_SECOND)
+    {
+        thiz->window_start[cat] = now;
+        thiz->window_count[cat] = 0;
+    }
+    // errors always get through, a storm of them is exactly what to keep
+    if (level > TRACE_ERR && thiz->window_count[cat] >= rate)
+    {
+        thiz->suppressed[cat]++;
+        rt_hw_interrupt_enable(mask);
+        return;
+    }
+    thiz->window_count[cat]++;
+    thiz->written[cat]++;
+    ev = &thiz->ring[thiz->head & (TRACE_DEPTH - 1)];
+    ev->tick = now;
+    ev->cat = cat;
+    ev->level = level;
+    ev->seq = (uint16_t)thiz->head;
+    ev->fmt = fmt;
+    ev->a = a;
+    ev->b = b;
+    thiz->head++;
+    rt_hw_interrupt_enable(mask);
+}
+
+static void trace_print(const trace_event_t *ev)
+{
+    rt_kprintf("[%8d %c %s] ", ev->tick * 1000 / RT_TICK_PER_SECOND, trace_level_char[ev->level],
+               trace_cat_name[ev->cat]);
+    rt_kprintf(ev->fmt, ev->a, ev->b);
+    rt_kprintf("\n");
+}
+
+/* Copies event idx out of the ring, fails if it was overwritten meanwhile. */
+static int trace_read(trace_t *thiz, uint32_t idx, trace_event_t *ev)
+{
+    rt_base_t mask = rt_hw_interrupt_disable();
+    int ok = thiz->head - idx <= TRACE_DEPTH && idx != thiz->head;
+
+    if (ok)
+        *ev = thiz->ring[idx & (TRACE_DEPTH - 1)];
+    rt_hw_interrupt_enable(mask);
+    return ok;
+}
+
+static void trace_stream_entry(void *p)
+{
+    trace_t *thiz = &g_trace;
+    trace_event_t ev;
+
+    while (thiz->is_streaming)
+    {
+        if (thiz->head - thiz->streamed > TRACE_DEPTH)
+        {
+            rt_kprintf("trace: %d events lost\n", thiz->head - thiz->streamed - TRACE_DEPTH);
+            thiz->streamed = thiz->head - TRACE_DEPTH;
+        }
+        while (thiz->streamed != thiz->head && trace_read(thiz, thiz->streamed, &ev))
+        {
+            trace_print(&ev);
+            thiz->streamed++;
+        }
+        rt_thread_mdelay(TRACE_STREAM_PERIOD);
+    }
+    thiz->stream_thread = NULL;
+}
+
+static int trace_cat_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TRACE_CAT_NUM; i++)
+    {
+        if (strcmp(name, trace_cat_name[i]) == 0)
+            return i;
+    }
+    if (strcmp(name, "all") == 0)
+        return TRACE_CAT_NUM;
+    rt_kprintf("unknown category %s\n", name);
+    return -1;
+}
+
+static void trace(int argc, char **argv)
+{
+    trace_t *thiz = &g_trace;
+    trace_event_t ev;
+    int i;
+
+    if (argc >= 2 && strcmp(argv[1], "dump") == 0)
+    {
+        uint32_t n = argc > 2 ? atoi(argv[2]) : TRACE_DEPTH;
+        uint32_t idx;
+
+        if (n > TRACE_DEPTH)
+            n = TRACE_DEPTH;
+        if (n > thiz->head)
+            n = thiz->head;
+        for (idx = thiz->head - n; idx != thiz->head; idx++)
+        {
+            if (trace_read(thiz, idx, &ev))
+                trace_print(&ev);
+        }
+    }
+    else if (argc >= 4 && (strcmp(argv[1], "level") == 0 || strcmp(argv[1], "rate") == 0))
+    {
+        int cat = trace_cat_find(argv[2]);
+        int value = atoi(argv[3]);
+
+        if (argv[1][0] == 'l' && value > TRACE_DEBUG)
+            value = TRACE_DEBUG;
+
+        if (cat < 0)
+            return;
+        for (i = 0; i < TRACE_CAT_NUM; i++)
+        {
+            if (cat != TRACE_CAT_NUM && cat != i)
+                continue;
+            if (argv[1][0] == 'l')
+                g_trace_level[i] = value;
+            else
+                thiz->rate[i] = value;
+        }
+    }
+    else if (argc >= 3 && strcmp(argv[1], "stream") == 0)
+    {
+        if (strcmp(argv[2], "on") == 0 && !thiz->stream_thread)
+        {
+            thiz->streamed = thiz->head;
+            thiz->is_streaming = 1;
+            // lowest useful priority, the console may block but nothing waits on it
+            thiz->stream_thread = rt_thread_create("trace", trace_stream_entry, NULL, 1024,
+                                                   RT_THREAD_PRIORITY_LOW + 4, RT_THREAD_TICK_DEFAULT);
+            RT_ASSERT(thiz->stream_thread);
+            rt_thread_startup(thiz->stream_thread);
+        }
+        else if (strcmp(argv[2], "off") == 0)
+        {
+            thiz->is_streaming = 0;
+        }
+    }
+    else if (argc >= 2 && strcmp(argv[1], "clear") == 0)
+    {
+        rt_base_t mask = rt_hw_interrupt_disable();
+        thiz->head = thiz->streamed = 0;
+        memset(thiz->written, 0, sizeof(thiz->written));
+        memset(thiz->suppressed, 0, sizeof(thiz->suppressed));
+        rt_hw_interrupt_enable(mask);
+    }
+    else if (argc >= 2 && strcmp(argv[1], "stat") == 0)
+    {
+        for (i = 0; i < TRACE_CAT_NUM; i++)
+        {
+            rt_kprintf("%-9s level %c rate %d/s: %d written %d suppressed\n", trace_cat_name[i],
+                       trace_level_char[g_trace_level[i] & 3], thiz->rate[i] ? thiz->rate[i] : TRACE_RATE_DEFAULT,
+                       thiz->written[i], thiz->suppressed[i]);
+        }
+        rt_kprintf("ring %d/%d events, streaming %s\n", thiz->head < TRACE_DEPTH ? thiz->head : TRACE_DEPTH,
+                   TRACE_DEPTH, thiz->is_streaming ? "on" : "off");
+    }
+    else
+    {
+        rt_kprintf("usage: trace dump [n] | level <cat|all> <0-3> | rate <cat|all> <per_s>\n"
+                   "       trace stream on|off | clear | stat\n");
+        rt_kprintf("levels: 0 err 1 warn 2 info 3 debug\n");
+    }
+}
+MSH_CMD_EXPORT(trace, trace dump|level|rate|stream|clear|stat: audio path event trace);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file   trace.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <rtthread.h>
+#include <stdint.h>
+
+/*
+ * Binary trace for the audio path. An event is a timestamp, a format string
+ * and two integer arguments, written into a RAM ring without formatting.
+ * Text is produced only by `trace dump` or the low priority stream thread,
+ * so tracing never waits on the console.
+ *
+ * The format string is stored by pointer and must be a literal; %s is not
+ * supported because the argument may be gone by the time it is printed.
+ */
+typedef enum
+{
+    TRACE_CHAT,         // session and turn state
+    TRACE_UPLINK,       // mic audio and control messages sent
+    TRACE_DOWNLINK,     // server messages received
+    TRACE_AUDIO,        // speaker and decoder
+    TRACE_TTS,
+    TRACE_CAT_NUM
+} trace_cat_t;
+
+typedef enum
+{
+    TRACE_ERR,
+    TRACE_WARN,
+    TRACE_INFO,
+    TRACE_DEBUG,
+} trace_level_t;
+
+extern uint8_t g_trace_level[TRACE_CAT_NUM];
+
+void trace_write(trace_cat_t cat, trace_level_t level, const char *fmt, uint32_t a, uint32_t b);
+
+#define TRACE(cat, level, fmt, a, b)                                                \
+    do                                                                              \
+    {                                                                               \
+        if ((level) <= g_trace_level[cat])                                          \
+            trace_write(cat, level, fmt, (uint32_t)(a), (uint32_t)(b));             \
+    } while (0)
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,469 @@
+/**
+  ******************************************************************************
+  * @file   tsm.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <rtthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tsm.h"
+#include "cycle_counter.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    #define TSM_DSP         1
+#endif
+
+#define TSM_SCORE_BITS      20              // correlation kept for the normalized compare
+
+static int tsm_bitlen64(uint64_t v)
+{
+    int n = 0;
+
+    if (v >> 32)
+    {
+        n = 32;
+        v >>= 32;
+    }
+#ifdef TSM_DSP
+    return v ? n + 32 - __CLZ((uint32_t)v) : n;
+#else
+    while (v)
+    {
+        n++;
+        v >>= 1;
+    }
+    return n;
+#endif
+}
+
+/* Dot product of n int16 pairs, n even, any alignment. */
+static inline int64_t tsm_dot(const int16_t *a, const int16_t *b, int n)
+{
+    int64_t acc = 0;
+    int i;
+
+#ifdef TSM_DSP
+    for (i = 0; i < n; i += 2)
+    {
+        uint32_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        acc = (int64_t)__SMLALD(x, y, (uint64_t)acc);
+    }
+#else
+    for (i = 0; i < n; i++)
+        acc += (int32_t)a[i] * b[i];
+#endif
+    return acc;
+}
+
+/* corr^2 / energy compared without a division: a beats b when
+ * ca|ca| eb > cb|cb| ea. Both are scaled by the same shift first, which
+ * keeps them under TSM_SCORE_BITS since |corr| is at most the larger
+ * energy of the two windows. */
+static int tsm_better(int64_t ca, int64_t ea, int64_t cb, int64_t eb, int shift)
+{
+    int64_t qa = ca >> shift, qb = cb >> shift;
+
+    ea = (ea >> shift) + 1;
+    eb = (eb >> shift) + 1;
+    return qa * (qa < 0 ? -qa : qa) * eb > qb * (qb < 0 ? -qb : qb) * ea;
+}
+
+/* Segment start in [lo, hi] whose TSM_HOP samples best continue the
+ * waveform at pos. Every other candidate is tried, then the neighbours of
+ * the best; ties keep nominal. */
+static int tsm_seek(const tsm_t *t, int lo, int hi, int nominal)
+{
+    const int16_t *b = t->buf;
+    const int16_t *x = t->buf + t->pos;
+    int64_t e, emax, c, best_c, best_e;
+    int k, best, shift;
+
+    // pass 1: the largest window energy sets the score scale
+    emax = tsm_dot(x, x, TSM_HOP);
+    e = tsm_dot(b + lo, b + lo, TSM_HOP);
+    for (k = lo; k <= hi; k += 2)
+    {
+        if (k > lo)
+            e += (int32_t)b[k + TSM_HOP - 2] * b[k + TSM_HOP - 2] + (int32_t)b[k + TSM_HOP - 1] * b[k + TSM_HOP - 1]
+                 - (int32_t)b[k - 2] * b[k - 2] - (int32_t)b[k - 1] * b[k - 1];
+        if (e > emax)
+            emax = e;
+    }
+    shift = tsm_bitlen64((uint64_t)emax) - TSM_SCORE_BITS;
+    if (shift < 0)
+        shift = 0;
+
+    // pass 2: coarse search
+    best = nominal;
+    best_e = tsm_dot(b + best, b + best, TSM_HOP);
+    best_c = tsm_dot(b + best, x, TSM_HOP);
+    e = tsm_dot(b + lo, b + lo, TSM_HOP);
+    for (k = lo; k <= hi; k += 2)
+    {
+        if (k > lo)
+            e += (int32_t)b[k + TSM_HOP - 2] * b[k + TSM_HOP - 2] + (int32_t)b[k + TSM_HOP - 1] * b[k + TSM_HOP - 1]
+                 - (int32_t)b[k - 2] * b[k - 2] - (int32_t)b[k - 1] * b[k - 1];
+        c = tsm_dot(b + k, x, TSM_HOP);
+        if (tsm_better(c, e, best_c, best_e, shift))
+        {
+            best = k;
+            best_c = c;
+            best_e = e;
+        }
+    }
+
+    // refine between the coarse steps
+    lo = best - 1 < lo ? lo : best - 1;
+    hi = best + 1 > hi ? hi : best + 1;
+    for (k = lo; k <= hi; k += 2)
+    {
+        if (k == best)
+            continue;
+        e = tsm_dot(b + k, b + k, TSM_HOP);
+        c = tsm_dot(b + k, x, TSM_HOP);
+        if (tsm_better(c, e, best_c, best_e, shift))
+        {
+            best = k;
+            best_c = c;
+            best_e = e;
+        }
+    }
+    return best;
+}
+
+/* Drops what no later hop can reach: before the continuation, and before
+ * the earliest segment start a search may try. */
+static void tsm_compact(tsm_t *t)
+{
+    int lo = t->nom + TSM_HOP - TSM_SEEK;
+
+    if (lo > t->pos)
+        lo = t->pos;
+    if (lo <= 0)
+        return;
+    memmove(t->buf, t->buf + lo, (t->len - lo) * sizeof(int16_t));
+    t->len -= lo;
+    t->pos -= lo;
+    t->nom -= lo;
+}
+
+static uint16_t tsm_speed(tsm_t *t, uint32_t backlog)
+{
+    int32_t excess = (int32_t)(backlog - t->target);
+    int32_t want = TSM_SPEED_ONE;
+    int32_t speed = t->speed;
+
+    if (t->target && !t->fast && excess > TSM_ENGAGE)
+    {
+        t->fast = 1;
+        t->catchups++;
+    }
+    else if (t->fast && (!t->target || excess <= 0))
+    {
+        t->fast = 0;
+    }
+    if (t->fast)
+    {
+        want = TSM_SPEED_ONE + (excess < TSM_FULL ? excess : TSM_FULL) * (TSM_SPEED_MAX - TSM_SPEED_ONE) / TSM_FULL;
+        if (want < TSM_SPEED_MIN)
+            want = TSM_SPEED_MIN;
+    }
+    // glide, a jump in speed is heard as a jump in tempo
+    if (want > speed)
+        speed = speed + TSM_SLEW < want ? speed + TSM_SLEW : want;
+    else
+        speed = speed - TSM_SLEW > want ? speed - TSM_SLEW : want;
+    return (uint16_t)speed;
+}
+
+void tsm_init(tsm_t *t)
+{
+    memset(t, 0, sizeof(tsm_t));
+    t->nom = -TSM_HOP;
+    t->speed = TSM_SPEED_ONE;
+}
+
+void tsm_set_target(tsm_t *t, uint32_t target)
+{
+    t->target = target;
+}
+
+int16_t *tsm_in(tsm_t *t, uint32_t *room)
+{
+    *room = TSM_BUF - t->len;
+    return t->buf + t->len;
+}
+
+void tsm_in_done(tsm_t *t, uint32_t n)
+{
+    t->len += n;
+}
+
+uint32_t tsm_buffered(const tsm_t *t)
+{
+    return t->len - t->pos;
+}
+
+int tsm_process(tsm_t *t, uint32_t backlog, int16_t *out)
+{
+    const int16_t *x, *y;
+    int32_t step, nom;
+    int lo, hi, seg, n;
+
+    if (t->len - t->pos < TSM_HOP)
+        return 0;
+    t->speed = tsm_speed(t, backlog);
+    step = TSM_HOP * t->speed + t->nom_frac;
+    nom = t->nom + (step >> 12);
+    if (t->speed == TSM_SPEED_ONE || nom + TSM_SEEK + TSM_HOP > t->len)
+    {
+        // normal speed, or too little queued for a search: a plain copy
+        memcpy(out, t->buf + t->pos, TSM_HOP * sizeof(int16_t));
+        t->pos += TSM_HOP;
+        t->nom = t->pos - TSM_HOP;
+        t->nom_frac = 0;
+        t->hops++;
+        tsm_compact(t);
+        return 1;
+    }
+
+    lo = nom - TSM_SEEK > 0 ? nom - TSM_SEEK : 0;
+    hi = nom + TSM_SEEK;
+    seg = tsm_seek(t, lo, hi, nom);
+    x = t->buf + t->pos;
+    y = t->buf + seg;
+    for (n = 0; n < TSM_HOP; n++)
+    {
+        int32_t w = (n << 15) / TSM_HOP;
+        out[n] = (int16_t)(((int32_t)x[n] * (32768 - w) + (int32_t)y[n] * w + 16384) >> 15);
+    }
+    t->skipped += seg - t->pos;
+    t->pos = seg + TSM_HOP;
+    t->nom = nom;
+    t->nom_frac = step & 0xfff;
+    t->hops++;
+    t->fast_hops++;
+    tsm_compact(t);
+    return 1;
+}
+
+uint32_t tsm_drain(tsm_t *t, int16_t *out)
+{
+    uint32_t n = t->len - t->pos;
+
+    if (n > TSM_HOP)
+        n = TSM_HOP;
+    memcpy(out, t->buf + t->pos, n * sizeof(int16_t));
+    t->pos += n;
+    t->nom = t->pos - TSM_HOP;
+    tsm_compact(t);
+    return n;
+}
+
+#define TSM_TEST_TARGET     3200            // 200 ms
+#define TSM_TEST_TICKS      3000            // 30 s of 10 ms hops
+#define TSM_TEST_STALL_AT   200
+#define TSM_TEST_PI         3.14159265358979f
+
+static float tsm_test_noise(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return ((int32_t)(*seed >> 16) - 32768) / 18918.0f;    // unit rms
+}
+
+/* Voiced syllables with a gliding pitch and some breath, at sample i. */
+static int16_t tsm_test_voice(uint32_t i, float f0, uint32_t *seed)
+{
+    float t = i / 16000.0f, v = 0;
+    int hop = i / TSM_HOP, pos = hop % 50, h;
+
+    if (pos >= 30)
+        return (int16_t)lrintf(30.0f * tsm_test_noise(seed));
+    f0 *= 0.8f + 0.1f * ((hop / 50 * 7) % 5);
+    f0 += 20.0f * sinf(2 * TSM_TEST_PI * 0.7f * t);
+    for (h = 1; h * f0 < 3500.0f; h++)
+        v += sinf(2 * TSM_TEST_PI * h * f0 * t) / h;
+    v += 0.3f * tsm_test_noise(seed);
+    return (int16_t)lrintf(v * 3000.0f * sinf(TSM_TEST_PI * (pos * TSM_HOP + (i % TSM_HOP)) / (30 * TSM_HOP)));
+}
+
+/* Autocorrelation period of n samples, in samples, between 40 and 320. */
+static int tsm_test_period(const int16_t *x, int n)
+{
+    int64_t best = 0, c;
+    int lag, i, period = 0;
+
+    for (lag = 40; lag <= 320; lag++)
+    {
+        for (c = 0, i = 0; i + lag < n; i++)
+            c += (int32_t)x[i] * x[i + lag];
+        if (c > best)
+        {
+            best = c;
+            period = lag;
+        }
+    }
+    return period;
+}
+
+/* A network stall of stall_ms, then everything it held at once. The
+ * consumer plays a hop every tick through the stage, so what the stall
+ * took beyond the target is latency until the stage wins it back. */
+static void tsm_test_run(tsm_t *t, uint32_t stall_ms, int16_t *out)
+{
+    uint32_t seed = 1, made = TSM_TEST_TARGET, fed = 0, backlog = 0, peak = 0;
+    uint32_t stall = stall_ms / 10, start, cycles, max = 0;
+    uint64_t total = 0, total_fast = 0;
+    int tick, converge = -1;
+
+    tsm_init(t);
+    tsm_set_target(t, TSM_TEST_TARGET);
+    for (tick = 0; tick < TSM_TEST_TICKS; tick++)
+    {
+        uint32_t room, n, i, fast = t->fast_hops;
+        int16_t *in;
+
+        // arrivals: 10 ms a tick, none during the stall, then the lot
+        if (tick < TSM_TEST_STALL_AT || tick >= TSM_TEST_STALL_AT + stall)
+            made += TSM_HOP;
+        if (tick == TSM_TEST_STALL_AT + stall)
+            made += stall * TSM_HOP;
+        in = tsm_in(t, &room);
+        n = made - fed < room ? made - fed : room;
+        for (i = 0; i < n; i++)
+            in[i] = tsm_test_voice(fed + i, 120.0f, &seed);
+        tsm_in_done(t, n);
+        fed += n;
+        backlog = made - fed + tsm_buffered(t);
+        if (backlog > peak)
+            peak = backlog;
+
+        rt_enter_critical();
+        start = cycle_counter_get();
+        tsm_process(t, backlog, out);
+        cycles = cycle_counter_get() - start;
+        rt_exit_critical();
+        total += cycles;
+        if (cycles > max)
+            max = cycles;
+        if (t->fast_hops != fast)
+            total_fast += cycles;
+        if (tick > TSM_TEST_STALL_AT + stall && converge < 0 && !t->fast && t->speed == TSM_SPEED_ONE)
+            converge = tick - TSM_TEST_STALL_AT - stall;
+    }
+    rt_kprintf("tsm: stall %4d ms, %4d ms over target, back at 1x %5d ms after it, %d ms skipped, "
+               "cycles avg %u max %u, %u a fast hop\n",
+               stall_ms, peak > TSM_TEST_TARGET ? (peak - TSM_TEST_TARGET) / 16 : 0,
+               converge < 0 ? -1 : converge * 10, t->skipped / 16, (uint32_t)(total / TSM_TEST_TICKS),
+               max, t->fast_hops ? (uint32_t)(total_fast / t->fast_hops) : 0);
+}
+
+/* A steady vowel played at full speed keeps its period; resampling
+ * would shorten it by the speed. */
+static void tsm_test_pitch(tsm_t *t, int16_t *out, int16_t *played, float f0)
+{
+    uint32_t seed = 1, fed = 0, room, n, i;
+    int hop, period_in, period_out;
+    int16_t *in;
+
+    tsm_init(t);
+    tsm_set_target(t, TSM_TEST_TARGET);
+    for (hop = 0; hop < 100; hop++)
+    {
+        in = tsm_in(t, &room);
+        for (n = 0; n < room; n++)
+        {
+            float v = 0, x = (fed + n) / 16000.0f;
+            int h;
+
+            for (h = 1; h * f0 < 3500.0f; h++)
+                v += sinf(2 * TSM_TEST_PI * h * f0 * x) / h;
+            in[n] = (int16_t)lrintf(v * 3000.0f + 30.0f * tsm_test_noise(&seed));
+        }
+        tsm_in_done(t, room);
+        fed += room;
+        tsm_process(t, 4 * TSM_TEST_TARGET, out);
+        if (hop >= 96)
+            memcpy(played + (hop - 96) * TSM_HOP, out, TSM_HOP * sizeof(int16_t));
+    }
+    period_out = tsm_test_period(played, 4 * TSM_HOP);
+    for (i = 0; i < 4 * TSM_HOP; i++)
+        played[i] = (int16_t)lrintf(3000.0f * sinf(2 * TSM_TEST_PI * f0 * i / 16000.0f));
+    period_in = tsm_test_period(played, 4 * TSM_HOP);
+    rt_kprintf("tsm: %3d Hz vowel at %d/4096 speed, period %d samples in, %d out\n",
+               (int)f0, t->speed, period_in, period_out);
+}
+
+/* tsm_test [stall_ms]: catch up after network stalls on synthetic speech. */
+static void tsm_test(int argc, char **argv)
+{
+    static const uint32_t stalls[] = {100, 300, 1000, 3000};
+    tsm_t *t = rt_malloc(sizeof(tsm_t));
+    int16_t *out = rt_malloc(5 * TSM_HOP * sizeof(int16_t));
+    int i;
+
+    if (!t || !out)
+    {
+        rt_kprintf("tsm_test: no memory\n");
+        goto Exit;
+    }
+    cycle_counter_init();
+    if (argc > 1)
+        tsm_test_run(t, atoi(argv[1]), out);
+    else
+    {
+        for (i = 0; i < sizeof(stalls) / sizeof(stalls[0]); i++)
+            tsm_test_run(t, stalls[i], out);
+        tsm_test_pitch(t, out, out + TSM_HOP, 110.0f);
+        tsm_test_pitch(t, out, out + TSM_HOP, 220.0f);
+    }
+Exit:
+    rt_free(t);
+    rt_free(out);
+}
+MSH_CMD_EXPORT(tsm_test, tsm_test [stall_ms]: playback catch up after a network stall);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file   tsm.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TSM_H__
+#define __TSM_H__
+
+#include <stdint.h>
+
+/*
+ * Pitch preserving time compression for a playback channel that fell
+ * behind, WSOLA in 10 ms hops of 16 kHz mono. Each hop cross-fades the
+ * natural continuation of the last segment into the input segment near
+ * the position the speed asks for that best matches it, so whole pitch
+ * periods are skipped rather than the waveform resampled. While the
+ * backlog is above target by TSM_ENGAGE the speed rises with the excess
+ * up to TSM_SPEED_MAX, and the stage returns to a plain copy at target.
+ */
+#define TSM_HOP             160             // output samples per hop
+#define TSM_SEEK            96              // ± samples searched, one pitch period down to 83 Hz
+#define TSM_BUF             (2 * TSM_HOP + 3 * TSM_SEEK)
+#define TSM_SPEED_ONE       4096            // Q12
+#define TSM_SPEED_MIN       4352            // 1.06x, the slowest catch up
+#define TSM_SPEED_MAX       5120            // 1.25x
+#define TSM_ENGAGE          640             // excess backlog that starts a catch up, 40 ms
+#define TSM_FULL            3200            // excess played at TSM_SPEED_MAX, 200 ms
+#define TSM_SLEW            32              // speed change per hop, Q12
+
+typedef struct
+{
+    int16_t     buf[TSM_BUF];               // input, compacted every hop
+    uint16_t    len;                        // samples in buf
+    uint16_t    pos;                        // next sample of the natural continuation
+    int16_t     nom;                        // start of the last segment as the speed put it
+    uint16_t    nom_frac;                   // Q12 remainder of nom
+    uint16_t    speed;                      // Q12, of the last hop
+    uint8_t     fast;                       // catching up
+    uint32_t    target;                     // backlog in samples that plays at 1x
+    // statistics
+    uint32_t    hops;
+    uint32_t    fast_hops;
+    int32_t     skipped;                    // input samples not played
+    uint32_t    catchups;
+} tsm_t;
+
+void     tsm_init(tsm_t *t);
+/* Backlog in samples, counted by the caller upstream plus tsm_buffered,
+ * that plays at normal speed; 0 keeps the stage a plain copy. */
+void     tsm_set_target(tsm_t *t, uint32_t target);
+/* Room for input: write up to *room samples there, then tsm_in_done. */
+int16_t  *tsm_in(tsm_t *t, uint32_t *room);
+void     tsm_in_done(tsm_t *t, uint32_t n);
+/* Input samples not played yet. */
+uint32_t tsm_buffered(const tsm_t *t);
+/* One TSM_HOP of output; 0 with less than a hop buffered. */
+int      tsm_process(tsm_t *t, uint32_t backlog, int16_t *out);
+/* The tail under a hop, as is. Returns samples written to out. */
+uint32_t tsm_drain(tsm_t *t, int16_t *out);
+
+#endif /* __TSM_H__ */
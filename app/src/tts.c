@@ -48,14 +48,24 @@
 #include "lwip/apps/mqtt_priv.h"
 #include "lwip/apps/mqtt.h"
 #include "lwip/tcpip.h"
-#include "mbedtls/base64.h"
+#include "b64.h"
 #include "bf0_hal.h"
 #include "bts2_global.h"
 #include "bts2_app_pan.h"
 #include <cJSON.h>
 #include "button.h"
 #include "audio_server.h"
+#include "dfs_posix.h"
 #include "mem_section.h"
+#include "link_policy.h"
+#include "ui.h"
+#include "capture.h"
+#include "spsc_ring.h"
+#include "rts.h"
+#include "trace.h"
+#include "stats.h"
+#include "audio_io.h"
+#include "pipeline.h"
 
 #if PKG_USING_LIBHELIX
     #include "mp3dec.h"
@@ -63,8 +73,13 @@
 #error "should config PKG_USING_LIBHELIX"
 #endif
 
-#define MAX_WSOCK_HDR_LEN 512
-#define MAX_AUDIO_DATA_LEN (4096 * 2)
+#define MAX_AUDIO_DATA_LEN PIPE_TTS_DELTA_BYTES
+#define TTS_MP3_RING_SIZE  PIPE_TTS_MP3_RING     // power of two, holds a full delta
+#define TTS_PCM_RING_SIZE  PIPE_TTS_PCM_RING     // power of two, decoder output waiting for audio_write
+#define TTS_PCM_FRAME_MAX  (sizeof(short) * MAX_NCHAN * MAX_NGRAN * MAX_NSAMP)
+#define TTS_URI_LEN        64            // `tts -o` sink name
+#define TTS_SPEAKER        "mix:1:tts"   // over chat, which ducks under it
+#define TTS_FILE_CHUNK     2048          // mp3 bytes read per step when playing a file
 
 
 #define TTS_HOST            "ai-gateway.vei.volces.com"
@@ -78,10 +93,16 @@
 
 #define TTS_EVENT_ALL           (TTS_EVENT_DECODE)
 
+// the decoder writes a whole frame at the ring start and refills below MAINBUF_SIZE
+PIPE_ASSERT(TTS_PCM_RING_SIZE >= TTS_PCM_FRAME_MAX, tts_pcm_ring_holds_a_frame);
+PIPE_ASSERT(MP3_MAIN_BUFFER_SIZE >= 2 * MAINBUF_SIZE, tts_main_buffer_refills);
+PIPE_ASSERT(TTS_MP3_RING_SIZE >= MAX_AUDIO_DATA_LEN, tts_mp3_ring_holds_a_delta);
+
 typedef struct
 {
     rt_thread_t     thread;
-    struct rt_ringbuffer *rb_mp3;
+    spsc_ring_t     *rb_mp3;
+    spsc_ring_t     *rb_pcm;        // MP3Decode writes here in place
     rt_event_t      event;
     uint32_t        sample_rate;
     uint8_t         *main_ptr;
@@ -89,15 +110,22 @@ typedef struct
     HMP3Decoder     decode_handle;
     uint8_t         base64_out[MAX_AUDIO_DATA_LEN];
     uint8_t         main_buf[MP3_MAIN_BUFFER_SIZE];
-    uint8_t         decode_out[sizeof(short) * MAX_NCHAN * MAX_NGRAN * MAX_NSAMP];
-    audio_client_t  speaker;
+    audio_io_t      *speaker;
+    char            out_uri[TTS_URI_LEN];   // empty: the codec
 
     uint32_t        event_id;
-    wsock_state_t   clnt;
-    rt_sem_t        sem;
-    uint8_t         is_connected;
     uint8_t         is_end;
     uint8_t         is_exit;
+
+    uint32_t        pcm_bytes;      // decoded in place this utterance
+    uint32_t        pcm_written;    // of it copied into the speaker by audio_io_write
+    uint32_t        pcm_chunk;      // bytes per decoded frame, audio_write granule
+    uint32_t        pcm_full;       // audio_write found the cache full
+
+    int             render_fd;      // >= 0: deltas go to this file, not the speaker
+    uint32_t        render_bytes;
+    rt_tick_t       render_start;
+    uint8_t         render_done;
 } tts_ws_t;
 
 #if defined(__CC_ARM) || defined(__CLANG_ARM)
@@ -112,10 +140,17 @@ typedef struct
 static int audio_callback_func(audio_server_callback_cmt_t cmd, void *callback_userdata, uint32_t reserved)
 {
     tts_ws_t *thiz = callback_userdata;
+    if (capture_active())
+    {
+        uint8_t c = (uint8_t)cmd;
+        capture_record(CAP_AUDIO_EVENT, CAP_FLAG_TTS, &c, 1);
+    }
     if (cmd == as_callback_cmd_cache_half_empty || cmd == as_callback_cmd_cache_empty )
     {
         //rt_event_send(thiz->event, TTS_EVENT_DECODE);
     }
+    if (cmd == as_callback_cmd_cache_empty && !thiz->is_end)
+        ui_note_audio_underrun();
     return 0;
 }
 
@@ -128,50 +163,22 @@ static void speaker_on(tts_ws_t *thiz)
         pa.write_channnel_num = 1;
         pa.read_bits_per_sample = 16;
         pa.read_channnel_num = 1;
-        pa.write_samplerate = 16000;
-        pa.read_samplerate = 16000;
-        pa.write_cache_size = 4096;
-        thiz->speaker = audio_open(AUDIO_TYPE_LOCAL_MUSIC, AUDIO_TX, &pa, audio_callback_func, thiz);
+        pa.write_samplerate = PIPE_RATE;
+        pa.read_samplerate = PIPE_RATE;
+        pa.write_cache_size = PIPE_TTS_CACHE;
+        thiz->speaker = audio_io_open_sink(thiz->out_uri[0] ? thiz->out_uri : TTS_SPEAKER, &pa, audio_callback_func, thiz);
     }
 }
 static void speaker_off(tts_ws_t *thiz)
 {
     if (thiz->speaker)
     {
-        audio_close(thiz->speaker);
+        audio_io_close(thiz->speaker);
         thiz->speaker = NULL;
     }
 }
-void parse_response(const u8_t *data, u16_t len);
-
-static err_t my_wsapp_fn(int code, char *buf, size_t len)
-{
-    if (code == WS_CONNECT)
-    {
-        int status = (uint16_t)(uint32_t)buf;
-        if (status == 101)  // wss setup success
-        {
-            rt_sem_release(g_tts_ws.sem);
-            g_tts_ws.is_connected = 1;
-        }
-    }
-    else if (code == WS_DISCONNECT)
-    {
-        rt_kprintf("WebSocket closed\n");
-        g_tts_ws.is_connected = 0;
-        rt_sem_release(g_tts_ws.sem);
-    }
-    else if (code == WS_TEXT)
-    {
-        rt_kprintf("Got Text:%d", len);
-        parse_response(buf, len);
-    }
-    else
-    {
-        RT_ASSERT(0);
-    }
-    return 0;
-}
+static void parse_response(void *ctx, const char *data, size_t len);
+static rts_t g_tts_rts;             // outlives the per command state, for rates
 
 static void xz_button_event_handler(int32_t pin, button_action_t action)
 {
@@ -201,30 +208,71 @@ static void xz_button_init(void)
         cfg.mode = PIN_MODE_INPUT;
         cfg.button_handler = xz_button_event_handler;
         int32_t id = button_init(&cfg);
-        RT_ASSERT(id >= 0);
-        RT_ASSERT(SF_EOK == button_enable(id));
         initialized = 1;
+        if (id < 0)
+        {
+            // chat claims the key during boot, tts then runs without it
+            rt_kprintf("tts: key in use, button disabled\n");
+            return;
+        }
+        RT_ASSERT(SF_EOK == button_enable(id));
     }
 }
-static void audio_write_and_wait(tts_ws_t *thiz, uint8_t *data, uint32_t data_len)
+/* Hands decoded PCM to the audio server straight from the ring, one frame
+ * at a time so a nearly full cache still takes it. Returns bytes accepted. */
+static uint32_t tts_pcm_drain(tts_ws_t *thiz)
 {
-    int ret;
-    while (!thiz->is_exit)
+    uint32_t total = 0, len;
+    const uint8_t *pcm;
+
+    while ((pcm = spsc_ring_read_acquire(thiz->rb_pcm, thiz->pcm_chunk, &len)) != NULL)
     {
-        ret = audio_write(thiz->speaker, data, data_len);
-        if (ret)
+        if (!audio_io_write(thiz->speaker, (uint8_t *)pcm, len))
         {
+            thiz->pcm_full++;
             break;
         }
+        spsc_ring_read_release(thiz->rb_pcm, len);
+        total += len;
+    }
+    thiz->pcm_written += total;
+    return total;
+}
+
+/* Lends the decoder room for one frame, playing out what is queued until the
+ * ring has it. NULL when exiting. */
+static short *tts_pcm_acquire(tts_ws_t *thiz)
+{
+    uint8_t *out;
 
-        rt_thread_mdelay(10);
+    // the next frame may be larger than the last one (mono to stereo, MPEG-2
+    // to MPEG-1), so always lend room for the largest; commit takes the real size
+    while (!(out = spsc_ring_write_acquire(thiz->rb_pcm, TTS_PCM_FRAME_MAX)))
+    {
+        if (thiz->is_exit)
+            return NULL;
+        if (!tts_pcm_drain(thiz))
+            rt_thread_mdelay(10);
     }
+    return (short *)out;
+}
+
+static void tts_pcm_report(tts_ws_t *thiz)
+{
+    uint32_t rate = thiz->sample_rate ? thiz->sample_rate : PIPE_RATE;
+    uint32_t ms = (uint32_t)((uint64_t)thiz->pcm_bytes * 1000 / (rate * sizeof(short)));
+
+    // decoded straight into rb_pcm, the one copy is the write into the speaker
+    rt_kprintf("tts: %d ms audio, %d bytes decoded in place, %d written to the speaker, cache full %d\n",
+               ms, thiz->pcm_bytes, thiz->pcm_written, thiz->pcm_full);
 }
 static void thread_entry(void *p)
 {
     int err;
     MP3FrameInfo mp3FrameInfo;
     tts_ws_t *thiz = &g_tts_ws;
+    short *out;
+
     while (!thiz->is_exit)
     {
         rt_uint32_t evt = 0;
@@ -238,7 +286,7 @@ static void thread_entry(void *p)
                     memcpy(&thiz->main_buf[0], thiz->main_ptr, thiz->main_left);
                     thiz->main_ptr = &thiz->main_buf[0];
                 }
-                rt_size_t readed = rt_ringbuffer_get(thiz->rb_mp3, &thiz->main_buf[thiz->main_left], MP3_MAIN_BUFFER_SIZE - thiz->main_left);
+                rt_size_t readed = spsc_ring_get(thiz->rb_mp3, &thiz->main_buf[thiz->main_left], MP3_MAIN_BUFFER_SIZE - thiz->main_left);
                 thiz->main_left += readed;
                 if (!readed)
                 {
@@ -251,13 +299,33 @@ static void thread_entry(void *p)
             int offset = MP3FindSyncWord(thiz->main_ptr, thiz->main_left);
             if (offset >= 0)
             {
+                unsigned char *frame;
+
                 thiz->main_ptr += offset;
                 thiz->main_left -= offset;
 
-                int err = MP3Decode(thiz->decode_handle, &thiz->main_ptr, &thiz->main_left, (short *)thiz->decode_out, 0);
+                out = tts_pcm_acquire(thiz);
+                if (!out)
+                    break;
+                frame = thiz->main_ptr;
+                err = MP3Decode(thiz->decode_handle, &thiz->main_ptr, &thiz->main_left, out, 0);
+                if (err == ERR_MP3_INDATA_UNDERFLOW && thiz->main_left < MAINBUF_SIZE && !thiz->is_end)
+                {
+                    // frame not all here: refill if the ring has more, else the next delta re-arms
+                    if (spsc_ring_data_len(thiz->rb_mp3))
+                        rt_event_send(thiz->event, TTS_EVENT_DECODE);
+                    continue;
+                }
+                if (err && thiz->main_ptr == frame)
+                {
+                    // false sync word (ID3 tag, garbage): step over it or this spins
+                    thiz->main_ptr++;
+                    thiz->main_left--;
+                }
+                rt_event_send(thiz->event, TTS_EVENT_DECODE);   // made progress, keep going
                 if (err)
                 {
-                    rt_kprintf("mp3 decode err=%d\n", err);
+                    TRACE(TRACE_AUDIO, TRACE_WARN, "mp3 decode err=%d left=%d", err, thiz->main_left);
                     continue;
                 }
             }
@@ -267,32 +335,60 @@ static void thread_entry(void *p)
                 {
                     break;
                 }
+                continue;   // no frame yet, nothing decoded
             }
             MP3GetLastFrameInfo(thiz->decode_handle, &mp3FrameInfo);
             //rt_kprintf("samplereate=%d ch=%d\n", mp3FrameInfo.samprate, mp3FrameInfo.nChans);
-            audio_write_and_wait(thiz, thiz->decode_out, mp3FrameInfo.outputSamps * sizeof(uint16_t));
+            link_policy_notify(LP_SRC_TTS);
+            thiz->pcm_chunk = mp3FrameInfo.outputSamps * sizeof(uint16_t);
+            spsc_ring_write_commit(thiz->rb_pcm, thiz->pcm_chunk);
+            thiz->pcm_bytes += thiz->pcm_chunk;
+            tts_pcm_drain(thiz);
         }
     }
 
+    while (!thiz->is_exit && spsc_ring_data_len(thiz->rb_pcm))
+    {
+        if (!tts_pcm_drain(thiz))
+            rt_thread_mdelay(10);
+    }
+    tts_pcm_report(thiz);
     rt_thread_mdelay(200);
 
     speaker_off(thiz);
+    spsc_ring_t *pcm = thiz->rb_pcm;
+    spsc_ring_t *mp3 = thiz->rb_mp3;
+    thiz->rb_pcm = NULL;            // gone for tts_stats before they are freed
+    thiz->rb_mp3 = NULL;
+    spsc_ring_destroy(pcm);
+    spsc_ring_destroy(mp3);
+    MP3FreeDecoder(thiz->decode_handle);
+    thiz->decode_handle = NULL;
     thiz->is_end = 2;
 }
 
 static void xz_ws_audio_init( tts_ws_t *thiz)
 {
     rt_kprintf("xz_audio_init\n");
-    audio_server_set_private_volume(AUDIO_TYPE_LOCAL_MUSIC, 15);
 
-    thiz->event = rt_event_create("tts", RT_IPC_FLAG_FIFO);
+    if (!thiz->event)
+        thiz->event = rt_event_create("tts", RT_IPC_FLAG_FIFO);
     RT_ASSERT(thiz->event);
-    thiz->rb_mp3 = rt_ringbuffer_create(10*1024);
+    rt_event_control(thiz->event, RT_IPC_CMD_RESET, RT_NULL);
+    thiz->rb_mp3 = spsc_ring_create(TTS_MP3_RING_SIZE);
     RT_ASSERT(thiz->rb_mp3);
+    thiz->rb_pcm = spsc_ring_create(TTS_PCM_RING_SIZE);
+    RT_ASSERT(thiz->rb_pcm);
+    thiz->pcm_chunk = TTS_PCM_FRAME_MAX;
+    thiz->pcm_bytes = 0;
+    thiz->pcm_written = 0;
+    thiz->pcm_full = 0;
     thiz->main_left = 0;
     thiz->is_end = 0;
     thiz->main_ptr = &thiz->main_buf[0];
     thiz->is_exit = 0;
+    thiz->decode_handle = MP3InitDecoder();     // freed by the thread when it ends
+    RT_ASSERT(thiz->decode_handle);
 
     speaker_on(thiz);
 
@@ -305,24 +401,14 @@ static void xz_ws_audio_init( tts_ws_t *thiz)
     RT_ASSERT(thiz->thread);
     rt_thread_startup(thiz->thread);
 
-    if (!thiz->decode_handle)
-    {
-        thiz->decode_handle = MP3InitDecoder();
-        RT_ASSERT(thiz->decode_handle);
-    }
     xz_button_init();
 }
 
-static char *my_json_string(cJSON *json, char *key)
-{
-    return cJSON_GetObjectItem(json, key)->valuestring;
-}
-
-void parse_response(const u8_t *data, u16_t len)
+static void parse_response(void *ctx, const char *data, size_t len)
 {
     cJSON *item = NULL;
     cJSON *root = NULL;
-    tts_ws_t *thiz = &g_tts_ws;
+    tts_ws_t *thiz = (tts_ws_t *)ctx;
     //rt_kputs(data);
     //rt_kputs("\r\n");
     root = cJSON_Parse(data);   /*json_data 为MQTT的原始数据*/
@@ -332,34 +418,76 @@ void parse_response(const u8_t *data, u16_t len)
         return;
     }
 
-    char *type = my_json_string(root, "type");
+    const char *type = rts_json_string(root, "type");
+    if (strcmp(type, "response.audio.delta") != 0)
+        capture_record(CAP_WS_RX, CAP_FLAG_TTS, data, len);
     if (strcmp(type, "tts_session.updated") == 0)
     {
         item = cJSON_GetObjectItem(root, "sesson");
-        thiz->sample_rate = atoi(my_json_string(item,"output_audio_rate"));
-        rt_sem_release(thiz->sem);
-        xz_ws_audio_init(thiz);
+        thiz->sample_rate = atoi(rts_json_string(item,"output_audio_rate"));
+        rt_sem_release(g_tts_rts.sem);
+        if (thiz->render_fd < 0 && !thiz->rb_mp3)
+            xz_ws_audio_init(thiz);     // once per run, a repeated update must not leak a pipeline
+    }
+    else if (strcmp(type, "response.audio.done") == 0 && thiz->render_fd >= 0)
+    {
+        uint32_t ms = (rt_tick_get() - thiz->render_start) * 1000 / RT_TICK_PER_SECOND;
+
+        close(thiz->render_fd);
+        thiz->render_fd = -1;
+        thiz->render_done = 1;
+        thiz->is_end = 2;           // nothing to play out, the session can close now
+        rt_sem_release(g_tts_rts.sem);
+        rt_kprintf("tts: rendered %d bytes in %d ms\n", thiz->render_bytes, ms);
     }
     else if (strcmp(type, "response.audio.done") == 0)
     {
         thiz->is_end = 1;
-        rt_sem_release(thiz->sem);
+        if (thiz->event)
+            rt_event_send(thiz->event, TTS_EVENT_DECODE);   // flush the tail
+        rt_sem_release(g_tts_rts.sem);
         rt_kprintf("session ended\n");
     }
     else if (strcmp(type, "response.audio.delta") == 0)
     {
-        char *delta = my_json_string(root, "delta");
-        int size=0;
+        const char *delta = rts_json_string(root, "delta");
+        size_t size=0;
 
-        if (ERR_OK==mbedtls_base64_decode(&thiz->base64_out[0], MAX_AUDIO_DATA_LEN, &size,delta,strlen(delta)))
+        link_policy_notify(LP_SRC_TTS);
+        if (0==b64_decode(&thiz->base64_out[0], MAX_AUDIO_DATA_LEN, &size,delta,strlen(delta)))
         {
+            capture_record(CAP_RX_AUDIO, CAP_FLAG_TTS, thiz->base64_out, size);
+            if (thiz->render_fd >= 0)
+            {
+                // render ahead: as fast as the link delivers, never stalls the socket on playback
+                if (write(thiz->render_fd, thiz->base64_out, size) != size)
+                {
+                    rt_kprintf("tts: render write failed\n");
+                    thiz->is_exit = 1;
+                }
+                thiz->render_bytes += size;
+                cJSON_Delete(root);
+                return;
+            }
+            if (!thiz->rb_mp3 || thiz->is_exit)
+            {
+                // the decoder thread has ended and freed its rings, late audio goes nowhere
+                cJSON_Delete(root);
+                return;
+            }
             speaker_on(thiz);
 
             while (!thiz->is_exit)
             {
-                if (rt_ringbuffer_space_len(thiz->rb_mp3) >= size)
+                if (spsc_ring_space_len(thiz->rb_mp3) >= size)
                 {
-                    rt_ringbuffer_put(thiz->rb_mp3, thiz->base64_out, size);
+                    spsc_ring_put(thiz->rb_mp3, thiz->base64_out, size);
+                    rt_event_send(thiz->event, TTS_EVENT_DECODE);
+                    if (capture_active())
+                    {
+                        uint32_t levels[3] = {0, spsc_ring_data_len(thiz->rb_mp3), 0};
+                        capture_record(CAP_LEVELS, CAP_FLAG_TTS, levels, sizeof(levels));
+                    }
                     break;
                 }
                 else
@@ -387,7 +515,7 @@ static const char *config_message =
     "\"session\": {"
         "\"voice\":\"zh_female_kailangjiejie_moon_bigtts\","
         "\"output_audio_format\": \"mp3\","
-        "\"output_audio_sample_rate\": 16000 ,"
+        "\"output_audio_sample_rate\": " PIPE_STR(VOLC_AUDIO_RATE) " ,"
         "\"text_to_speech\": {"
           "\"model\": \"doubao-tts\" "
         "}"
@@ -411,54 +539,147 @@ void send_tts_request(char * text)
     tts_request[sizeof(tts_request) - 1] = '#';
     rt_snprintf(tts_request, sizeof(tts_request), tts_req_fmt, g_tts_ws.event_id++, text);
     RT_ASSERT(tts_request[sizeof(tts_request) - 1] == '#');
-    rt_kprintf("Web socket write tts request %s\r\n", tts_request);
+    TRACE(TRACE_TTS, TRACE_INFO, "write tts request %d bytes", strlen(tts_request), 0);
+    const char *msgs[] = {tts_request, input_done};
+    rts_send_texts(&g_tts_rts, msgs, 2);
+}
+
+/* Plays a file rendered by `tts -r`, the decoder sees it like network deltas. */
+static void tts_play_file(tts_ws_t *thiz, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    int n;
 
-    wsock_write(&g_tts_ws.clnt, tts_request, strlen(tts_request),OPCODE_TEXT);
-    wsock_write(&g_tts_ws.clnt, input_done, strlen(input_done),OPCODE_TEXT);
+    if (fd < 0)
+    {
+        rt_kprintf("tts: cannot open %s\n", path);
+        return;
+    }
+    thiz->sample_rate = PIPE_RATE;  // as asked for in config_message
+    xz_ws_audio_init(thiz);
+    while (!thiz->is_exit)
+    {
+        if (spsc_ring_space_len(thiz->rb_mp3) < TTS_FILE_CHUNK)
+        {
+            rt_thread_mdelay(20);
+            continue;
+        }
+        n = read(fd, thiz->base64_out, TTS_FILE_CHUNK);
+        if (n <= 0)
+            break;
+        spsc_ring_put(thiz->rb_mp3, thiz->base64_out, n);
+        rt_event_send(thiz->event, TTS_EVENT_DECODE);
+    }
+    close(fd);
+    thiz->is_end = 1;
+    rt_event_send(thiz->event, TTS_EVENT_DECODE);
+    while (thiz->is_end != 2)
+        rt_thread_mdelay(50);
+}
+
+static void tts_reset(tts_ws_t *thiz, const char *out)
+{
+    rt_event_t event = thiz->event;     // kept across runs, the rings and decoder are not
+
+    memset(thiz, 0, sizeof(tts_ws_t));
+    thiz->event = event;
+    thiz->render_fd = -1;
+    if (out)
+        rt_strncpy(thiz->out_uri, out, TTS_URI_LEN - 1);
 }
 
 void tts(int argc, char **argv)
 {
     tts_ws_t *thiz = &g_tts_ws;
+    const char *path = NULL;
+    const char *out = NULL;
+    char *text;
+    int play = 1;
     err_t err;
 
-    memset(thiz, 0, sizeof(tts_ws_t));
+    if (argc > 2 && strcmp(argv[1], "-o") == 0)
+    {
+        out = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc == 3 && strcmp(argv[1], "-p") == 0)
+    {
+        tts_reset(thiz, out);
+        tts_play_file(thiz, argv[2]);
+        return;
+    }
+    if (argc == 4 && (strcmp(argv[1], "-f") == 0 || strcmp(argv[1], "-r") == 0))
+    {
+        path = argv[2];
+        play = argv[1][1] == 'f';
+        text = argv[3];
+    }
+    else if (argc == 2)
+    {
+        text = argv[1];
+    }
+    else
+    {
+        rt_kprintf("usage: tts <text>\n");
+        rt_kprintf("       tts -f <file> <text>   render to file at link speed, then play it\n");
+        rt_kprintf("       tts -r <file> <text>   render only, e.g. to queue announcements\n");
+        rt_kprintf("       tts -p <file>          play a rendered file\n");
+        rt_kprintf("       tts -o <out.wav|null> ...  decode to a file instead of the speaker\n");
+        return;
+    }
 
-    if (thiz->sem == NULL)
-        thiz->sem = rt_sem_create("xz_ws", 0, RT_IPC_FLAG_FIFO);
+    tts_reset(thiz, out);
+    if (path)
+    {
+        thiz->render_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0);
+        if (thiz->render_fd < 0)
+        {
+            rt_kprintf("tts: cannot create %s\n", path);
+            return;
+        }
+        thiz->render_start = rt_tick_get();
+    }
 
-    wsock_init(&thiz->clnt, 1, 1, my_wsapp_fn);
-    err = wsock_connect(&thiz->clnt, MAX_WSOCK_HDR_LEN, TTS_HOST, TTS_WSPATH,
-                        LWIP_IANA_PORT_HTTPS, TTS_TOKEN, NULL,
-                        "Content-Type: application/json\r\n");
-    rt_kprintf("Web socket connection %d\r\n", err);
+    if (!g_tts_rts.downlink)
+        rts_init(&g_tts_rts, "tts_dl", CAP_FLAG_TTS, parse_response, NULL, thiz);
+    err = rts_connect(&g_tts_rts, TTS_HOST, TTS_WSPATH, TTS_TOKEN);
     if (err == 0)
     {
-        if (RT_EOK == rt_sem_take(thiz->sem, 5000))
+        if (RT_EOK == rt_sem_take(g_tts_rts.sem, 5000))
         {
-            if (thiz->is_connected)
+            if (g_tts_rts.is_connected)
             {
-                rt_kprintf("Web socket write config %s\r\n", config_message);
-                err = wsock_write(&thiz->clnt, config_message, strlen(config_message), OPCODE_TEXT);
-                if (ERR_OK==err && rt_sem_take(thiz->sem, 5000)==RT_EOK) {
-                    LOCK_TCPIP_CORE();
-                    send_tts_request(argv[1]);
-                    UNLOCK_TCPIP_CORE();
-                }
+                TRACE(TRACE_TTS, TRACE_INFO, "write config %d bytes", strlen(config_message), 0);
+                err = rts_send_text(&g_tts_rts, config_message);
+                if (ERR_OK==err && rt_sem_take(g_tts_rts.sem, 5000)==RT_EOK)
+                    send_tts_request(text);
                 while (1)
                 {
                     if (thiz->is_exit || thiz->is_end == 2)
                     {
                         rt_kprintf("Finish TTS exit =%d end=%d", thiz->is_exit, thiz->is_end);
                         rt_kprintf("Web socket disconnected\r\n");
-                        wsock_close(&thiz->clnt, WSOCK_RESULT_OK,ERR_OK);
-                        return;
+                        rts_close(&g_tts_rts);
+                        break;
+                    }
+                    if (!g_tts_rts.is_connected)
+                    {
+                        // dropped before audio.done: play out what came, the
+                        // render file is removed below
+                        rt_kprintf("Web socket dropped, end=%d\r\n", thiz->is_end);
+                        if (!thiz->is_end && thiz->rb_mp3)
+                        {
+                            thiz->is_end = 1;
+                            rt_event_send(thiz->event, TTS_EVENT_DECODE);
+                        }
+                        break;
                     }
 
-                    if (RT_EOK==rt_sem_take(g_tts_ws.sem, 3000))
-                        rt_kprintf("is_end =%d", thiz->is_end);
+                    if (RT_EOK==rt_sem_take(g_tts_rts.sem, 3000))
+                        TRACE(TRACE_TTS, TRACE_DEBUG, "is_end=%d", thiz->is_end, 0);
                     else
-                        rt_kprintf("wait end=%d", thiz->is_end);
+                        TRACE(TRACE_TTS, TRACE_DEBUG, "wait end=%d", thiz->is_end, 0);
 
                     continue;
                 }
@@ -466,7 +687,7 @@ void tts(int argc, char **argv)
             else
             {
                 rt_kprintf("Web socket disconnected\r\n");
-                wsock_close(&thiz->clnt, WSOCK_RESULT_OK,ERR_OK);
+                rts_close(&g_tts_rts);
             }
         }
         else
@@ -475,8 +696,39 @@ void tts(int argc, char **argv)
         }
 
     }
+    if (thiz->render_fd >= 0)
+    {
+        // session ended without audio.done, keep nothing half written
+        close(thiz->render_fd);
+        thiz->render_fd = -1;
+        unlink(path);
+    }
+    if (thiz->render_done && play)
+    {
+        thiz->is_end = 0;
+        thiz->is_exit = 0;
+        tts_play_file(thiz, path);
+    }
 }
 MSH_CMD_EXPORT(tts, Text to speech)
 
+void tts_stats(volc_stats_t *s)
+{
+    tts_ws_t *thiz = &g_tts_ws;
+
+    rt_enter_critical();    // the tts thread frees rb_pcm when it ends
+    if (thiz->rb_mp3)
+        stats_ring(&s->mp3, thiz->rb_mp3);
+    if (thiz->rb_pcm)
+        stats_ring(&s->pcm, thiz->rb_pcm);
+    s->tts_cache_full = thiz->pcm_full;
+    rt_exit_critical();
+    s->tx_msgs += g_tts_rts.tx_msgs;
+    s->tx_bytes += g_tts_rts.tx_bytes;
+    s->rx_dropped += g_tts_rts.rx_dropped;
+    if (g_tts_rts.downlink)
+        downlink_counters(g_tts_rts.downlink, &s->rx_msgs, &s->rx_bytes);
+}
+
 /************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
 
@@ -0,0 +1,584 @@
+/**
+  ******************************************************************************
+  * @file   ui.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <string.h>
+#include "lvgl.h"
+#include "littlevgl2rtt.h"
+#include "ui.h"
+
+#define UI_FACE_CACHE_NUM   4       // decoded faces kept in RAM
+#define UI_MQ_DEPTH         16
+#define UI_IDLE_MS          50
+
+#define UI_FONT_PATH        "/font.ttf"
+#define UI_FONT_SIZE        24
+#define UI_GLYPH_CACHE      256     // Tiny TTF glyph cache entries
+#define UI_WIDTH_CACHE      128     // advance widths, power of 2
+#define UI_TEXT_MAX_LINES   24
+#define UI_TEXT_HEIGHT      160
+
+typedef enum
+{
+    UI_MSG_STATE,
+    UI_MSG_TRANSCRIPT,
+} ui_msg_type_t;
+
+typedef struct
+{
+    uint8_t     type;
+    uint8_t     state;
+    char        *text;      // rt_malloc'ed, freed by the ui thread
+} ui_msg_t;
+
+typedef enum
+{
+    FACE_NEUTRAL,
+    FACE_HAPPY,
+    FACE_LAUGHING,
+    FACE_FUNNY,
+    FACE_SAD,
+    FACE_ANGRY,
+    FACE_CRYING,
+    FACE_LOVING,
+    FACE_EMBARRASSED,
+    FACE_SURPRISED,
+    FACE_SHOCKED,
+    FACE_THINKING,
+    FACE_WINKING,
+    FACE_COOL,
+    FACE_RELAXED,
+    FACE_DELICIOUS,
+    FACE_KISSY,
+    FACE_CONFIDENT,
+    FACE_SLEEPY,
+    FACE_SILLY,
+    FACE_CONFUSED,
+    FACE_NUM,
+} ui_face_t;
+
+LV_IMAGE_DECLARE(neutral);
+LV_IMAGE_DECLARE(happy);
+LV_IMAGE_DECLARE(laughing);
+LV_IMAGE_DECLARE(funny);
+LV_IMAGE_DECLARE(sad);
+LV_IMAGE_DECLARE(angry);
+LV_IMAGE_DECLARE(crying);
+LV_IMAGE_DECLARE(loving);
+LV_IMAGE_DECLARE(embarrassed);
+LV_IMAGE_DECLARE(surprised);
+LV_IMAGE_DECLARE(shocked);
+LV_IMAGE_DECLARE(thinking);
+LV_IMAGE_DECLARE(winking);
+LV_IMAGE_DECLARE(cool);
+LV_IMAGE_DECLARE(relaxed);
+LV_IMAGE_DECLARE(delicious);
+LV_IMAGE_DECLARE(kissy);
+LV_IMAGE_DECLARE(confident);
+LV_IMAGE_DECLARE(sleepy);
+LV_IMAGE_DECLARE(silly);
+LV_IMAGE_DECLARE(confused);
+
+static const lv_image_dsc_t *const face_src[FACE_NUM] =
+{
+    &neutral, &happy, &laughing, &funny, &sad, &angry, &crying, &loving,
+    &embarrassed, &surprised, &shocked, &thinking, &winking, &cool, &relaxed,
+    &delicious, &kissy, &confident, &sleepy, &silly, &confused,
+};
+
+static const uint8_t state_face[] =
+{
+    [UI_STATE_IDLE]         = FACE_NEUTRAL,
+    [UI_STATE_CONNECTING]   = FACE_SLEEPY,
+    [UI_STATE_LISTENING]    = FACE_RELAXED,
+    [UI_STATE_THINKING]     = FACE_THINKING,
+    [UI_STATE_SPEAKING]     = FACE_HAPPY,
+};
+
+/* Transcript keywords that pick the face while speaking, first match wins. */
+static const struct
+{
+    const char  *word;
+    uint8_t     face;
+} sentiment[] =
+{
+    {"哈哈", FACE_LAUGHING},
+    {"笑", FACE_FUNNY},
+    {"开心", FACE_HAPPY},
+    {"高兴", FACE_HAPPY},
+    {"喜欢", FACE_LOVING},
+    {"爱", FACE_LOVING},
+    {"难过", FACE_SAD},
+    {"伤心", FACE_CRYING},
+    {"抱歉", FACE_EMBARRASSED},
+    {"对不起", FACE_EMBARRASSED},
+    {"生气", FACE_ANGRY},
+    {"哇", FACE_SURPRISED},
+    {"天哪", FACE_SHOCKED},
+    {"好吃", FACE_DELICIOUS},
+    {"美味", FACE_DELICIOUS},
+    {"酷", FACE_COOL},
+    {"当然", FACE_CONFIDENT},
+    {"晚安", FACE_SLEEPY},
+    {"困", FACE_SLEEPY},
+    {"不确定", FACE_CONFUSED},
+    {"嗯", FACE_THINKING},
+};
+
+typedef struct
+{
+    lv_draw_buf_t   *buf;
+    uint8_t         face;
+    uint32_t        last_use;
+} ui_face_entry_t;
+
+typedef struct
+{
+    uint32_t        letter;
+    uint16_t        width;
+} ui_glyph_width_t;
+
+typedef struct
+{
+    rt_thread_t     thread;
+    rt_mq_t         mq;
+    uint8_t         posted_state;
+    lv_obj_t        *face_img;
+    ui_face_entry_t cache[UI_FACE_CACHE_NUM];
+    uint32_t        use_seq;
+    uint8_t         state;
+    uint8_t         face;
+    uint8_t         sentiment_face;
+    volatile uint8_t animating;
+
+    uint32_t        cache_hit;
+    uint32_t        cache_miss;
+    uint32_t        decode_ms_max;
+    uint32_t        face_switch;
+    uint32_t        underrun;
+    uint32_t        underrun_animating;
+
+    // transcript
+    lv_font_t       *font;
+    lv_obj_t        *text_box;
+    lv_obj_t        *text_line;     // line being appended to
+    int32_t         line_width;
+    int32_t         box_width;
+    uint8_t         text_dirty;
+    ui_glyph_width_t width_cache[UI_WIDTH_CACHE];
+
+    uint32_t        text_delta;
+    uint32_t        text_glyph;
+    uint32_t        text_lines;
+    uint32_t        width_hit;
+    uint32_t        width_miss;
+    uint32_t        frame_count;
+    uint32_t        frame_ms_total;
+    uint32_t        frame_ms_max;
+} ui_t;
+
+static ui_t g_ui;
+
+/* Decoded faces are kept in a small LRU so a switch only costs a blit. */
+static const void *ui_face_get(ui_t *thiz, uint8_t face)
+{
+    ui_face_entry_t *victim = &thiz->cache[0];
+    lv_image_decoder_dsc_t dsc;
+    rt_tick_t start;
+
+    for (int i = 0; i < UI_FACE_CACHE_NUM; i++)
+    {
+        ui_face_entry_t *e = &thiz->cache[i];
+        if (e->buf && e->face == face)
+        {
+            e->last_use = ++thiz->use_seq;
+            thiz->cache_hit++;
+            return e->buf;
+        }
+        if (e->buf && e->face == thiz->face)
+            continue;   // still on screen
+        if (!e->buf || (victim->buf && (victim->face == thiz->face || e->last_use < victim->last_use)))
+            victim = e;
+    }
+
+    thiz->cache_miss++;
+    start = rt_tick_get();
+    if (lv_image_decoder_open(&dsc, face_src[face], NULL) != LV_RESULT_OK)
+        return face_src[face];
+    lv_draw_buf_t *buf = dsc.decoded ? lv_draw_buf_dup(dsc.decoded) : NULL;
+    lv_image_decoder_close(&dsc);
+    if (!buf)
+        return face_src[face];
+
+    if (victim->buf)
+        lv_draw_buf_destroy(victim->buf);
+    victim->buf = buf;
+    victim->face = face;
+    victim->last_use = ++thiz->use_seq;
+
+    uint32_t ms = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+    if (ms > thiz->decode_ms_max)
+        thiz->decode_ms_max = ms;
+    return buf;
+}
+
+static void ui_face_bounce_cb(void *var, int32_t v)
+{
+    lv_image_set_scale((lv_obj_t *)var, v);
+}
+
+static void ui_face_animate(ui_t *thiz, int on)
+{
+    if (on == thiz->animating)
+        return;
+    lv_anim_delete(thiz->face_img, ui_face_bounce_cb);
+    lv_image_set_scale(thiz->face_img, LV_SCALE_NONE);
+    thiz->animating = on;
+    if (on)
+    {
+        lv_anim_t a;
+        lv_anim_init(&a);
+        lv_anim_set_var(&a, thiz->face_img);
+        lv_anim_set_values(&a, LV_SCALE_NONE, LV_SCALE_NONE * 110 / 100);
+        lv_anim_set_duration(&a, 400);
+        lv_anim_set_playback_duration(&a, 400);
+        lv_anim_set_repeat_count(&a, LV_ANIM_REPEAT_INFINITE);
+        lv_anim_set_path_cb(&a, lv_anim_path_ease_in_out);
+        lv_anim_set_exec_cb(&a, ui_face_bounce_cb);
+        lv_anim_start(&a);
+    }
+}
+
+static void ui_face_show(ui_t *thiz, uint8_t face)
+{
+    if (face == thiz->face)
+        return;
+    thiz->face_switch++;
+    // thiz->face is still the face on screen, the cache must not evict it
+    lv_image_set_src(thiz->face_img, ui_face_get(thiz, face));
+    thiz->face = face;
+}
+
+static void ui_update_face(ui_t *thiz)
+{
+    uint8_t face = state_face[thiz->state];
+
+    if (thiz->state == UI_STATE_SPEAKING && thiz->sentiment_face != FACE_NUM)
+        face = thiz->sentiment_face;
+    ui_face_show(thiz, face);
+    ui_face_animate(thiz, thiz->state == UI_STATE_SPEAKING);
+}
+
+static void ui_handle_transcript(ui_t *thiz, const char *text)
+{
+    for (int i = 0; i < sizeof(sentiment) / sizeof(sentiment[0]); i++)
+    {
+        if (strstr(text, sentiment[i].word))
+        {
+            thiz->sentiment_face = sentiment[i].face;
+            break;
+        }
+    }
+}
+
+/* Advance widths from a small direct mapped cache. It sees the same working
+ * set as the Tiny TTF glyph cache, so its hit rate is used to size that one. */
+static int32_t ui_glyph_width(ui_t *thiz, uint32_t letter)
+{
+    ui_glyph_width_t *e = &thiz->width_cache[(letter * 2654435761u) >> 25 & (UI_WIDTH_CACHE - 1)];
+
+    if (e->letter == letter && e->width)
+    {
+        thiz->width_hit++;
+        return e->width;
+    }
+    thiz->width_miss++;
+    e->letter = letter;
+    e->width = lv_font_get_glyph_width(thiz->font, letter, 0);
+    return e->width;
+}
+
+static lv_obj_t *ui_text_new_line(ui_t *thiz)
+{
+    lv_obj_t *line = lv_label_create(thiz->text_box);
+
+    lv_label_set_text(line, "");
+    lv_obj_set_style_text_font(line, thiz->font, LV_PART_MAIN);
+    if (lv_obj_get_child_count(thiz->text_box) > UI_TEXT_MAX_LINES)
+        lv_obj_delete(lv_obj_get_child(thiz->text_box, 0));
+    thiz->text_line = line;
+    thiz->line_width = 0;
+    thiz->text_lines++;
+    return line;
+}
+
+static void ui_text_flush(ui_t *thiz, const char *start, const char *end)
+{
+    char tmp[64];
+
+    // lv_label_ins_text only re-lays out the label being appended to
+    while (start < end)
+    {
+        size_t n = end - start;
+        if (n > sizeof(tmp) - 1)
+            n = sizeof(tmp) - 1;
+        while (n && (start[n] & 0xC0) == 0x80 && start + n < end)
+            n--;    // keep utf-8 sequences whole
+        memcpy(tmp, start, n);
+        tmp[n] = '\0';
+        lv_label_ins_text(thiz->text_line, LV_LABEL_POS_LAST, tmp);
+        start += n;
+    }
+}
+
+static void ui_text_append(ui_t *thiz, const char *text)
+{
+    const char *run = text;     // first byte not yet in a label
+    uint32_t i = 0;
+
+    if (!thiz->text_box)
+        return;
+    if (!thiz->text_line)
+        ui_text_new_line(thiz);
+    thiz->text_delta++;
+    while (text[i])
+    {
+        uint32_t start = i;
+        uint32_t letter = lv_text_encoded_next(text, &i);
+        int32_t w;
+
+        if (letter == '\n')
+        {
+            ui_text_flush(thiz, run, text + start);
+            ui_text_new_line(thiz);
+            run = text + i;
+            continue;
+        }
+        w = ui_glyph_width(thiz, letter);
+        if (thiz->line_width + w > thiz->box_width && thiz->line_width)
+        {
+            ui_text_flush(thiz, run, text + start);
+            ui_text_new_line(thiz);
+            run = text + start;
+        }
+        thiz->line_width += w;
+        thiz->text_glyph++;
+    }
+    ui_text_flush(thiz, run, text + i);
+    lv_obj_scroll_to_view(thiz->text_line, LV_ANIM_OFF);
+    thiz->text_dirty = 1;
+}
+
+static void ui_text_clear(ui_t *thiz)
+{
+    if (!thiz->text_box)
+        return;
+    lv_obj_clean(thiz->text_box);
+    thiz->text_line = NULL;
+    thiz->line_width = 0;
+}
+
+static void ui_text_create(ui_t *thiz)
+{
+    thiz->font = lv_tiny_ttf_create_file_ex(UI_FONT_PATH, UI_FONT_SIZE, LV_FONT_KERNING_NONE, UI_GLYPH_CACHE);
+    if (!thiz->font)
+    {
+        rt_kprintf("ui: no font %s, transcript disabled\n", UI_FONT_PATH);
+        return;
+    }
+    thiz->text_box = lv_obj_create(lv_screen_active());
+    lv_obj_set_size(thiz->text_box, 320, UI_TEXT_HEIGHT);
+    lv_obj_align(thiz->text_box, LV_ALIGN_BOTTOM_MID, 0, -40);
+    lv_obj_set_style_bg_opa(thiz->text_box, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_set_style_border_width(thiz->text_box, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_all(thiz->text_box, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_row(thiz->text_box, 2, LV_PART_MAIN);
+    lv_obj_set_flex_flow(thiz->text_box, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_scroll_dir(thiz->text_box, LV_DIR_VER);
+    lv_obj_set_scrollbar_mode(thiz->text_box, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_remove_flag(thiz->text_box, LV_OBJ_FLAG_SCROLL_ELASTIC);
+    lv_obj_update_layout(thiz->text_box);
+    thiz->box_width = lv_obj_get_content_width(thiz->text_box);
+}
+
+static void ui_handle_msg(ui_t *thiz, ui_msg_t *msg)
+{
+    switch (msg->type)
+    {
+    case UI_MSG_STATE:
+        if (msg->state != UI_STATE_SPEAKING)
+            thiz->sentiment_face = FACE_NUM;
+        if (msg->state == UI_STATE_LISTENING)
+            ui_text_clear(thiz);
+        thiz->state = msg->state;
+        break;
+    case UI_MSG_TRANSCRIPT:
+        ui_handle_transcript(thiz, msg->text);
+        ui_text_append(thiz, msg->text);
+        rt_free(msg->text);
+        break;
+    default:
+        break;
+    }
+    ui_update_face(thiz);
+}
+
+static void ui_thread_entry(void *p)
+{
+    ui_t *thiz = &g_ui;
+    ui_msg_t msg;
+
+    thiz->face_img = lv_image_create(lv_screen_active());
+    lv_obj_align(thiz->face_img, LV_ALIGN_CENTER, 0, 0);
+    thiz->face = FACE_NUM;
+    // warm the cache with the faces every turn goes through
+    ui_face_get(thiz, FACE_THINKING);
+    ui_face_get(thiz, FACE_RELAXED);
+    ui_face_get(thiz, FACE_HAPPY);
+    thiz->sentiment_face = FACE_NUM;
+    ui_update_face(thiz);
+    ui_text_create(thiz);
+
+    while (1)
+    {
+        rt_tick_t start = rt_tick_get();
+        uint32_t ms = lv_task_handler();
+        if (thiz->text_dirty)
+        {
+            // refresh that includes new transcript glyphs
+            uint32_t frame_ms = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+            thiz->text_dirty = 0;
+            thiz->frame_count++;
+            thiz->frame_ms_total += frame_ms;
+            if (frame_ms > thiz->frame_ms_max)
+                thiz->frame_ms_max = frame_ms;
+        }
+        if (ms > UI_IDLE_MS)
+            ms = UI_IDLE_MS;
+        while (RT_EOK == rt_mq_recv(thiz->mq, &msg, sizeof(msg), rt_tick_from_millisecond(ms)))
+        {
+            ui_handle_msg(thiz, &msg);
+            ms = 0;
+        }
+    }
+}
+
+int ui_init(void)
+{
+    ui_t *thiz = &g_ui;
+
+    if (thiz->thread)
+        return RT_EOK;
+    if (littlevgl2rtt_init("lcd") != RT_EOK)
+    {
+        rt_kprintf("ui: lcd init fail\n");
+        return -RT_ERROR;
+    }
+    thiz->mq = rt_mq_create("ui", sizeof(ui_msg_t), UI_MQ_DEPTH, RT_IPC_FLAG_FIFO);
+    RT_ASSERT(thiz->mq);
+    // Lowest application priority, rendering must never delay the audio threads.
+    thiz->thread = rt_thread_create("ui",
+                                    ui_thread_entry,
+                                    NULL,
+                                    4096,
+                                    RT_THREAD_PRIORITY_LOW + 2,
+                                    RT_THREAD_TICK_DEFAULT);
+    RT_ASSERT(thiz->thread);
+    rt_thread_startup(thiz->thread);
+    return RT_EOK;
+}
+
+void ui_set_state(ui_state_t state)
+{
+    ui_msg_t msg = {UI_MSG_STATE, (uint8_t)state, NULL};
+
+    // callers report the state per audio chunk, only post changes
+    if (!g_ui.mq || g_ui.posted_state == state)
+        return;
+    if (rt_mq_send(g_ui.mq, &msg, sizeof(msg)) == RT_EOK)
+        g_ui.posted_state = state;
+}
+
+void ui_transcript_delta(const char *text)
+{
+    ui_msg_t msg = {UI_MSG_TRANSCRIPT, 0, NULL};
+    size_t len = strlen(text);
+
+    if (!g_ui.mq)
+        return;
+    msg.text = rt_malloc(len + 1);
+    if (!msg.text)
+        return;
+    memcpy(msg.text, text, len + 1);
+    if (rt_mq_send(g_ui.mq, &msg, sizeof(msg)) != RT_EOK)
+        rt_free(msg.text);
+}
+
+void ui_note_audio_underrun(void)
+{
+    g_ui.underrun++;
+    if (g_ui.animating)
+        g_ui.underrun_animating++;
+}
+
+static void ui_stat(int argc, char **argv)
+{
+    ui_t *thiz = &g_ui;
+
+    rt_kprintf("face: switches %d, cache hit %d miss %d, max decode %d ms\n",
+               thiz->face_switch, thiz->cache_hit, thiz->cache_miss, thiz->decode_ms_max);
+    rt_kprintf("audio underruns: %d total, %d while animating\n",
+               thiz->underrun, thiz->underrun_animating);
+    rt_kprintf("transcript: %d deltas, %d glyphs, %d lines\n",
+               thiz->text_delta, thiz->text_glyph, thiz->text_lines);
+    if (thiz->width_hit + thiz->width_miss)
+        rt_kprintf("glyph cache: hit %d miss %d (%d%%), %d entries\n", thiz->width_hit, thiz->width_miss,
+                   thiz->width_hit * 100 / (thiz->width_hit + thiz->width_miss), UI_GLYPH_CACHE);
+    if (thiz->frame_count)
+        rt_kprintf("text frame: avg %d ms max %d ms over %d frames\n",
+                   thiz->frame_ms_total / thiz->frame_count, thiz->frame_ms_max, thiz->frame_count);
+}
+MSH_CMD_EXPORT(ui_stat, Show face cache transcript and audio underrun statistics);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
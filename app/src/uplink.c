@@ -0,0 +1,209 @@
+/**
+  ******************************************************************************
+  * @file   uplink.c
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uplink.h"
+
+#define UPLINK_HEALTHY_RUN      50      // decisions before packing is relaxed
+
+void uplink_ctrl_init(uplink_ctrl_t *u, uint32_t frame_bytes, uint32_t sndbuf_size)
+{
+    memset(u, 0, sizeof(*u));
+    u->frame_bytes = frame_bytes;
+    u->sndbuf_size = sndbuf_size;
+    u->agg = 1;
+    u->agg_min = 1;
+    u->agg_max_seen = 1;
+}
+
+static void uplink_ctrl_set_agg(uplink_ctrl_t *u, uint32_t agg)
+{
+    if (agg > UPLINK_MAX_AGG)
+        agg = UPLINK_MAX_AGG;
+    if (agg < u->agg_min)
+        agg = u->agg_min;
+    u->agg = agg;
+    if (agg > u->agg_max_seen)
+        u->agg_max_seen = agg;
+    u->healthy = 0;
+}
+
+void uplink_ctrl_config(uplink_ctrl_t *u, uint32_t frame_bytes, uint32_t agg_min)
+{
+    u->frame_bytes = frame_bytes;
+    u->agg_min = agg_min < 1 ? 1 : (agg_min > UPLINK_MAX_AGG ? UPLINK_MAX_AGG : agg_min);
+    uplink_ctrl_set_agg(u, u->agg);
+}
+
+uint32_t uplink_ctrl_next(uplink_ctrl_t *u, uint32_t backlog_frames, uint32_t sndbuf_free, int flush)
+{
+    uint32_t n;
+
+    if (!backlog_frames)
+        return 0;
+    if (backlog_frames > 3u * u->agg && u->agg < UPLINK_MAX_AGG)
+    {
+        // falling behind, pay the message overhead less often
+        uplink_ctrl_set_agg(u, u->agg * 2);
+    }
+    else if (u->agg > u->agg_min && backlog_frames <= u->agg && sndbuf_free >= u->sndbuf_size * 3 / 4)
+    {
+        if (++u->healthy >= UPLINK_HEALTHY_RUN)
+            uplink_ctrl_set_agg(u, u->agg / 2);
+    }
+    n = backlog_frames < u->agg ? backlog_frames : u->agg;
+    if (n < u->agg && !flush)
+        return 0;   // wait for a full aggregate, at most agg frames of delay
+    // audio may fill half the buffer, so a control message never queues
+    // behind more than that and always finds room
+    if (sndbuf_free < UPLINK_MSG_BYTES(u->frame_bytes, n) + u->sndbuf_size / 2)
+    {
+        u->deferred++;
+        return 0;
+    }
+    return n;
+}
+
+void uplink_ctrl_result(uplink_ctrl_t *u, uint32_t frames, int err)
+{
+    if (err)
+    {
+        u->write_errs++;
+        uplink_ctrl_set_agg(u, u->agg * 2);
+        return;
+    }
+    u->sent_frames += frames;
+    u->sent_msgs++;
+}
+
+/*
+ * Runs the controller against a simulated bandwidth capped server: the mic
+ * produces one frame every 10 ms into a ring of ring_frames, the send buffer
+ * drains at kbps. Compared with sending every frame as it comes, which is
+ * what the chat uplink did before.
+ */
+typedef struct
+{
+    uint32_t    sent;
+    uint32_t    dropped;
+    uint32_t    lost;           // frames the socket refused
+    uint32_t    msgs;
+    uint32_t    backlog_max;
+    uint32_t    ctrl_wait_max;  // ms a control message would queue behind audio
+} uplink_sim_result_t;
+
+static void uplink_sim_run(uint32_t kbps, uint32_t seconds, int controlled, uplink_sim_result_t *r)
+{
+    const uint32_t frame = 320, ring_frames = 25, sndbuf = 12288;
+    uint32_t drain = kbps * 1000 / 8 / 100;     // bytes per 10 ms
+    uint32_t used = 0, backlog = 0, step, n;
+    uplink_ctrl_t u;
+
+    memset(r, 0, sizeof(*r));
+    uplink_ctrl_init(&u, frame, sndbuf);
+    for (step = 0; step < seconds * 100; step++)
+    {
+        used = used > drain ? used - drain : 0;
+        if (backlog < ring_frames)
+            backlog++;
+        else
+            r->dropped++;
+        if (backlog > r->backlog_max)
+            r->backlog_max = backlog;
+        if (controlled)
+        {
+            while ((n = uplink_ctrl_next(&u, backlog, sndbuf - used, 0)) != 0)
+            {
+                used += UPLINK_MSG_BYTES(frame, n);
+                uplink_ctrl_result(&u, n, 0);
+                backlog -= n;
+                r->sent += n;
+                r->msgs++;
+            }
+        }
+        else
+        {
+            while (backlog)
+            {
+                if (sndbuf - used >= UPLINK_MSG_BYTES(frame, 1))
+                {
+                    used += UPLINK_MSG_BYTES(frame, 1);
+                    r->sent++;
+                    r->msgs++;
+                }
+                else
+                {
+                    r->lost++;      // ERR_MEM, frame dropped
+                }
+                backlog--;
+            }
+        }
+        if (drain && used * 10 / drain > r->ctrl_wait_max)
+            r->ctrl_wait_max = used * 10 / drain;
+    }
+}
+
+static void uplink_sim(int argc, char **argv)
+{
+    uint32_t kbps = argc > 1 ? atoi(argv[1]) : 256;
+    uint32_t seconds = argc > 2 ? atoi(argv[2]) : 30;
+    uplink_sim_result_t r;
+    int controlled;
+
+    rt_kprintf("uplink at %d kbps for %d s, mic needs %d kbps:\n", kbps, seconds,
+               UPLINK_MSG_BYTES(320, 1) * 8 * 100 / 1000);
+    for (controlled = 0; controlled < 2; controlled++)
+    {
+        uplink_sim_run(kbps, seconds, controlled, &r);
+        rt_kprintf("%s: sent %d frames in %d msgs, %d lost at socket, %d dropped at ring, "
+                   "backlog max %d ms, control wait max %d ms\n",
+                   controlled ? "controlled" : "naive     ", r.sent, r.msgs, r.lost, r.dropped,
+                   r.backlog_max * 10, r.ctrl_wait_max);
+    }
+}
+MSH_CMD_EXPORT(uplink_sim, uplink_sim [kbps] [seconds]: uplink control against a capped link);
+
+/************************ (C) COPYRIGHT Sifli Technology *******END OF FILE****/
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file   uplink.h
+  * @author Sifli software development team
+  ******************************************************************************
+*/
+/**
+ * @attention
+ * Copyright (c) 2024 - 2025,  Sifli Technology
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Sifli integrated circuit
+ *    in a product or a software update for such product, must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of Sifli nor the names of its contributors may be used to endorse
+ *    or promote products derived from this software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Sifli integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIFLI TECHNOLOGY "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL SIFLI TECHNOLOGY OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __UPLINK_H__
+#define __UPLINK_H__
+
+#include <stdint.h>
+
+#define UPLINK_MAX_AGG          8       // mic frames per append message at most
+#define UPLINK_MSG_OVERHEAD     96      // json wrapper, websocket header and tls record
+
+/* Bytes a message of n frames occupies in the tcp send buffer. */
+#define UPLINK_MSG_BYTES(frame_bytes, n)    (((frame_bytes) * (n) + 2) / 3 * 4 + UPLINK_MSG_OVERHEAD)
+
+/*
+ * Uplink congestion control. Audio is only handed to the socket while the
+ * send buffer can take the whole message with half of it still free for
+ * control messages (commit, response.create, cancel); otherwise the frames wait in the mic ring, which drops at its
+ * producer once full. When a backlog builds or writes fail, more frames are
+ * packed into each append message to cut per-message overhead, and the
+ * packing is relaxed again once the link keeps up.
+ */
+typedef struct
+{
+    uint32_t    frame_bytes;
+    uint32_t    sndbuf_size;
+    uint16_t    agg;            // frames per message
+    uint16_t    agg_min;        // floor set by the link profile
+    uint16_t    healthy;        // consecutive decisions with a drained buffer
+    uint32_t    sent_frames;
+    uint32_t    sent_msgs;
+    uint32_t    deferred;       // decisions held back by a full send buffer
+    uint32_t    write_errs;
+    uint16_t    agg_max_seen;
+} uplink_ctrl_t;
+
+/* The controller has no OS dependency, the caller serialises the calls. */
+void     uplink_ctrl_init(uplink_ctrl_t *u, uint32_t frame_bytes, uint32_t sndbuf_size);
+/* Link profile change: wire bytes per frame and the least frames per message. */
+void     uplink_ctrl_config(uplink_ctrl_t *u, uint32_t frame_bytes, uint32_t agg_min);
+/* Frames to pack into the next message, 0 to hold off. flush sends a short
+ * tail instead of waiting for a full aggregate. */
+uint32_t uplink_ctrl_next(uplink_ctrl_t *u, uint32_t backlog_frames, uint32_t sndbuf_free, int flush);
+/* Result of writing the message of n frames chosen by uplink_ctrl_next. */
+void     uplink_ctrl_result(uplink_ctrl_t *u, uint32_t frames, int err);
+
+#endif /* __UPLINK_H__ */
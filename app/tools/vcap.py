@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""Replay a session capture (.vcap) recorded with the `vcap` MSH command.
+
+The capture is re-timed through a model of the playback path: downlink audio
+is fed into a speaker cache at its capture timestamps and drained at the
+real playback rate, which gives the cache level over time, underruns and the
+turn latencies the user experienced.
+
+    python vcap.py session.vcap                  # summary and replay
+    python vcap.py session.vcap --prebuffer 200  # hold playback until 200 ms is queued
+    python vcap.py session.vcap --export out     # write mic.wav, rx.wav / rx.mp3
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+import wave
+
+MAGIC = b"VCAP"
+HDR = struct.Struct("<4sHHI")
+REC = struct.Struct("<IBBH")
+
+CAP_MIC, CAP_WS_TX, CAP_WS_RX, CAP_TX_AUDIO, CAP_RX_AUDIO, CAP_LEVELS, CAP_AUDIO_EVENT = range(1, 8)
+TYPE_NAME = {
+    CAP_MIC: "mic", CAP_WS_TX: "ws_tx", CAP_WS_RX: "ws_rx", CAP_TX_AUDIO: "tx_audio",
+    CAP_RX_AUDIO: "rx_audio", CAP_LEVELS: "levels", CAP_AUDIO_EVENT: "audio_event",
+}
+FLAG_TTS = 0x01
+
+PCM_BYTES_PER_MS = 32   # 16 kHz mono pcm16
+
+MP3_BITRATE = {
+    1: [0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320],   # MPEG1 layer 3
+    2: [0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160],       # MPEG2/2.5 layer 3
+}
+MP3_RATE = {3: [44100, 48000, 32000], 2: [22050, 24000, 16000], 0: [11025, 12000, 8000]}
+
+
+def read_capture(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, _, start_ms = HDR.unpack_from(data, 0)
+    if magic != MAGIC:
+        sys.exit("%s: not a capture file" % path)
+    records = []
+    off = HDR.size
+    while off + REC.size <= len(data):
+        t, typ, flags, length = REC.unpack_from(data, off)
+        off += REC.size
+        if off + length > len(data):
+            print("warning: truncated record at %d" % off)
+            break
+        records.append((t, typ, flags, data[off:off + length]))
+        off += length
+    return version, start_ms, records
+
+
+def mp3_duration_ms(buf):
+    """Playback duration of the whole MP3 frames in buf, and the bytes used."""
+    ms, i = 0.0, 0
+    while i + 4 <= len(buf):
+        h = struct.unpack_from(">I", buf, i)[0]
+        if (h >> 21) & 0x7FF != 0x7FF:
+            i += 1
+            continue
+        ver = (h >> 19) & 3
+        br_idx = (h >> 12) & 0xF
+        sr_idx = (h >> 10) & 3
+        if ver == 1 or br_idx in (0, 15) or sr_idx == 3:
+            i += 1
+            continue
+        bitrate = MP3_BITRATE[1 if ver == 3 else 2][br_idx] * 1000
+        rate = MP3_RATE[ver][sr_idx]
+        pad = (h >> 9) & 1
+        samples = 1152 if ver == 3 else 576
+        size = samples // 8 * bitrate // rate + pad
+        if i + size > len(buf):
+            break
+        ms += samples * 1000.0 / rate
+        i += size
+    return ms, i
+
+
+def stats(values):
+    if not values:
+        return "n/a"
+    values = sorted(values)
+    return "avg %.1f  p50 %.1f  p95 %.1f  max %.1f" % (
+        sum(values) / len(values), values[len(values) // 2],
+        values[min(len(values) - 1, len(values) * 95 // 100)], values[-1])
+
+
+def summary(records):
+    count, size = {}, {}
+    for _, typ, _, payload in records:
+        count[typ] = count.get(typ, 0) + 1
+        size[typ] = size.get(typ, 0) + len(payload)
+    span = (records[-1][0] - records[0][0]) / 1000.0 if records else 0
+    print("records: %d over %.1f s" % (len(records), span))
+    for typ in sorted(count):
+        print("  %-12s %6d records %9d bytes" % (TYPE_NAME.get(typ, typ), count[typ], size[typ]))
+
+
+def intervals(records, typ):
+    times = [r[0] for r in records if r[1] == typ]
+    return [b - a for a, b in zip(times, times[1:])]
+
+
+def message_type(payload):
+    try:
+        return json.loads(payload.decode("utf-8", "replace")).get("type", "?")
+    except ValueError:
+        return "?"
+
+
+def turn_latency(records):
+    """Time from input_audio_buffer.commit (chat) or input_text.done (tts) to first audio."""
+    latencies, pending = [], None
+    for t, typ, _, payload in records:
+        if typ == CAP_WS_TX and message_type(payload) in ("input_audio_buffer.commit", "input_text.done"):
+            pending = t
+        elif typ == CAP_RX_AUDIO and pending is not None:
+            latencies.append(t - pending)
+            pending = None
+    return latencies
+
+
+def replay(records, prebuffer_ms):
+    """Feed downlink audio into a speaker cache model and drain it in real time."""
+    level_ms, playing, clock = 0.0, False, None
+    underruns, peak, mp3_tail = 0, 0.0, b""
+    trace = []
+    for t, typ, flags, payload in records:
+        if typ != CAP_RX_AUDIO:
+            continue
+        if clock is not None and playing:
+            level_ms -= t - clock
+            if level_ms < 0:
+                underruns += 1
+                level_ms = 0.0
+                playing = prebuffer_ms == 0
+        clock = t
+        if flags & FLAG_TTS:
+            ms, used = mp3_duration_ms(mp3_tail + payload)
+            mp3_tail = (mp3_tail + payload)[used:]
+        else:
+            ms = len(payload) / float(PCM_BYTES_PER_MS)
+        level_ms += ms
+        peak = max(peak, level_ms)
+        if not playing and level_ms >= prebuffer_ms:
+            playing = True
+        trace.append((t, level_ms))
+    return underruns, peak, trace
+
+
+def export(records, outdir):
+    os.makedirs(outdir, exist_ok=True)
+    mic = b"".join(p for _, typ, _, p in records if typ == CAP_MIC)
+    rx_pcm = b"".join(p for _, typ, f, p in records if typ == CAP_RX_AUDIO and not f & FLAG_TTS)
+    rx_mp3 = b"".join(p for _, typ, f, p in records if typ == CAP_RX_AUDIO and f & FLAG_TTS)
+    for name, pcm in (("mic.wav", mic), ("rx.wav", rx_pcm)):
+        if pcm:
+            with wave.open(os.path.join(outdir, name), "wb") as w:
+                w.setnchannels(1)
+                w.setsampwidth(2)
+                w.setframerate(16000)
+                w.writeframes(pcm)
+    if rx_mp3:
+        with open(os.path.join(outdir, "rx.mp3"), "wb") as f:
+            f.write(rx_mp3)
+    print("exported to %s" % outdir)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("capture")
+    ap.add_argument("--prebuffer", type=int, default=0, help="ms queued before playback starts")
+    ap.add_argument("--export", metavar="DIR", help="write captured audio as wav/mp3")
+    ap.add_argument("--trace", action="store_true", help="print the modelled speaker cache level")
+    args = ap.parse_args()
+
+    version, start_ms, records = read_capture(args.capture)
+    print("capture v%d, device start %d ms" % (version, start_ms))
+    summary(records)
+    print("mic interval ms:      %s" % stats(intervals(records, CAP_MIC)))
+    print("uplink interval ms:   %s" % stats(intervals(records, CAP_TX_AUDIO)))
+    print("downlink interval ms: %s" % stats(intervals(records, CAP_RX_AUDIO)))
+    print("turn latency ms:      %s" % stats(turn_latency(records)))
+
+    events = {}
+    for _, typ, _, p in records:
+        if typ == CAP_AUDIO_EVENT and p:
+            events[p[0]] = events.get(p[0], 0) + 1
+    for cmd, n in sorted(events.items()):
+        print("audio_server callback cmd %d: %d" % (cmd, n))
+    levels = [struct.unpack_from("<III", p) for _, typ, _, p in records if typ == CAP_LEVELS and len(p) >= 12]
+    if levels:
+        print("peak levels: mic ring %d, mp3 ring %d, speaker queued %d bytes" %
+              tuple(max(l[i] for l in levels) for i in range(3)))
+
+    underruns, peak, trace = replay(records, args.prebuffer)
+    print("replay (prebuffer %d ms): %d underruns, peak queued %.0f ms" % (args.prebuffer, underruns, peak))
+    if args.trace:
+        for t, level in trace:
+            print("  %8d ms  %7.1f ms queued" % (t, level))
+    if args.export:
+        export(records, args.export)
+
+
+if __name__ == "__main__":
+    main()